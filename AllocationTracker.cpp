@@ -0,0 +1,170 @@
+#include "AllocationTracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32) || defined(_WIN64)
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+	#include <psapi.h>
+	#include <malloc.h>
+#elif defined(__linux__)
+	#include <cstdio>
+	#include <cstring>
+	#include <fstream>
+	#include <string>
+	#include <malloc.h>
+	#include <unistd.h>
+#endif
+
+namespace
+{
+	std::atomic<bool> enabled{ false };
+	std::atomic<std::uint64_t> allocations{ 0 };
+	std::atomic<std::uint64_t> deallocations{ 0 };
+	std::atomic<std::uint64_t> bytes{ 0 };
+	std::atomic<std::int64_t> liveBytes{ 0 };
+
+	std::size_t UsableSize(void* pointer, [[maybe_unused]] std::size_t alignment)
+	{
+	#if defined(_WIN32) || defined(_WIN64)
+		return alignment ? _aligned_msize(pointer, alignment, 0) : _msize(pointer);
+	#elif defined(__linux__)
+		return malloc_usable_size(pointer);
+	#else
+		return 0;
+	#endif
+	}
+
+	void CountAllocation(void* pointer, std::size_t size, std::size_t alignment)
+	{
+		if (!enabled.load(std::memory_order_relaxed))
+			return;
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		bytes.fetch_add(size, std::memory_order_relaxed);
+		liveBytes.fetch_add(static_cast<std::int64_t>(UsableSize(pointer, alignment)), std::memory_order_relaxed);
+	}
+
+	// Memory allocated before tracking started & freed while it's on makes live bytes dip, deltas stay right
+	void CountDeallocation(void* pointer, std::size_t alignment)
+	{
+		if (!pointer || !enabled.load(std::memory_order_relaxed))
+			return;
+		deallocations.fetch_add(1, std::memory_order_relaxed);
+		liveBytes.fetch_sub(static_cast<std::int64_t>(UsableSize(pointer, alignment)), std::memory_order_relaxed);
+	}
+
+	void* Allocate(std::size_t size, std::size_t alignment)
+	{
+		if (size == 0)
+			size = 1;
+
+		while (true)
+		{
+		#if defined(_WIN32) || defined(_WIN64)
+			void* pointer = alignment ? _aligned_malloc(size, alignment) : std::malloc(size);
+		#else
+			// aligned_alloc wants a multiple of the alignment
+			void* pointer = alignment ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment) : std::malloc(size);
+		#endif
+			if (pointer)
+			{
+				CountAllocation(pointer, size, alignment);
+				return pointer;
+			}
+
+			const auto handler = std::get_new_handler();
+			if (!handler)
+				throw std::bad_alloc{ };
+			handler();
+		}
+	}
+
+	void Free(void* pointer, std::size_t alignment) noexcept
+	{
+		CountDeallocation(pointer, alignment);
+	#if defined(_WIN32) || defined(_WIN64)
+		alignment ? _aligned_free(pointer) : std::free(pointer);
+	#else
+		std::free(pointer);
+	#endif
+	}
+
+#if defined(__linux__)
+	// A "Name:   1234 kB" line of /proc/self/status
+	std::size_t StatusKilobytes(const char* name)
+	{
+		std::ifstream status{ "/proc/self/status" };
+		std::string line;
+		const auto length = std::strlen(name);
+		while (std::getline(status, line))
+		{
+			if (line.compare(0, length, name) == 0)
+				return std::strtoull(line.c_str() + length, nullptr, 10);
+		}
+		return 0;
+	}
+#endif
+}
+
+// The array & nothrow forms of the standard library call these, so they are counted too
+void* operator new(std::size_t size) { return Allocate(size, 0); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return Allocate(size, static_cast<std::size_t>(alignment)); }
+void operator delete(void* pointer) noexcept { Free(pointer, 0); }
+void operator delete(void* pointer, std::size_t) noexcept { Free(pointer, 0); }
+void operator delete(void* pointer, std::align_val_t alignment) noexcept { Free(pointer, static_cast<std::size_t>(alignment)); }
+void operator delete(void* pointer, std::size_t, std::align_val_t alignment) noexcept { Free(pointer, static_cast<std::size_t>(alignment)); }
+
+void AllocationTracker::Enable(bool on) noexcept
+{
+	enabled.store(on, std::memory_order_relaxed);
+}
+
+AllocationStats AllocationTracker::Snapshot() noexcept
+{
+	return AllocationStats{ allocations.load(std::memory_order_relaxed), deallocations.load(std::memory_order_relaxed),
+		bytes.load(std::memory_order_relaxed), liveBytes.load(std::memory_order_relaxed) };
+}
+
+std::size_t AllocationTracker::ResidentBytes() noexcept
+{
+#if defined(_WIN32) || defined(_WIN64)
+	PROCESS_MEMORY_COUNTERS counters{ };
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize : 0;
+#elif defined(__linux__)
+	try { return StatusKilobytes("VmRSS:") * 1024; }
+	catch (...) { return 0; }
+#else
+	return 0;
+#endif
+}
+
+std::size_t AllocationTracker::PeakResidentBytes() noexcept
+{
+#if defined(_WIN32) || defined(_WIN64)
+	PROCESS_MEMORY_COUNTERS counters{ };
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#elif defined(__linux__)
+	try { return StatusKilobytes("VmHWM:") * 1024; }
+	catch (...) { return 0; }
+#else
+	return 0;
+#endif
+}
+
+bool AllocationTracker::ResetPeak() noexcept
+{
+#if defined(__linux__)
+	// 5 resets the high water mark to the current resident set (Linux 4.0 and later)
+	std::FILE* file = std::fopen("/proc/self/clear_refs", "w");
+	if (!file)
+		return false;
+	const bool reset = std::fputs("5", file) >= 0;
+	return std::fclose(file) == 0 && reset;
+#else
+	return false;
+#endif
+}
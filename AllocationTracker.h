@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Heap activity of the whole process while tracking was on
+struct AllocationStats
+{
+    std::uint64_t allocations_{ };
+    std::uint64_t deallocations_{ };
+    std::uint64_t bytes_{ };        // Requested by the allocations
+    std::int64_t liveBytes_{ };     // Allocated minus freed, in usable sizes (what the allocator really handed out)
+
+    AllocationStats operator-(const AllocationStats& other) const
+    {
+        return AllocationStats{ allocations_ - other.allocations_, deallocations_ - other.deallocations_, bytes_ - other.bytes_, liveBytes_ - other.liveBytes_ };
+    }
+
+    AllocationStats& operator+=(const AllocationStats& other)
+    {
+        allocations_ += other.allocations_;
+        deallocations_ += other.deallocations_;
+        bytes_ += other.bytes_;
+        liveBytes_ += other.liveBytes_;
+        return *this;
+    }
+};
+
+// Counts every global operator new & delete of the process, AllocationTracker.cpp replaces them
+// Linked into the application, the test suite includes the .cpp like it does OrderBook.cpp
+// Counting costs a few atomic adds per call so it's off until Enable(true), the other benchmarks don't pay for it
+struct AllocationTracker
+{
+    static void Enable(bool enabled) noexcept;
+    static AllocationStats Snapshot() noexcept;
+
+    // Resident set of the process in bytes, 0 when the platform doesn't tell
+    static std::size_t ResidentBytes() noexcept;
+
+    // Highest resident set since the last ResetPeak. Returns false when the peak can't be reset,
+    // PeakResidentBytes is then the peak of the whole process
+    static std::size_t PeakResidentBytes() noexcept;
+    static bool ResetPeak() noexcept;
+};
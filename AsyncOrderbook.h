@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BookEvent.h"
+#include "OrderBook.h"
+#include "SharedMemoryEntry.h"
+#include "ThreadPool.h"
+
+// What an awaited command resolves with
+struct AsyncResult
+{
+    EntryResponse response_;        // The ack: status, filled & resting quantity
+    std::vector<BookEvent> fills_;  // The order's own fills in the order they happened, the trade price is contraPrice_
+};
+
+class AsyncOrderbook;
+
+// Fire and forget coroutine of one client, started on the executor by AsyncOrderbook::Spawn
+// It frees itself when it finishes, it must not throw (the process terminates if it does)
+class AsyncTask
+{
+public:
+    struct promise_type
+    {
+        AsyncOrderbook* owner_{ nullptr };
+
+        AsyncTask get_return_object() noexcept { return AsyncTask{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+        std::suspend_always initial_suspend() noexcept { return { }; }
+
+        // The frame is gone before the owner hears about it, so Wait never returns under a live frame
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+            void await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+            void await_resume() noexcept { }
+        };
+        FinalAwaiter final_suspend() noexcept { return { }; }
+
+        void return_void() noexcept { }
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    AsyncTask(AsyncTask&& other) noexcept : handle_{ std::exchange(other.handle_, nullptr) } { }
+    AsyncTask(const AsyncTask&) = delete;
+    void operator=(const AsyncTask&) = delete;
+
+    // Never spawned: the frame has to go with the task
+    ~AsyncTask()
+    {
+        if (handle_)
+            handle_.destroy();
+    }
+
+private:
+    friend class AsyncOrderbook;
+    explicit AsyncTask(std::coroutine_handle<promise_type> handle) : handle_{ handle } { }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// Awaitable front end of a book for many concurrent clients
+//
+//     AsyncTask Client(AsyncOrderbook& book)
+//     {
+//         const auto result = co_await book.Submit(request);
+//         co_await book.Cancel(result.response_.orderId_);
+//     }
+//     book.Spawn(Client(book));
+//
+// A suspended client costs its coroutine frame, not a thread. co_await queues the command and returns the
+// thread to the executor; one matching thread drains the queue a batch at a time (the book's lock is then never
+// contended) and hands every finished client back to the executor, whose few threads run them all
+// Commands of one client run in the order it awaits them. The book must not be used directly while this runs
+class AsyncOrderbook : private BookEventListener
+{
+public:
+    // One command in flight, it lives in the awaiting coroutine's frame
+    class Command
+    {
+    public:
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+            handle_ = handle;
+            owner_.Enqueue(this);
+        }
+        AsyncResult await_resume() noexcept { return std::move(result_); }
+
+    private:
+        friend class AsyncOrderbook;
+        Command(AsyncOrderbook& owner, const EntryRequest& request) : owner_{ owner }, request_{ request } { }
+
+        AsyncOrderbook& owner_;
+        EntryRequest request_;
+        AsyncResult result_{ };
+        std::coroutine_handle<> handle_;
+    };
+
+    AsyncOrderbook(Orderbook& orderbook, ThreadPool& executor)
+        : orderbook_{ orderbook }
+        , executor_{ executor }
+    {
+        orderbook_.AddListener(this);
+        matcher_ = std::thread{ [this] { MatchLoop(); } };
+    }
+
+    // Runs what is still queued, the clients it resumes must be done with the book before it goes
+    ~AsyncOrderbook() override
+    {
+        {
+            std::scoped_lock lock{ mutex_ };
+            shutdown_ = true;
+        }
+        queued_.notify_one();
+        matcher_.join();
+        orderbook_.RemoveListener(this);
+    }
+
+    AsyncOrderbook(const AsyncOrderbook&) = delete;
+    void operator=(const AsyncOrderbook&) = delete;
+
+    [[nodiscard]] Command Submit(const EntryRequest& request) { return Command{ *this, request }; }
+
+    [[nodiscard]] Command Cancel(OrderId orderId, AccountId account = { })
+    {
+        return Command{ *this, EntryRequest{ 0, orderId, 0, 0, Side::Buy, EntryRequestType::Cancel, account } };
+    }
+
+    // Starts a client on the executor
+    void Spawn(AsyncTask task)
+    {
+        auto handle = std::exchange(task.handle_, nullptr);
+        handle.promise().owner_ = this;
+        running_.fetch_add(1, std::memory_order_relaxed);
+        executor_.Submit([handle] { handle.resume(); });
+    }
+
+    // Blocks until every spawned client finished
+    void Wait()
+    {
+        std::unique_lock lock{ mutex_ };
+        finished_.wait(lock, [this] { return running_.load(std::memory_order_acquire) == 0; });
+    }
+
+    std::uint64_t Executed() const { return executed_.load(std::memory_order_relaxed); }
+
+private:
+    friend struct AsyncTask::promise_type::FinalAwaiter;
+
+    void Enqueue(Command* command)
+    {
+        bool wake;
+        {
+            std::scoped_lock lock{ mutex_ };
+            wake = pending_.empty();
+            pending_.push_back(command);
+        }
+        if (wake)
+            queued_.notify_one();
+    }
+
+    void Finished()
+    {
+        if (running_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::scoped_lock lock{ mutex_ };
+            finished_.notify_all();
+        }
+    }
+
+    void MatchLoop()
+    {
+        std::vector<Command*> batch;
+        while (true)
+        {
+            {
+                std::unique_lock lock{ mutex_ };
+                queued_.wait(lock, [this] { return shutdown_ || !pending_.empty(); });
+                if (pending_.empty())
+                    return;
+                batch.swap(pending_);
+            }
+
+            std::vector<std::coroutine_handle<>> resumed;
+            resumed.reserve(batch.size());
+            for (auto* command : batch)
+            {
+                current_ = command;
+                command->result_.response_ = SharedMemoryEntryServer::Execute(orderbook_, command->request_);
+                current_ = nullptr;
+                resumed.push_back(command->handle_);
+            }
+            executed_.fetch_add(batch.size(), std::memory_order_relaxed);
+            batch.clear();
+            Resume(std::move(resumed));
+        }
+    }
+
+    // One executor task per thread for the whole batch instead of one per client, a task is a lock & a wake up
+    // Once submitted a client may run (and finish, taking its command with it), the handles are all that's left
+    void Resume(std::vector<std::coroutine_handle<>> handles)
+    {
+        const auto tasks = std::min(executor_.Size(), handles.size());
+        for (std::size_t task = 0; task < tasks; task++)
+        {
+            const auto begin = handles.size() * task / tasks;
+            const auto end = handles.size() * (task + 1) / tasks;
+            executor_.Submit([slice = std::vector<std::coroutine_handle<>>(handles.begin() + begin, handles.begin() + end)]
+                {
+                    for (const auto handle : slice)
+                        handle.resume();
+                });
+        }
+    }
+
+    // Called by the book on the matching thread while it runs the current command
+    void OnBookEvent(const BookEvent& event) override
+    {
+        if (current_ && event.type_ == BookEventType::Fill && event.orderId_ == current_->request_.orderId_)
+            current_->result_.fills_.push_back(event);
+    }
+
+    Orderbook& orderbook_;
+    ThreadPool& executor_;
+    std::thread matcher_;
+    Command* current_{ nullptr };
+
+    // Commands waiting for the matching thread, swapped out whole
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::vector<Command*> pending_;
+    bool shutdown_{ false };
+
+    std::atomic<std::size_t> running_{ 0 };
+    std::condition_variable finished_;
+    std::atomic<std::uint64_t> executed_{ 0 };
+};
+
+inline void AsyncTask::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+{
+    auto* owner = handle.promise().owner_;
+    handle.destroy();
+    if (owner)
+        owner->Finished();
+}
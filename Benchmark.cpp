@@ -0,0 +1,951 @@
+#include "Benchmark.h"
+#include "AsyncOrderbook.h"
+#include "DepthKernels.h"
+#include "DurableJournal.h"
+#include "EnginePipeline.h"
+#include "EventJournal.h"
+#include "MarketDataFanout.h"
+#include "OrderBook.h"
+#include "RecordedFeed.h"
+#include "Replication.h"
+#include "ScenarioRunner.h"
+#include "SharedMemoryEntry.h"
+#include "ThreadAffinity.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+
+#if defined(__linux__)
+	#include <sys/resource.h>
+#endif
+
+namespace
+{
+	long MinorFaults()
+	{
+	#if defined(__linux__)
+		rusage usage{ };
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_minflt;
+	#else
+		return -1;
+	#endif
+	}
+
+	// Adds that can only take liquidity are profiled apart from the resting ones
+	std::size_t ProfileSlot(const Information& operation)
+	{
+		const bool taking = operation.orderType_ == OrderType::FillAndKill || operation.orderType_ == OrderType::FillOrKill || operation.orderType_ == OrderType::Market;
+		return operation.type_ == ActionType::Add && taking ? 3 : static_cast<std::size_t>(operation.type_);
+	}
+
+	// Spreads the flow over a few accounts so a risk check has exposure to keep apart
+	constexpr AccountId Accounts = 64;
+
+	void Apply(Orderbook& orderbook, const Information& operation)
+	{
+		switch (operation.type_)
+		{
+			case ActionType::Add:
+			{
+				auto order = orderbook.CreateOrder(operation.orderType_, operation.orderId_, operation.side_, operation.price_, operation.quantity_);
+				order->SetAccount(static_cast<AccountId>(operation.orderId_ % Accounts));
+				orderbook.AddOrder(order);
+				break;
+			}
+			case ActionType::Cancel:
+				orderbook.CancelOrder(operation.orderId_);
+				break;
+			case ActionType::Modify:
+				orderbook.ModifyOrder(OrderModify{ operation.orderId_, operation.side_, operation.price_, operation.quantity_ });
+				break;
+		}
+	}
+
+	EntryRequest ToEntryRequest(const Information& operation, std::uint64_t sequence)
+	{
+		EntryRequestType type{ EntryRequestType::Limit };
+		if (operation.type_ == ActionType::Cancel)
+			type = EntryRequestType::Cancel;
+		else if (operation.type_ == ActionType::Modify)
+			type = EntryRequestType::Modify;
+		else if (operation.orderType_ == OrderType::Market)
+			type = EntryRequestType::Market;
+		else if (operation.orderType_ == OrderType::FillAndKill)
+			type = EntryRequestType::ImmediateOrCancel;
+		else if (operation.orderType_ == OrderType::FillOrKill)
+			type = EntryRequestType::FillOrKill;
+
+		return EntryRequest{ sequence, operation.orderId_, operation.price_, operation.quantity_, operation.side_, type, static_cast<AccountId>(operation.orderId_ % Accounts) };
+	}
+
+	double Percentile(std::vector<std::uint32_t>& latencies, double percentile)
+	{
+		if (latencies.empty())
+			return 0.0;
+
+		const auto index = static_cast<std::size_t>(percentile * (latencies.size() - 1));
+		std::nth_element(latencies.begin(), latencies.begin() + index, latencies.end());
+		return latencies[index];
+	}
+}
+
+Benchmark::Benchmark(const BenchmarkOptions& options) : options_{ options }
+{
+	Generate();
+}
+
+void Benchmark::Generate()
+{
+	// Generated up front so the measured loop only contains engine work
+	FlowGenerator flow{ options_.flow_ };
+
+	setup_.reserve(options_.restingOrders_);
+	for (std::size_t i = 0; i < options_.restingOrders_; i++)
+		setup_.push_back(flow.NextResting(i % 2 ? Side::Sell : Side::Buy));
+
+	operations_.reserve(options_.operations_);
+	flow.Generate(options_.operations_, [this](const FlowMessage& message) { operations_.push_back(message.action_); });
+}
+
+BenchmarkResult Benchmark::Run(const std::string& name, const OrderbookConfig& config, PreTradeCheck* risk) const
+{
+	BenchmarkResult result;
+	result.name_ = name;
+	result.operations_ = operations_.size();
+
+	Orderbook orderbook{ config };
+	orderbook.SetPreTradeCheck(risk);
+	result.pinned_ = orderbook.BindMatchingThread();
+	result.hugePages_ = orderbook.GetArena() && orderbook.GetArena()->UsesHugePages();
+
+	auto apply = [&orderbook](const Information& operation) { Apply(orderbook, operation); };
+
+	for (const auto& operation : setup_)
+		apply(operation);
+
+	std::vector<std::uint32_t> latencies;
+	latencies.reserve(operations_.size());
+
+	// Opened after the setup so only the measured phase is counted
+	std::optional<PerfCounters> counters;
+	if (options_.profile_)
+	{
+		counters.emplace();
+		result.profile_ = PerfProfile{ { "add", "cancel", "modify", "take" }, counters->Supported() };
+	}
+
+	const auto faults = MinorFaults();
+	const auto start = std::chrono::steady_clock::now();
+	for (const auto& operation : operations_)
+	{
+		if (counters)
+		{
+			const auto elapsed = counters->Measure(result.profile_.At(ProfileSlot(operation)), [&] { apply(operation); });
+			latencies.push_back(static_cast<std::uint32_t>(elapsed));
+			continue;
+		}
+
+		const auto begin = std::chrono::steady_clock::now();
+		apply(operation);
+		const auto end = std::chrono::steady_clock::now();
+		latencies.push_back(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()));
+	}
+	result.seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.minorFaults_ = faults < 0 ? -1 : MinorFaults() - faults;
+
+	result.p50_ = Percentile(latencies, 0.50);
+	result.p99_ = Percentile(latencies, 0.99);
+	result.p999_ = Percentile(latencies, 0.999);
+	return result;
+}
+
+BenchmarkResults Benchmark::RunMemoryConfigurations() const
+{
+	BenchmarkResults results;
+
+	results.push_back(Run("heap", OrderbookConfig{ .prepopulate_ = false, .expireGoodForDay_ = false }));
+
+	results.push_back(Run("arena (4KB pages)", OrderbookConfig{ .prepopulate_ = false, .expireGoodForDay_ = false,
+		.arenaBytes_ = options_.arenaBytes_, .hugePages_ = false, .prefault_ = true }));
+
+	results.push_back(Run("arena (2MB pages) + pinned", OrderbookConfig{ .prepopulate_ = false, .expireGoodForDay_ = false,
+		.arenaBytes_ = options_.arenaBytes_, .hugePages_ = true, .prefault_ = true, .matchingCore_ = options_.core_ }));
+
+	// Limits every order passes, so the flow is the same and only the cost of checking & tracking shows
+	PreTradeRisk risk;
+	results.push_back(Run("heap + pre-trade risk", OrderbookConfig{ .prepopulate_ = false, .expireGoodForDay_ = false }, &risk));
+
+	return results;
+}
+
+DurabilityResults Benchmark::RunDurability(const std::filesystem::path& directory, const std::vector<DurabilitySetting>& settings,
+	std::size_t orders, double ordersPerSecond) const
+{
+	using Clock = std::chrono::steady_clock;
+
+	DurabilityResults results;
+	const auto count = std::min(orders, operations_.size());
+	const auto gap = std::chrono::nanoseconds{ static_cast<std::int64_t>(1e9 / ordersPerSecond) };
+
+	for (const auto& setting : settings)
+	{
+		DurabilityResult result;
+		result.setting_ = setting;
+
+		// Orders waiting for their ack in sequence order, the journal's thread takes them off the front
+		std::mutex mutex;
+		std::deque<std::pair<std::uint64_t, Clock::time_point>> pending;
+		std::vector<std::uint32_t> acks;
+		acks.reserve(count);
+		Clock::time_point lastAck;
+
+		DurableJournalOptions journalOptions;
+		journalOptions.batchEvents_ = setting.batchEvents_;
+		journalOptions.maxDelay_ = setting.maxDelay_;
+		journalOptions.onCommit_ = [&](std::uint64_t durable)
+			{
+				const auto now = Clock::now();
+				std::scoped_lock lock{ mutex };
+				for (; !pending.empty() && pending.front().first <= durable; pending.pop_front())
+					acks.push_back(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - pending.front().second).count()));
+				lastAck = now;
+			};
+
+		Orderbook orderbook{ OrderbookConfig{ .prepopulate_ = false, .expireGoodForDay_ = false } };
+		DurableJournal journal{ directory / "durable.journal", journalOptions };
+		orderbook.AddListener(&journal);
+
+		for (const auto& operation : setup_)
+			Apply(orderbook, operation);
+		journal.WaitDurable(journal.LastSequence());
+		const auto setupCommits = journal.Commits();
+
+		// Paced arrivals: an order is acked when the batch holding its last event is durable
+		const auto start = Clock::now();
+		auto next = start;
+		for (std::size_t i = 0; i < count; i++)
+		{
+			while (Clock::now() < next)
+				;
+			next += gap;
+
+			const auto before = journal.LastSequence();
+			const auto submitted = Clock::now();
+			Apply(orderbook, operations_[i]);
+			const auto sequence = journal.LastSequence();
+			if (sequence == before)
+				continue;
+
+			// A commit may have covered it already, then nobody would pop it
+			std::scoped_lock lock{ mutex };
+			if (journal.DurableSequence() >= sequence)
+				acks.push_back(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - submitted).count()));
+			else
+				pending.emplace_back(sequence, submitted);
+		}
+		journal.WaitDurable(journal.LastSequence());
+		orderbook.RemoveListener(&journal);
+
+		{
+			std::scoped_lock lock{ mutex };
+			result.orders_ = acks.size();
+			result.seconds_ = std::chrono::duration<double>(std::max(lastAck, start) - start).count();
+			result.p50_ = Percentile(acks, 0.50) / 1'000.0;
+			result.p99_ = Percentile(acks, 0.99) / 1'000.0;
+		}
+		result.commits_ = journal.Commits() - setupCommits;
+		result.ioUring_ = journal.UsesIoUring();
+		results.push_back(result);
+	}
+
+	std::filesystem::remove(directory / "durable.journal");
+	return results;
+}
+
+BenchmarkResult Benchmark::RunSharedMemoryEntry(const std::string& segment) const
+{
+	BenchmarkResult result;
+	result.name_ = "shared memory entry round trip";
+	result.operations_ = operations_.size();
+
+	Orderbook orderbook{ OrderbookConfig{ .prepopulate_ = false, .expireGoodForDay_ = false, .transactionLog_ = false } };
+	for (const auto& operation : setup_)
+		Apply(orderbook, operation);
+
+	SharedMemoryEntryServer server{ segment, 1 };
+	std::atomic<bool> stop{ false };
+	std::atomic<bool> pinned{ false };
+	std::thread engine{ [&]
+		{
+			pinned = ThreadAffinity::PinCurrentThread(options_.core_);
+			server.Serve(orderbook, stop);
+		} };
+
+	std::vector<std::uint32_t> latencies;
+	latencies.reserve(operations_.size());
+	{
+		SharedMemoryEntryClient client{ segment };
+		EntryResponse response;
+
+		const auto faults = MinorFaults();
+		const auto start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < operations_.size(); i++)
+		{
+			const auto begin = std::chrono::steady_clock::now();
+			// Yields only matter when the engine shares the core with the client
+			while (!client.Submit(ToEntryRequest(operations_[i], i)))
+				std::this_thread::yield();
+			for (std::uint32_t spins = 0; !client.Poll(response); spins++)
+				if (spins > 4'096)
+					std::this_thread::yield();
+			const auto end = std::chrono::steady_clock::now();
+			latencies.push_back(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()));
+		}
+		result.seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.minorFaults_ = faults < 0 ? -1 : MinorFaults() - faults;
+	}
+
+	stop = true;
+	engine.join();
+	result.pinned_ = pinned;
+
+	result.p50_ = Percentile(latencies, 0.50);
+	result.p99_ = Percentile(latencies, 0.99);
+	result.p999_ = Percentile(latencies, 0.999);
+	return result;
+}
+
+BenchmarkResults Benchmark::RunPipeline() const
+{
+	using Clock = std::chrono::steady_clock;
+
+	BenchmarkResults results;
+	const auto journalPath = std::filesystem::temp_directory_path() / "OrderBookPipelineBenchmark.jnl";
+	const OrderbookConfig config{ .prepopulate_ = false, .expireGoodForDay_ = false, .transactionLog_ = false };
+
+	// Baseline: validation, matching, market data and journaling one after the other on one thread
+	{
+		BenchmarkResult result;
+		result.name_ = "single thread";
+		result.operations_ = operations_.size();
+
+		Orderbook orderbook{ config };
+		for (const auto& operation : setup_)
+			Apply(orderbook, operation);
+
+		MarketDataFanout fanout;
+		const auto subscriber = fanout.Subscribe();
+		EventJournal journal{ journalPath };
+		orderbook.AddListener(&fanout);
+		orderbook.AddListener(&journal);
+
+		std::vector<std::uint32_t> latencies;
+		latencies.reserve(operations_.size());
+		const auto start = Clock::now();
+		for (std::size_t i = 0; i < operations_.size(); i++)
+		{
+			const auto begin = Clock::now();
+			SharedMemoryEntryServer::Execute(orderbook, ToEntryRequest(operations_[i], i));
+			latencies.push_back(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count()));
+		}
+		result.seconds_ = std::chrono::duration<double>(Clock::now() - start).count();
+
+		orderbook.RemoveListener(&journal);
+		orderbook.RemoveListener(&fanout);
+		result.p50_ = Percentile(latencies, 0.50);
+		result.p99_ = Percentile(latencies, 0.99);
+		result.p999_ = Percentile(latencies, 0.999);
+		results.push_back(result);
+	}
+
+	{
+		BenchmarkResult result;
+		result.name_ = "pipeline";
+		result.operations_ = operations_.size();
+
+		Orderbook orderbook{ config };
+		for (const auto& operation : setup_)
+			Apply(orderbook, operation);
+
+		MarketDataFanout fanout;
+		const auto subscriber = fanout.Subscribe();
+		EventJournal journal{ journalPath };
+
+		// Indexed by the command's clientSequence_, written before the submit and read once its response is out
+		std::vector<Clock::time_point> submitted(operations_.size());
+		std::vector<std::uint32_t> latencies;
+		latencies.reserve(operations_.size());
+
+		PipelineOptions options;
+		options.matchCore_ = options_.core_;
+		options.publishers_ = { &fanout };
+		options.journals_ = { &journal };
+		options.onResponse_ = [&](const EntryResponse& response)
+			{
+				latencies.push_back(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - submitted[response.clientSequence_]).count()));
+			};
+
+		EnginePipeline pipeline{ orderbook, options };
+		const auto start = Clock::now();
+		for (std::size_t i = 0; i < operations_.size(); i++)
+		{
+			submitted[i] = Clock::now();
+			pipeline.Submit(ToEntryRequest(operations_[i], i));
+		}
+		pipeline.Drain();
+		result.seconds_ = std::chrono::duration<double>(Clock::now() - start).count();
+		result.pinned_ = options_.core_ >= 0;
+
+		result.p50_ = Percentile(latencies, 0.50);
+		result.p99_ = Percentile(latencies, 0.99);
+		result.p999_ = Percentile(latencies, 0.999);
+		results.push_back(result);
+	}
+
+	std::filesystem::remove(journalPath);
+	std::filesystem::remove(EventJournal::SnapshotPath(journalPath));
+	std::filesystem::remove(EventJournal::IndexPath(journalPath));
+	return results;
+}
+
+BenchmarkResults Benchmark::RunReplication() const
+{
+	using Clock = std::chrono::steady_clock;
+
+	BenchmarkResults results;
+	const OrderbookConfig config{ .prepopulate_ = false, .expireGoodForDay_ = false, .transactionLog_ = false };
+	const auto socketPath = std::filesystem::temp_directory_path() / "OrderBookReplicationBenchmark.sock";
+
+	// execute(request) runs one request, the setup goes through it as well so the backup starts from the same book
+	auto run = [&](const std::string& name, auto&& execute)
+		{
+			BenchmarkResult result;
+			result.name_ = name;
+			result.operations_ = operations_.size();
+
+			std::uint64_t sequence = 0;
+			for (const auto& operation : setup_)
+				execute(ToEntryRequest(operation, sequence++));
+
+			std::vector<std::uint32_t> latencies;
+			latencies.reserve(operations_.size());
+			const auto faults = MinorFaults();
+			const auto start = Clock::now();
+			for (const auto& operation : operations_)
+			{
+				const auto request = ToEntryRequest(operation, sequence++);
+				const auto begin = Clock::now();
+				execute(request);
+				latencies.push_back(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count()));
+			}
+			result.seconds_ = std::chrono::duration<double>(Clock::now() - start).count();
+			result.minorFaults_ = faults < 0 ? -1 : MinorFaults() - faults;
+
+			result.p50_ = Percentile(latencies, 0.50);
+			result.p99_ = Percentile(latencies, 0.99);
+			result.p999_ = Percentile(latencies, 0.999);
+			return result;
+		};
+
+	{
+		Orderbook orderbook{ config };
+		results.push_back(run("no replication", [&orderbook](const EntryRequest& request) { SharedMemoryEntryServer::Execute(orderbook, request); }));
+	}
+
+	{
+		Orderbook backupBook{ config };
+		ReplicationBackup backup{ backupBook, socketPath };
+		Orderbook orderbook{ config };
+		ReplicationPrimary primary{ orderbook, socketPath };
+
+		results.push_back(run("primary + backup", [&primary](const EntryRequest& request) { primary.Execute(request); }));
+
+		// Only counts when the standby really holds the same book
+		if (!primary.WaitReplicated(primary.Sequence(), std::chrono::seconds{ 30 }) || primary.Diverged() || backupBook.Checksum() != orderbook.Checksum())
+			results.back().name_ += " (diverged)";
+	}
+	return results;
+}
+
+BenchmarkResults Benchmark::RunAsyncClients(std::size_t clients, std::size_t threads) const
+{
+	using Clock = std::chrono::steady_clock;
+
+	clients = std::max<std::size_t>(clients, 1);
+	const OrderbookConfig config{ .prepopulate_ = false, .expireGoodForDay_ = false, .transactionLog_ = false };
+
+	// Client c sends operations c, c + clients, ... and keeps its own latencies, merged once everybody is done
+	std::vector<std::vector<std::uint32_t>> latencies(clients);
+	auto run = [&](const std::string& name, auto&& drive)
+		{
+			BenchmarkResult result;
+			result.name_ = name;
+			result.operations_ = operations_.size();
+
+			Orderbook orderbook{ config };
+			for (const auto& operation : setup_)
+				Apply(orderbook, operation);
+
+			for (auto& client : latencies)
+			{
+				client.clear();
+				client.reserve(operations_.size() / clients + 1);
+			}
+
+			const auto start = Clock::now();
+			drive(orderbook);
+			result.seconds_ = std::chrono::duration<double>(Clock::now() - start).count();
+
+			std::vector<std::uint32_t> all;
+			all.reserve(operations_.size());
+			for (const auto& client : latencies)
+				all.insert(all.end(), client.begin(), client.end());
+			result.p50_ = Percentile(all, 0.50);
+			result.p99_ = Percentile(all, 0.99);
+			result.p999_ = Percentile(all, 0.999);
+			return result;
+		};
+
+	BenchmarkResults results;
+	results.push_back(run("thread per client x" + std::to_string(clients), [&](Orderbook& orderbook)
+		{
+			std::vector<std::thread> threadsPerClient;
+			threadsPerClient.reserve(clients);
+			for (std::size_t client = 0; client < clients; client++)
+			{
+				threadsPerClient.emplace_back([&, client]
+					{
+						for (auto i = client; i < operations_.size(); i += clients)
+						{
+							const auto request = ToEntryRequest(operations_[i], i);
+							const auto begin = Clock::now();
+							SharedMemoryEntryServer::Execute(orderbook, request);
+							latencies[client].push_back(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count()));
+						}
+					});
+			}
+			for (auto& thread : threadsPerClient)
+				thread.join();
+		}));
+
+	results.push_back(run("coroutines x" + std::to_string(clients) + " on " + std::to_string(threads), [&](Orderbook& orderbook)
+		{
+			ThreadPool executor{ threads };
+			AsyncOrderbook book{ orderbook, executor };
+
+			auto client = [](AsyncOrderbook& book, const Informations& operations, std::size_t first, std::size_t step, std::vector<std::uint32_t>& latencies) -> AsyncTask
+				{
+					for (auto i = first; i < operations.size(); i += step)
+					{
+						const auto request = ToEntryRequest(operations[i], i);
+						const auto begin = Clock::now();
+						co_await book.Submit(request);
+						latencies.push_back(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count()));
+					}
+				};
+
+			for (std::size_t i = 0; i < clients; i++)
+				book.Spawn(client(book, operations_, i, clients, latencies[i]));
+			book.Wait();
+		}));
+	return results;
+}
+
+QuotingResults Benchmark::RunQuoting(std::size_t makers, std::size_t levels) const
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Refresh
+	{
+		AccountId maker_;
+		std::vector<Quote> bids_;
+		std::vector<Quote> asks_;
+	};
+
+	// Generated up front, both runs send exactly the same quotes. Each maker keeps an id per level
+	// and steps its quotes with the mid, otherwise changes the size of one level per refresh
+	std::vector<Refresh> refreshes(std::max<std::size_t>(options_.operations_ / (2 * levels), 1));
+	{
+		std::mt19937_64 random{ options_.flow_.seed_ };
+		std::vector<std::vector<Quantity>> sizes(makers, std::vector<Quantity>(2 * levels, 100));
+		auto mid = options_.flow_.mid_;
+
+		for (std::size_t i = 0; i < refreshes.size(); i++)
+		{
+			auto& refresh = refreshes[i];
+			refresh.maker_ = static_cast<AccountId>(i % makers);
+			if (random() % 50 == 0)
+				mid += random() % 2 ? 1 : -1;
+
+			auto& size = sizes[refresh.maker_];
+			size[random() % size.size()] = static_cast<Quantity>(50 + random() % 100);
+
+			const auto spread = static_cast<Price>(2 + refresh.maker_ % 3);
+			const auto firstId = (OrderId{ 1 } << 40) + refresh.maker_ * 2 * levels;
+			for (std::size_t level = 0; level < levels; level++)
+			{
+				refresh.bids_.push_back(Quote{ firstId + level, mid - spread - static_cast<Price>(level), size[level] });
+				refresh.asks_.push_back(Quote{ firstId + levels + level, mid + spread + static_cast<Price>(level), size[levels + level] });
+			}
+		}
+	}
+
+	const OrderbookConfig config{ .prepopulate_ = false, .expireGoodForDay_ = false, .transactionLog_ = false };
+	auto run = [&](const std::string& name, auto&& apply)
+		{
+			QuotingResult result;
+			result.name_ = name;
+			result.refreshes_ = refreshes.size();
+			result.quotes_ = refreshes.size() * 2 * levels;
+
+			Orderbook orderbook{ config };
+			for (const auto& operation : setup_)
+				Apply(orderbook, operation);
+
+			std::vector<std::uint32_t> latencies;
+			latencies.reserve(refreshes.size());
+			const auto start = Clock::now();
+			for (const auto& refresh : refreshes)
+			{
+				const auto begin = Clock::now();
+				apply(orderbook, refresh);
+				latencies.push_back(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count()));
+			}
+			result.seconds_ = std::chrono::duration<double>(Clock::now() - start).count();
+
+			result.p50_ = Percentile(latencies, 0.50);
+			result.p99_ = Percentile(latencies, 0.99);
+			return result;
+		};
+
+	QuotingResults results;
+	results.push_back(run("modify per quote", [](Orderbook& orderbook, const Refresh& refresh)
+		{
+			auto send = [&](Side side, const std::vector<Quote>& quotes)
+				{
+					for (const auto& quote : quotes)
+					{
+						if (orderbook.GetOrderStatus(quote.orderId_).has_value())
+							orderbook.ModifyOrder(OrderModify{ quote.orderId_, side, quote.price_, quote.quantity_ });
+						else
+						{
+							auto order = orderbook.CreateOrder(OrderType::GoodTillCancel, quote.orderId_, side, quote.price_, quote.quantity_);
+							order->SetAccount(refresh.maker_);
+							orderbook.AddOrder(order);
+						}
+					}
+				};
+			send(Side::Buy, refresh.bids_);
+			send(Side::Sell, refresh.asks_);
+		}));
+
+	LevelUpdates updates;
+	results.push_back(run("ReplaceQuotes", [&updates](Orderbook& orderbook, const Refresh& refresh)
+		{
+			orderbook.ReplaceQuotes(refresh.maker_, refresh.bids_, refresh.asks_, &updates);
+		}));
+	return results;
+}
+
+KernelResults Benchmark::RunDepthKernels(const std::vector<std::size_t>& depths) const
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Level sizes as the flow rests them, repeated when a depth asks for more than the setup has
+	std::vector<Quantity> quantities;
+	for (const auto& operation : setup_)
+		quantities.push_back(operation.quantity_);
+	if (quantities.empty())
+		quantities.push_back(100);
+
+	const auto scalar = DepthKernels::Scalar();
+	const auto& active = DepthKernels::Active();
+	std::uint64_t sink{ 0 };
+
+	// Roughly the same amount of work at every depth so the short runs get enough calls to time
+	// Both go through the table as the book does, the volatile read keeps the scalar calls from being hoisted
+	auto time = [&](std::size_t depth, const DepthKernels::Table& table, auto&& run)
+		{
+			const DepthKernels::Table* volatile kernels = &table;
+			const auto calls = std::max<std::size_t>(options_.operations_ * 16 / depth, 1);
+			const auto start = Clock::now();
+			for (std::size_t i = 0; i < calls; i++)
+				sink += run(*kernels);
+			return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls;
+		};
+
+	KernelResults results;
+	for (const auto depth : depths)
+	{
+		std::vector<Quantity> levels(depth);
+		for (std::size_t i = 0; i < depth; i++)
+			levels[i] = quantities[i % quantities.size()];
+		std::vector<std::uint64_t> prefix(depth);
+		const auto half = scalar.sum_(levels.data(), depth) / 2;
+
+		auto measure = [&](const std::string& kernel, auto&& run)
+			{
+				KernelResult result{ kernel, depth, active.name_ };
+				result.scalarNs_ = time(depth, scalar, run);
+				result.activeNs_ = time(depth, active, run);
+				results.push_back(result);
+			};
+
+		measure("sum", [&](const DepthKernels::Table& kernels) { return kernels.sum_(levels.data(), depth); });
+		measure("prefix", [&](const DepthKernels::Table& kernels) { kernels.prefix_(levels.data(), depth, prefix.data()); return prefix.back(); });
+		measure("sweep", [&](const DepthKernels::Table& kernels) { return static_cast<std::uint64_t>(kernels.sweep_(levels.data(), depth, half)); });
+
+		std::vector<Quantity> shares(depth);
+		const auto total = static_cast<Quantity>(std::min<std::uint64_t>(2 * half + 1, std::numeric_limits<Quantity>::max()));
+		measure("pro-rata", [&](const DepthKernels::Table& kernels) { return kernels.proRata_(levels.data(), depth, total / 2, total, 1, shares.data()); });
+	}
+
+	// Keeps the calls from being optimized away
+	if (sink == 42)
+		results.front().kernel_ += " ";
+	return results;
+}
+
+MatchingResults Benchmark::RunMatching(const std::vector<std::size_t>& depths) const
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct FillCounter : BookEventListener
+	{
+		void OnBookEvent(const BookEvent& event) override { fills_ += event.type_ == BookEventType::Fill; }
+		std::size_t fills_{ };
+	};
+
+	const std::pair<std::string, MatchingAlgorithm> policies[] = {
+		{ "FIFO", MatchingAlgorithm::Fifo },
+		{ "pro-rata", MatchingAlgorithm::ProRata },
+		{ "top order pro-rata", MatchingAlgorithm::TopOrderProRata },
+	};
+
+	constexpr Price LevelPrice = 1'000;
+	constexpr std::size_t AggressorsPerRound = 10;
+
+	MatchingResults results;
+	for (const auto depth : depths)
+	{
+		const auto rounds = std::max<std::size_t>(200'000 / depth, 20);
+		for (const auto& [name, algorithm] : policies)
+		{
+			auto config = OrderbookConfig{ .prepopulate_ = false, .expireGoodForDay_ = false, .transactionLog_ = false };
+			config.matching_ = MatchingPolicy{ algorithm, 1 };
+
+			MatchingResult result{ name, depth, rounds * AggressorsPerRound };
+			std::vector<std::uint32_t> latencies;
+			latencies.reserve(result.aggressors_);
+			std::size_t fills{ };
+
+			for (std::size_t round = 0; round < rounds; round++)
+			{
+				Orderbook orderbook{ config };
+				FillCounter counter;
+				orderbook.AddListener(&counter);
+
+				std::uint64_t total{ };
+				OrderId orderId{ 1 };
+				for (std::size_t i = 0; i < depth; i++)
+				{
+					const auto quantity = setup_.empty() ? Quantity{ 100 } : setup_[(round * depth + i) % setup_.size()].quantity_;
+					orderbook.AddLimit(OrderCommand{ orderId++, Side::Sell, LevelPrice, quantity });
+					total += quantity;
+				}
+
+				const auto size = static_cast<Quantity>(std::max<std::uint64_t>(total / 20, 1));
+				for (std::size_t i = 0; i < AggressorsPerRound; i++)
+				{
+					const auto begin = Clock::now();
+					orderbook.AddIOC(OrderCommand{ orderId++, Side::Buy, LevelPrice, size });
+					latencies.push_back(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count()));
+				}
+
+				// Every fill is published once per side, the aggressor's half isn't a resting order
+				fills += counter.fills_ / 2;
+				orderbook.RemoveListener(&counter);
+			}
+
+			result.fills_ = static_cast<double>(fills) / result.aggressors_;
+			result.p50_ = Percentile(latencies, 0.50);
+			result.p99_ = Percentile(latencies, 0.99);
+			results.push_back(result);
+		}
+	}
+	return results;
+}
+
+FeedResults Benchmark::RunFeedLoading(const std::filesystem::path& directory) const
+{
+	using Clock = std::chrono::steady_clock;
+
+	Informations actions{ setup_ };
+	actions.insert(actions.end(), operations_.begin(), operations_.end());
+
+	const auto text = directory / "OrderBookFeedBenchmark.txt";
+	const auto raw = directory / "OrderBookFeedBenchmark.feed";
+	const auto compressed = directory / "OrderBookFeedBenchmark.packed.feed";
+	{
+		std::ofstream file{ text };
+		for (const auto& action : actions)
+			ScenarioWriter::Write(file, action);
+	}
+	FeedWriter::Convert(text, raw);
+	FeedWriter::Convert(text, compressed, FeedOptions{ .compress_ = true });
+
+	// Best of a few, the files are in the page cache after the first
+	auto best = [](auto&& run)
+		{
+			double seconds = std::numeric_limits<double>::max();
+			for (int i = 0; i < 3; i++)
+			{
+				const auto start = Clock::now();
+				run();
+				seconds = std::min(seconds, std::chrono::duration<double>(Clock::now() - start).count());
+			}
+			return seconds;
+		};
+
+	const std::pair<std::string, std::filesystem::path> formats[] = {
+		{ "scenario text", text },
+		{ "raw feed", raw },
+		{ "compressed feed", compressed },
+	};
+
+	FeedResults results;
+	for (const auto& [name, path] : formats)
+	{
+		FeedResult result{ name, actions.size(), std::filesystem::file_size(path) };
+
+		// Every action's fields touched once, what handing them to the book needs at least
+		volatile std::uint64_t sink{ };
+		result.loadSeconds_ = best([&]
+			{
+				std::uint64_t sum{ };
+				if (FeedFile::Is(path))
+					FeedReader{ path }.ForEach([&sum](const FeedRecord& record) { sum += record.orderId_ + record.quantity_; });
+				else
+				{
+					const auto [parsed, expected] = InputHandler{ }.GetRecording(path);
+					for (const auto& action : parsed)
+						sum += action.orderId_ + action.quantity_;
+				}
+				sink = sum;
+			});
+
+		result.replaySeconds_ = best([&] { result.checksum_ = ScenarioRunner::Replay(path).checksum_; });
+		results.push_back(result);
+	}
+
+	for (const auto& [name, path] : formats)
+		std::filesystem::remove(path);
+	return results;
+}
+
+void Benchmark::Print(const MatchingResults& results, std::ostream& out)
+{
+	out << std::left << std::setw(20) << "matching" << std::right << std::setw(8) << "depth" << std::setw(12) << "aggressors"
+		<< std::setw(14) << "fills/order" << std::setw(10) << "p50 ns" << std::setw(10) << "p99 ns" << std::setw(12) << "ns/fill" << '\n';
+
+	for (const auto& result : results)
+	{
+		const auto perFill = result.fills_ > 0 ? result.p50_ / result.fills_ : 0.0;
+		out << std::left << std::setw(20) << result.name_ << std::right << std::setw(8) << result.depth_ << std::setw(12) << result.aggressors_
+			<< std::fixed << std::setprecision(1) << std::setw(14) << result.fills_ << std::setprecision(0)
+			<< std::setw(10) << result.p50_ << std::setw(10) << result.p99_ << std::setprecision(1) << std::setw(12) << perFill << '\n';
+	}
+}
+
+void Benchmark::Print(const FeedResults& results, std::ostream& out)
+{
+	out << std::left << std::setw(18) << "format" << std::right << std::setw(12) << "bytes" << std::setw(14) << "load msgs/s"
+		<< std::setw(14) << "load ms" << std::setw(14) << "replay ms" << "  checksum\n";
+
+	for (const auto& result : results)
+	{
+		const auto rate = result.loadSeconds_ > 0 ? result.messages_ / result.loadSeconds_ : 0.0;
+		out << std::left << std::setw(18) << result.name_ << std::right << std::setw(12) << result.bytes_ << std::fixed << std::setprecision(0)
+			<< std::setw(14) << rate << std::setprecision(1) << std::setw(14) << result.loadSeconds_ * 1'000 << std::setw(14) << result.replaySeconds_ * 1'000
+			<< "  " << std::hex << std::setw(16) << std::setfill('0') << result.checksum_ << std::dec << std::setfill(' ') << '\n';
+	}
+}
+
+void Benchmark::Print(const KernelResults& results, std::ostream& out)
+{
+	out << std::left << std::setw(10) << "kernel" << std::right << std::setw(8) << "depth" << std::setw(14) << "scalar ns"
+		<< std::setw(14) << "dispatched ns" << std::setw(10) << "speedup" << "  dispatched\n";
+
+	for (const auto& result : results)
+	{
+		const auto speedup = result.activeNs_ > 0 ? result.scalarNs_ / result.activeNs_ : 0.0;
+		out << std::left << std::setw(10) << result.kernel_ << std::right << std::setw(8) << result.depth_ << std::fixed
+			<< std::setprecision(1) << std::setw(14) << result.scalarNs_ << std::setw(14) << result.activeNs_
+			<< std::setprecision(2) << std::setw(10) << speedup << "  " << result.active_ << '\n';
+	}
+}
+
+void Benchmark::Print(const QuotingResults& results, std::ostream& out)
+{
+	out << std::left << std::setw(20) << "quoting" << std::right << std::setw(12) << "quotes/s" << std::setw(12) << "refreshes/s"
+		<< std::setw(16) << "refresh p50 ns" << std::setw(16) << "refresh p99 ns" << '\n';
+
+	for (const auto& result : results)
+	{
+		const auto quotes = result.seconds_ > 0 ? result.quotes_ / result.seconds_ : 0.0;
+		const auto refreshes = result.seconds_ > 0 ? result.refreshes_ / result.seconds_ : 0.0;
+		out << std::left << std::setw(20) << result.name_ << std::right << std::fixed << std::setprecision(0)
+			<< std::setw(12) << quotes << std::setw(12) << refreshes << std::setw(16) << result.p50_ << std::setw(16) << result.p99_ << '\n';
+	}
+}
+
+void Benchmark::Print(const BenchmarkResults& results, std::ostream& out)
+{
+	out << std::left << std::setw(30) << "configuration" << std::right
+		<< std::setw(12) << "ops/s" << std::setw(10) << "p50 ns" << std::setw(10) << "p99 ns" << std::setw(10) << "p99.9 ns"
+		<< std::setw(12) << "faults" << "  notes\n";
+
+	for (const auto& result : results)
+	{
+		const auto throughput = result.seconds_ > 0 ? result.operations_ / result.seconds_ : 0.0;
+		out << std::left << std::setw(30) << result.name_ << std::right << std::fixed << std::setprecision(0)
+			<< std::setw(12) << throughput << std::setw(10) << result.p50_ << std::setw(10) << result.p99_ << std::setw(10) << result.p999_
+			<< std::setw(12) << result.minorFaults_ << "  "
+			<< (result.hugePages_ ? "hugepages " : "") << (result.pinned_ ? "pinned" : "") << '\n';
+	}
+
+	for (const auto& result : results)
+	{
+		if (result.profile_.Empty())
+			continue;
+
+		out << '\n' << result.name_;
+		result.profile_.Print(out);
+	}
+}
+
+void Benchmark::Print(const DurabilityResults& results, std::ostream& out)
+{
+	out << std::right << std::setw(8) << "batch" << std::setw(12) << "delay us" << std::setw(12) << "orders/s"
+		<< std::setw(12) << "ack p50 us" << std::setw(12) << "ack p99 us" << std::setw(10) << "commits" << std::setw(12) << "per commit" << "  notes\n";
+
+	for (const auto& result : results)
+	{
+		const auto throughput = result.seconds_ > 0 ? result.orders_ / result.seconds_ : 0.0;
+		const auto perCommit = result.commits_ > 0 ? static_cast<double>(result.orders_) / result.commits_ : 0.0;
+		out << std::setw(8) << result.setting_.batchEvents_ << std::setw(12) << result.setting_.maxDelay_.count()
+			<< std::fixed << std::setprecision(0) << std::setw(12) << throughput
+			<< std::setprecision(1) << std::setw(12) << result.p50_ << std::setw(12) << result.p99_
+			<< std::setw(10) << result.commits_ << std::setw(12) << perCommit
+			<< "  " << (result.ioUring_ ? "io_uring" : "pwrite") << '\n';
+	}
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "FlowGenerator.h"
+#include "OrderbookConfig.h"
+#include "PerfCounters.h"
+#include "PreTradeRisk.h"
+
+struct BenchmarkOptions
+{
+    std::size_t restingOrders_{ 200'000 };  // Depth of the book built before measuring
+    std::size_t operations_{ 1'000'000 };   // Measured messages, drawn from flow_
+    FlowOptions flow_;                      // Shape & seed of the order flow
+    int core_{ -1 };                        // Matching core for the pinned run
+    std::size_t arenaBytes_{ 512ull * 1024 * 1024 };
+    bool profile_{ false };                 // Wrap every measured operation in hardware counters
+};
+
+struct BenchmarkResult
+{
+    std::string name_;
+    std::size_t operations_{ };
+    double seconds_{ };
+    double p50_{ };     // Latency per operation in nanoseconds
+    double p99_{ };
+    double p999_{ };
+    long minorFaults_{ -1 }; // Page faults taken during the measured phase, -1 when the platform doesn't tell
+    bool hugePages_{ false };
+    bool pinned_{ false };
+    PerfProfile profile_;   // Per operation type, only filled when profiling
+};
+
+using BenchmarkResults = std::vector<BenchmarkResult>;
+
+// One group commit setting of the durable journal benchmark
+struct DurabilitySetting
+{
+    std::size_t batchEvents_;
+    std::chrono::microseconds maxDelay_;
+};
+
+struct DurabilityResult
+{
+    DurabilitySetting setting_{ };
+    std::size_t orders_{ };
+    double seconds_{ };     // From the first order to the last ack
+    double p50_{ };         // Ack latency (order in until its batch is durable) in microseconds
+    double p99_{ };
+    std::uint64_t commits_{ };
+    bool ioUring_{ false };
+};
+
+using DurabilityResults = std::vector<DurabilityResult>;
+
+// Market makers refreshing their quotes, measured per quote rather than per order
+struct QuotingResult
+{
+    std::string name_;
+    std::size_t refreshes_{ };
+    std::size_t quotes_{ };     // Every level of every refresh, changed or not
+    double seconds_{ };
+    double p50_{ };             // Latency of a whole refresh in nanoseconds
+    double p99_{ };
+};
+
+using QuotingResults = std::vector<QuotingResult>;
+
+// One depth kernel over depth_ levels, the scalar version against the one DepthKernels dispatches to
+struct KernelResult
+{
+    std::string kernel_;
+    std::size_t depth_{ };
+    std::string active_;    // Name of the dispatched kernels, "scalar" when the CPU has no AVX2
+    double scalarNs_{ };    // Per call
+    double activeNs_{ };
+};
+
+using KernelResults = std::vector<KernelResult>;
+
+// Aggressors against one deep level under a matching policy
+struct MatchingResult
+{
+    std::string name_;
+    std::size_t depth_{ };      // Orders resting at the level
+    std::size_t aggressors_{ };
+    double fills_{ };           // Resting orders filled per aggressor
+    double p50_{ };             // Latency of an aggressor in nanoseconds
+    double p99_{ };
+};
+
+using MatchingResults = std::vector<MatchingResult>;
+
+// One format of the same recorded session: loading is reading every action, replay is the whole ScenarioRunner::Replay
+struct FeedResult
+{
+    std::string name_;
+    std::size_t messages_{ };
+    std::uintmax_t bytes_{ };
+    double loadSeconds_{ };
+    double replaySeconds_{ };
+    std::uint64_t checksum_{ };     // Of the replay, equal for every format
+};
+
+using FeedResults = std::vector<FeedResult>;
+
+// Replays the same seeded workload against differently configured books and reports latency & throughput
+class Benchmark
+{
+public:
+    explicit Benchmark(const BenchmarkOptions& options);
+
+    // With a risk check every add & modify goes through it first
+    BenchmarkResult Run(const std::string& name, const OrderbookConfig& config, PreTradeCheck* risk = nullptr) const;
+
+    // Heap vs arena vs huge page arena pinned to a core, and the heap book behind a pre-trade risk check
+    BenchmarkResults RunMemoryConfigurations() const;
+
+    static void Print(const BenchmarkResults& results, std::ostream& out);
+
+    // Ack latency against throughput of a DurableJournal in directory for each batch setting
+    // Orders arrive at ordersPerSecond and each is acked once the journal made its events durable
+    DurabilityResults RunDurability(const std::filesystem::path& directory, const std::vector<DurabilitySetting>& settings,
+        std::size_t orders, double ordersPerSecond) const;
+
+    static void Print(const DurabilityResults& results, std::ostream& out);
+
+    // Submit to response round trip through the shared memory order entry rings, one order in flight
+    // The matching thread polls the rings on core (when given), the caller plays the local client
+    BenchmarkResult RunSharedMemoryEntry(const std::string& segment) const;
+
+    // The same flow with market data & journaling listeners, once all on the calling thread
+    // and once through the staged EnginePipeline (latency is submit to response there)
+    BenchmarkResults RunPipeline() const;
+
+    // The flow run directly against the book, then through a ReplicationPrimary streaming to a
+    // ReplicationBackup on this host (its own thread, its own book) over a Unix domain socket
+    BenchmarkResults RunReplication() const;
+
+    // The flow split over clients that each wait for one command before sending the next: once with an OS thread
+    // per client calling the book, once as coroutines on an AsyncOrderbook with threads executor threads
+    // Latency is per command, from the call (or co_await) until the client runs again
+    BenchmarkResults RunAsyncClients(std::size_t clients = 1'000, std::size_t threads = 2) const;
+
+    // makers market makers each refreshing levels quotes a side on top of the setup book, most refreshes
+    // only touch a level or two. Once with a ModifyOrder (or AddOrder for a quote that traded away) per quote,
+    // once with a single ReplaceQuotes per refresh
+    QuotingResults RunQuoting(std::size_t makers = 8, std::size_t levels = 10) const;
+
+    static void Print(const QuotingResults& results, std::ostream& out);
+
+    // Sum, cumulative depth and sweep over depths of the setup book's quantities, the sweep goes halfway down
+    KernelResults RunDepthKernels(const std::vector<std::size_t>& depths = { 4, 16, 64, 256, 1'024, 4'096 }) const;
+
+    static void Print(const KernelResults& results, std::ostream& out);
+
+    // FIFO, pro-rata & top order pro-rata at each depth: a level of depth setup sized orders,
+    // then IOCs taking 5% of it each till half of it is gone, on a fresh level every round
+    MatchingResults RunMatching(const std::vector<std::size_t>& depths = { 10, 100, 1'000, 10'000 }) const;
+
+    static void Print(const MatchingResults& results, std::ostream& out);
+
+    // The setup & the measured flow written to directory as a scenario file, a raw feed and a compressed feed
+    FeedResults RunFeedLoading(const std::filesystem::path& directory) const;
+    static void Print(const FeedResults& results, std::ostream& out);
+
+private:
+    void Generate();
+
+    BenchmarkOptions options_;
+    Informations setup_;
+    Informations operations_;
+};
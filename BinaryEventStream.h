@@ -0,0 +1,39 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "BookEvent.h"
+
+// Per fill detail of the book as a stream of raw fixed size BookEvent records
+// Attach it with Orderbook::AddListener, read it back with ReadAll
+class BinaryEventStream : public BookEventListener
+{
+public:
+    explicit BinaryEventStream(std::ostream& out)
+        : out_{ out }
+    { }
+
+    void OnBookEvent(const BookEvent& event) override
+    {
+        out_.write(reinterpret_cast<const char*>(&event), sizeof(BookEvent));
+        count_++;
+    }
+
+    std::size_t Count() const { return count_; }
+
+    static std::vector<BookEvent> ReadAll(std::istream& in)
+    {
+        std::vector<BookEvent> events;
+        BookEvent event;
+        while (in.read(reinterpret_cast<char*>(&event), sizeof(BookEvent)))
+            events.push_back(event);
+
+        return events;
+    }
+
+private:
+    std::ostream& out_;
+    std::size_t count_{ 0 };
+};
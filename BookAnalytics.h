@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include "BookEvent.h"
+
+// Counts of what happened on the book this session
+struct OrderFlowCounts
+{
+    std::uint64_t adds_{ };
+    std::uint64_t cancels_{ };
+    std::uint64_t trades_{ };
+    Quantity buyVolume_{ };     // Traded volume where the aggressor was a buyer
+    Quantity sellVolume_{ };
+};
+
+// Everything a strategy reads on a tick, as of the last event the analytics saw
+struct BookMetrics
+{
+    std::uint64_t sequence_{ };
+    std::optional<Price> bestBid_;
+    std::optional<Price> bestAsk_;
+    std::optional<double> mid_;
+    std::optional<double> microprice_;  // Mid weighted by the opposite top of book quantity
+    std::optional<double> imbalance_;   // (bid - ask) / (bid + ask) over the top N levels, -1..1
+    std::optional<double> vwap_;        // Session VWAP of every trade
+    Quantity volume_{ };
+    OrderFlowCounts flow_;
+};
+
+// Microstructure metrics kept up to date from the book's events: attach it with Orderbook::AddListener
+// It keeps its own aggregated depth, so neither updates nor reads ever touch the book's levels or orders
+// An event costs a hash update plus a map update of the level it touched (log of the number of levels),
+// the top N sums only get rewalked when a level appears or disappears inside the top N
+class BookAnalytics : public BookEventListener
+{
+public:
+    explicit BookAnalytics(std::size_t imbalanceDepth = 5)
+        : depth_{ imbalanceDepth == 0 ? 1 : imbalanceDepth }
+    { }
+
+    void OnBookEvent(const BookEvent& event) override
+    {
+        std::scoped_lock lock{ mutex_ };
+        sequence_ = event.sequence_;
+
+        switch (event.type_)
+        {
+            case BookEventType::Add:
+                flow_.adds_++;
+                lastAdded_ = event.orderId_;
+                Apply(event.side_, event.price_, static_cast<std::int64_t>(event.quantity_));
+                break;
+            case BookEventType::Cancel:
+                flow_.cancels_++;
+                Apply(event.side_, event.price_, -static_cast<std::int64_t>(event.quantity_));
+                break;
+            case BookEventType::Fill:
+                Apply(event.side_, event.price_, -static_cast<std::int64_t>(event.quantity_));
+                OnFill(event);
+                break;
+        }
+    }
+
+    BookMetrics Metrics() const
+    {
+        std::scoped_lock lock{ mutex_ };
+
+        BookMetrics metrics;
+        metrics.sequence_ = sequence_;
+        metrics.volume_ = volume_;
+        metrics.flow_ = flow_;
+        if (volume_ > 0)
+            metrics.vwap_ = notional_ / volume_;
+
+        if (!bids_.empty())
+            metrics.bestBid_ = bids_.begin()->first;
+        if (!asks_.empty())
+            metrics.bestAsk_ = asks_.begin()->first;
+
+        if (metrics.bestBid_ && metrics.bestAsk_)
+        {
+            const double bid = *metrics.bestBid_, ask = *metrics.bestAsk_;
+            const double bidQuantity = bids_.begin()->second, askQuantity = asks_.begin()->second;
+            metrics.mid_ = (bid + ask) / 2.0;
+            metrics.microprice_ = (bid * askQuantity + ask * bidQuantity) / (bidQuantity + askQuantity);
+        }
+
+        if (bidTop_ + askTop_ > 0)
+            metrics.imbalance_ = (static_cast<double>(bidTop_) - static_cast<double>(askTop_)) / static_cast<double>(bidTop_ + askTop_);
+
+        return metrics;
+    }
+
+    // Volume traded at one price this session
+    Quantity TradedVolumeAt(Price price) const
+    {
+        std::scoped_lock lock{ mutex_ };
+        const auto it = tradedVolume_.find(price);
+        return it == tradedVolume_.end() ? 0 : it->second;
+    }
+
+    // Volume profile of the session, sorted by price
+    std::map<Price, Quantity> TradedVolume() const
+    {
+        std::scoped_lock lock{ mutex_ };
+        return std::map<Price, Quantity>(tradedVolume_.begin(), tradedVolume_.end());
+    }
+
+private:
+    // Applies a quantity change to one level and keeps the top N sum of its side in step
+    template<typename Levels>
+    void Apply(Levels& levels, Quantity& top, Price price, std::int64_t delta)
+    {
+        auto [it, created] = levels.try_emplace(price, 0);
+        it->second = static_cast<Quantity>(static_cast<std::int64_t>(it->second) + delta);
+        const bool removed = it->second == 0;
+        if (removed)
+            levels.erase(it);
+
+        // The top N is the first depth_ levels: a level inside it changing size moves the sum,
+        // a level appearing or disappearing inside it shifts which levels are in it
+        const bool inTop = levels.size() < depth_ || !levels.key_comp()(Boundary(levels), price);
+        if (!inTop)
+            return;
+
+        if (created || removed)
+            top = SumTop(levels);
+        else
+            top = static_cast<Quantity>(static_cast<std::int64_t>(top) + delta);
+    }
+
+    void Apply(Side side, Price price, std::int64_t delta)
+    {
+        if (side == Side::Buy)
+            Apply(bids_, bidTop_, price, delta);
+        else
+            Apply(asks_, askTop_, price, delta);
+    }
+
+    // Price of the last level inside the top N (or beyond the last level when there are fewer)
+    template<typename Levels>
+    Price Boundary(const Levels& levels) const
+    {
+        auto it = levels.begin();
+        std::advance(it, depth_ - 1);
+        return it->first;
+    }
+
+    template<typename Levels>
+    Quantity SumTop(const Levels& levels) const
+    {
+        Quantity sum{ };
+        std::size_t count{ };
+        for (auto it = levels.begin(); it != levels.end() && count < depth_; it++, count++)
+            sum += it->second;
+        return sum;
+    }
+
+    // A match publishes one Fill per side, the trade is counted once from the aggressor's side
+    // The aggressor is the order added last (matching only ever happens right after an add)
+    // and the trade happens at the price of the resting order
+    void OnFill(const BookEvent& event)
+    {
+        if (event.contraOrderId_ == lastAdded_)
+            return;
+
+        const bool aggressor = event.orderId_ == lastAdded_;
+        if (!aggressor && event.side_ != Side::Buy)
+            return;
+
+        const auto price = aggressor ? event.contraPrice_ : event.price_;
+        flow_.trades_++;
+        (event.side_ == Side::Buy ? flow_.buyVolume_ : flow_.sellVolume_) += event.quantity_;
+        volume_ += event.quantity_;
+        notional_ += static_cast<double>(price) * event.quantity_;
+        tradedVolume_[price] += event.quantity_;
+    }
+
+    const std::size_t depth_;
+
+    mutable std::mutex mutex_;
+    std::uint64_t sequence_{ };
+    std::map<Price, Quantity, std::greater<Price>> bids_;
+    std::map<Price, Quantity, std::less<Price>> asks_;
+    Quantity bidTop_{ };
+    Quantity askTop_{ };
+
+    OrderId lastAdded_{ };
+    Quantity volume_{ };
+    double notional_{ };
+    std::unordered_map<Price, Quantity> tradedVolume_;
+    OrderFlowCounts flow_;
+};
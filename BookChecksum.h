@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Side.h"
+#include "Usings.h"
+
+// Checksum of a resting book: the wrapping sum of one well mixed 64 bit value per resting order
+// A sum doesn't care in which order the orders arrived, and an add / fill / cancel only swaps
+// one term for another, so the book keeps it up to date in O(1) instead of walking every level
+// Two books holding the same orders (id, side, price, remaining quantity) have the same checksum
+struct BookChecksum
+{
+    // Term of one resting order, a fully filled or cancelled order contributes nothing
+    static std::uint64_t Of(OrderId orderId, Side side, Price price, Quantity remaining)
+    {
+        if (remaining == 0)
+            return 0;
+
+        auto value = Mix(orderId);
+        value = Mix(value ^ (static_cast<std::uint64_t>(static_cast<std::uint32_t>(price)) << 1 | (side == Side::Sell ? 1 : 0)));
+        return Mix(value ^ remaining);
+    }
+
+private:
+    // splitmix64 finalizer: every input bit flips about half of the output bits
+    static std::uint64_t Mix(std::uint64_t value)
+    {
+        value += 0x9e3779b97f4a7c15ull;
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+        return value ^ (value >> 31);
+    }
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+#include "OrderType.h"
+#include "Side.h"
+#include "Usings.h"
+
+// Everything that changes the resting book, published by the Orderbook in sequence
+// An Add is the order entering the book, a Fill is one side of a match (a match publishes 2),
+// a Cancel is the order leaving the book unfilled (explicit cancel, FillAndKill leftover, GoodForDay expiry, modify)
+enum class BookEventType : std::uint8_t
+{
+    Add,
+    Cancel,
+    Fill,
+};
+
+// Fixed size record, written as is by the binary event stream
+struct BookEvent
+{
+    std::uint64_t sequence_;
+    std::int64_t timestamp_;    // Nanoseconds since the epoch (system clock)
+    OrderId orderId_;
+    OrderId contraOrderId_;     // Fill: the order on the other side of the match
+    Price price_;               // Price of the order, for a Fill the price of the resting (contra) order is in contraPrice_
+    Price contraPrice_;
+    Quantity quantity_;         // Add: quantity entering, Fill: quantity filled, Cancel: quantity removed
+    Quantity remaining_;        // Remaining quantity of the order after the event
+    std::uint64_t checksum_;    // BookChecksum of the whole resting book after the event
+    BookEventType type_;
+    Side side_;
+    OrderType orderType_;
+    AccountId account_;         // Account of the order, fits in what used to be padding
+};
+
+// Receives every BookEvent on the thread that changed the book, while the book is still locked
+// so implementations have to be quick and must not call back into the Orderbook
+class BookEventListener
+{
+public:
+    virtual ~BookEventListener() = default;
+    virtual void OnBookEvent(const BookEvent& event) = 0;
+};
@@ -0,0 +1,402 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BookEvent.h"
+#include "MappedFile.h"
+
+// Column oriented file of order level (L3) events and periodic depth snapshots, for analytics jobs
+//
+//     header | chunk | chunk | ... | chunk directory | footer
+//
+// A chunk holds up to chunkRows rows of one table, column after column (each a plain little endian array
+// starting on a 64 byte boundary) with the min & max of every column in the directory. A reader maps the file,
+// picks chunks by their statistics and scans only the columns it needs, the pages of everything else are never read
+enum class ColumnarTable : std::uint32_t
+{
+    Events,     // One row per BookEvent: adds, cancels (a modify is a cancel & an add) and both sides of every fill
+    Depth,      // One row per level of the top of book snapshots
+};
+
+enum class EventColumn : std::uint32_t
+{
+    Sequence,       // u64
+    Timestamp,      // i64, nanoseconds since the epoch
+    OrderId,        // u64
+    ContraOrderId,  // u64, fills only
+    Price,          // i32
+    ContraPrice,    // i32
+    Quantity,       // u32
+    Remaining,      // u32
+    Type,           // u8, BookEventType
+    Side,           // u8
+    OrderType,      // u8
+    Account,        // u32
+    TradePrice,     // i32, fills only: the resting order's price, which is what both sides traded at
+    Count,
+};
+
+enum class DepthColumn : std::uint32_t
+{
+    Sequence,       // u64, last event included in the snapshot
+    Timestamp,      // i64
+    Side,           // u8
+    Level,          // u32, 0 is the best price
+    Price,          // i32
+    Quantity,       // u32
+    OrderCount,     // u32
+    Count,
+};
+
+struct ColumnarFile
+{
+    static constexpr std::uint64_t Magic = 0x324C4F434B4F4F42; // "BOOKCOL2"
+    static constexpr std::size_t MaxColumns = static_cast<std::size_t>(EventColumn::Count);
+    static constexpr std::size_t Alignment = 64;
+
+    static constexpr std::array<std::uint32_t, MaxColumns> EventWidths{ 8, 8, 8, 8, 4, 4, 4, 4, 1, 1, 1, 4, 4 };
+    static constexpr std::array<std::uint32_t, MaxColumns> DepthWidths{ 8, 8, 1, 4, 4, 4, 4 };
+
+    static std::size_t Columns(ColumnarTable table)
+    {
+        return table == ColumnarTable::Events ? static_cast<std::size_t>(EventColumn::Count) : static_cast<std::size_t>(DepthColumn::Count);
+    }
+
+    static std::uint32_t Width(ColumnarTable table, std::size_t column)
+    {
+        return table == ColumnarTable::Events ? EventWidths[column] : DepthWidths[column];
+    }
+};
+
+struct ColumnarHeader
+{
+    std::uint64_t magic_;
+    std::uint64_t version_;
+};
+
+// Directory entry of one chunk, statistics are widened to 64 bits whatever the column's type
+struct ColumnarChunk
+{
+    ColumnarTable table_;
+    std::uint32_t rows_;
+    std::array<std::uint64_t, ColumnarFile::MaxColumns> offsets_;  // File offset of each column
+    std::array<std::int64_t, ColumnarFile::MaxColumns> min_;
+    std::array<std::int64_t, ColumnarFile::MaxColumns> max_;
+};
+
+struct ColumnarFooter
+{
+    std::uint64_t directoryOffset_;
+    std::uint64_t chunkCount_;
+    std::uint64_t magic_;
+};
+
+struct ColumnarOptions
+{
+    std::uint32_t chunkRows_{ 65'536 };
+    std::uint64_t snapshotInterval_{ 10'000 };  // Events between depth snapshots, 0 for none
+    std::uint32_t depthLevels_{ 10 };           // Levels per side in a snapshot
+};
+
+// Exporter side: attach it with Orderbook::AddListener before the first order
+// Rows are buffered per table and written a chunk at a time, the directory & footer go out when the exporter
+// is destroyed and the file is only readable after that
+// It keeps its own aggregated depth for the snapshots, so it never calls back into the book
+class ColumnarExporter : public BookEventListener
+{
+public:
+    explicit ColumnarExporter(const std::filesystem::path& path, const ColumnarOptions& options = { })
+        : file_{ path, std::ios::binary | std::ios::trunc }
+        , options_{ options }
+    {
+        if (!file_)
+            throw std::runtime_error("Cannot open columnar export " + path.string());
+        if (options_.chunkRows_ == 0)
+            options_.chunkRows_ = 1;
+
+        const ColumnarHeader header{ ColumnarFile::Magic, 2 };
+        Write(&header, sizeof(header));
+        events_.reserve(options_.chunkRows_);
+    }
+
+    ~ColumnarExporter() override
+    {
+        FlushEvents();
+        FlushDepth();
+
+        Pad();
+        const ColumnarFooter footer{ offset_, chunks_.size(), ColumnarFile::Magic };
+        Write(chunks_.data(), chunks_.size() * sizeof(ColumnarChunk));
+        Write(&footer, sizeof(footer));
+    }
+
+    void OnBookEvent(const BookEvent& event) override
+    {
+        // The book is uncrossed between commands, so the fills that follow an add all involve that order
+        // The aggressor trades at the resting order's price, the resting order at its own
+        if (event.type_ == BookEventType::Add)
+            aggressor_ = event.orderId_;
+        const bool fill = event.type_ == BookEventType::Fill;
+        tradePrices_.push_back(!fill ? 0 : event.orderId_ == aggressor_ ? event.contraPrice_ : event.price_);
+
+        events_.push_back(event);
+        if (events_.size() == options_.chunkRows_)
+            FlushEvents();
+
+        ApplyToDepth(event);
+        if (options_.snapshotInterval_ > 0 && ++sinceSnapshot_ == options_.snapshotInterval_)
+        {
+            Snapshot(event);
+            sinceSnapshot_ = 0;
+        }
+    }
+
+private:
+    struct Level
+    {
+        Quantity quantity_{ };
+        std::uint32_t orderCount_{ };
+    };
+
+    struct DepthRow
+    {
+        std::uint64_t sequence_;
+        std::int64_t timestamp_;
+        Side side_;
+        std::uint32_t level_;
+        Price price_;
+        Quantity quantity_;
+        std::uint32_t orderCount_;
+    };
+
+    void ApplyToDepth(const BookEvent& event)
+    {
+        auto update = [&event](auto& levels)
+            {
+                auto& level = levels[event.price_];
+                switch (event.type_)
+                {
+                    case BookEventType::Add:
+                        level.quantity_ += event.quantity_;
+                        level.orderCount_++;
+                        break;
+                    case BookEventType::Cancel:
+                        level.quantity_ -= event.quantity_;
+                        level.orderCount_--;
+                        break;
+                    case BookEventType::Fill:
+                        level.quantity_ -= event.quantity_;
+                        if (event.remaining_ == 0)
+                            level.orderCount_--;
+                        break;
+                }
+                if (level.orderCount_ == 0)
+                    levels.erase(event.price_);
+            };
+
+        if (event.side_ == Side::Buy)
+            update(bids_);
+        else
+            update(asks_);
+    }
+
+    void Snapshot(const BookEvent& event)
+    {
+        auto take = [&](Side side, const auto& levels)
+            {
+                std::uint32_t index = 0;
+                for (auto it = levels.begin(); it != levels.end() && index < options_.depthLevels_; ++it, index++)
+                {
+                    depth_.push_back(DepthRow{ event.sequence_, event.timestamp_, side, index, it->first, it->second.quantity_, it->second.orderCount_ });
+                    if (depth_.size() == options_.chunkRows_)
+                        FlushDepth();
+                }
+            };
+        take(Side::Buy, bids_);
+        take(Side::Sell, asks_);
+    }
+
+    void FlushEvents()
+    {
+        if (events_.empty())
+            return;
+
+        ColumnarChunk chunk{ ColumnarTable::Events, static_cast<std::uint32_t>(events_.size()), { }, { }, { } };
+        WriteColumn<std::uint64_t>(chunk, EventColumn::Sequence, events_, [](const BookEvent& event) { return event.sequence_; });
+        WriteColumn<std::int64_t>(chunk, EventColumn::Timestamp, events_, [](const BookEvent& event) { return event.timestamp_; });
+        WriteColumn<std::uint64_t>(chunk, EventColumn::OrderId, events_, [](const BookEvent& event) { return event.orderId_; });
+        WriteColumn<std::uint64_t>(chunk, EventColumn::ContraOrderId, events_, [](const BookEvent& event) { return event.contraOrderId_; });
+        WriteColumn<std::int32_t>(chunk, EventColumn::Price, events_, [](const BookEvent& event) { return event.price_; });
+        WriteColumn<std::int32_t>(chunk, EventColumn::ContraPrice, events_, [](const BookEvent& event) { return event.contraPrice_; });
+        WriteColumn<std::uint32_t>(chunk, EventColumn::Quantity, events_, [](const BookEvent& event) { return event.quantity_; });
+        WriteColumn<std::uint32_t>(chunk, EventColumn::Remaining, events_, [](const BookEvent& event) { return event.remaining_; });
+        WriteColumn<std::uint8_t>(chunk, EventColumn::Type, events_, [](const BookEvent& event) { return static_cast<std::uint8_t>(event.type_); });
+        WriteColumn<std::uint8_t>(chunk, EventColumn::Side, events_, [](const BookEvent& event) { return static_cast<std::uint8_t>(event.side_); });
+        WriteColumn<std::uint8_t>(chunk, EventColumn::OrderType, events_, [](const BookEvent& event) { return static_cast<std::uint8_t>(event.orderType_); });
+        WriteColumn<std::uint32_t>(chunk, EventColumn::Account, events_, [](const BookEvent& event) { return event.account_; });
+        WriteColumn<std::int32_t>(chunk, EventColumn::TradePrice, tradePrices_, [](Price price) { return price; });
+
+        chunks_.push_back(chunk);
+        events_.clear();
+        tradePrices_.clear();
+    }
+
+    void FlushDepth()
+    {
+        if (depth_.empty())
+            return;
+
+        ColumnarChunk chunk{ ColumnarTable::Depth, static_cast<std::uint32_t>(depth_.size()), { }, { }, { } };
+        WriteColumn<std::uint64_t>(chunk, DepthColumn::Sequence, depth_, [](const DepthRow& row) { return row.sequence_; });
+        WriteColumn<std::int64_t>(chunk, DepthColumn::Timestamp, depth_, [](const DepthRow& row) { return row.timestamp_; });
+        WriteColumn<std::uint8_t>(chunk, DepthColumn::Side, depth_, [](const DepthRow& row) { return static_cast<std::uint8_t>(row.side_); });
+        WriteColumn<std::uint32_t>(chunk, DepthColumn::Level, depth_, [](const DepthRow& row) { return row.level_; });
+        WriteColumn<std::int32_t>(chunk, DepthColumn::Price, depth_, [](const DepthRow& row) { return row.price_; });
+        WriteColumn<std::uint32_t>(chunk, DepthColumn::Quantity, depth_, [](const DepthRow& row) { return row.quantity_; });
+        WriteColumn<std::uint32_t>(chunk, DepthColumn::OrderCount, depth_, [](const DepthRow& row) { return row.orderCount_; });
+
+        chunks_.push_back(chunk);
+        depth_.clear();
+    }
+
+    // Transposes one field of the buffered rows into its column, collecting the statistics on the way
+    template<typename T, typename Column, typename Row, typename Field>
+    void WriteColumn(ColumnarChunk& chunk, Column column, const std::vector<Row>& rows, Field&& field)
+    {
+        const auto index = static_cast<std::size_t>(column);
+        column_.resize(rows.size() * sizeof(T));
+
+        auto min = std::numeric_limits<std::int64_t>::max();
+        auto max = std::numeric_limits<std::int64_t>::min();
+        for (std::size_t i = 0; i < rows.size(); i++)
+        {
+            const T value = static_cast<T>(field(rows[i]));
+            std::memcpy(column_.data() + i * sizeof(T), &value, sizeof(T));
+            min = std::min<std::int64_t>(min, static_cast<std::int64_t>(value));
+            max = std::max<std::int64_t>(max, static_cast<std::int64_t>(value));
+        }
+
+        Pad();
+        chunk.offsets_[index] = offset_;
+        chunk.min_[index] = min;
+        chunk.max_[index] = max;
+        Write(column_.data(), column_.size());
+    }
+
+    void Pad()
+    {
+        static constexpr char zeros[ColumnarFile::Alignment]{ };
+        Write(zeros, (ColumnarFile::Alignment - offset_ % ColumnarFile::Alignment) % ColumnarFile::Alignment);
+    }
+
+    void Write(const void* data, std::size_t size)
+    {
+        file_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        offset_ += size;
+    }
+
+    std::ofstream file_;
+    ColumnarOptions options_;
+    std::uint64_t offset_{ 0 };
+
+    std::vector<BookEvent> events_;
+    std::vector<Price> tradePrices_;        // Alongside events_, worked out as they come in
+    OrderId aggressor_{ 0 };                // Order of the last add
+    std::vector<DepthRow> depth_;
+    std::vector<std::uint8_t> column_;      // Scratch for the column being written
+    std::vector<ColumnarChunk> chunks_;
+
+    std::map<Price, Level, std::greater<Price>> bids_;
+    std::map<Price, Level, std::less<Price>> asks_;
+    std::uint64_t sinceSnapshot_{ 0 };
+};
+
+// Reader side: maps the file and hands out columns as spans straight into the mapping
+// Column<T> checks T against the column's width, so a wrongly typed read throws instead of returning garbage
+class ColumnarReader
+{
+public:
+    explicit ColumnarReader(const std::filesystem::path& path)
+        : file_{ path }
+    {
+        ColumnarHeader header;
+        ColumnarFooter footer;
+        if (file_.Size() < sizeof(header) + sizeof(footer))
+            throw std::runtime_error("Not a columnar export " + path.string());
+
+        std::memcpy(&header, file_.Data(), sizeof(header));
+        std::memcpy(&footer, file_.Data() + file_.Size() - sizeof(footer), sizeof(footer));
+        if (header.magic_ != ColumnarFile::Magic || footer.magic_ != ColumnarFile::Magic
+            || footer.directoryOffset_ + footer.chunkCount_ * sizeof(ColumnarChunk) + sizeof(footer) != file_.Size())
+            throw std::runtime_error("Not a complete columnar export " + path.string());
+
+        chunks_.resize(footer.chunkCount_);
+        std::memcpy(chunks_.data(), file_.Data() + footer.directoryOffset_, chunks_.size() * sizeof(ColumnarChunk));
+    }
+
+    const std::vector<ColumnarChunk>& Chunks() const { return chunks_; }
+
+    std::uint64_t Rows(ColumnarTable table) const
+    {
+        std::uint64_t rows{ 0 };
+        for (const auto& chunk : chunks_)
+            rows += chunk.table_ == table ? chunk.rows_ : 0;
+        return rows;
+    }
+
+    template<typename T>
+    std::span<const T> Column(const ColumnarChunk& chunk, EventColumn column) const { return Column<T>(chunk, ColumnarTable::Events, static_cast<std::size_t>(column)); }
+
+    template<typename T>
+    std::span<const T> Column(const ColumnarChunk& chunk, DepthColumn column) const { return Column<T>(chunk, ColumnarTable::Depth, static_cast<std::size_t>(column)); }
+
+    // visit(chunk) for each chunk of the column's table whose [min, max] overlaps [low, high], in file order
+    // The others are skipped on their statistics alone. Returns how many were skipped
+    template<typename Visit>
+    std::size_t Scan(EventColumn column, std::int64_t low, std::int64_t high, Visit&& visit) const { return Scan(ColumnarTable::Events, static_cast<std::size_t>(column), low, high, visit); }
+
+    template<typename Visit>
+    std::size_t Scan(DepthColumn column, std::int64_t low, std::int64_t high, Visit&& visit) const { return Scan(ColumnarTable::Depth, static_cast<std::size_t>(column), low, high, visit); }
+
+private:
+    template<typename T>
+    std::span<const T> Column(const ColumnarChunk& chunk, ColumnarTable table, std::size_t column) const
+    {
+        if (chunk.table_ != table || sizeof(T) != ColumnarFile::Width(table, column))
+            throw std::logic_error("Column " + std::to_string(column) + " read with the wrong table or type");
+        return std::span<const T>{ reinterpret_cast<const T*>(file_.Data() + chunk.offsets_[column]), chunk.rows_ };
+    }
+
+    template<typename Visit>
+    std::size_t Scan(ColumnarTable table, std::size_t column, std::int64_t low, std::int64_t high, Visit& visit) const
+    {
+        std::size_t skipped{ 0 };
+        for (const auto& chunk : chunks_)
+        {
+            if (chunk.table_ != table)
+                continue;
+            if (chunk.max_[column] < low || chunk.min_[column] > high)
+            {
+                skipped++;
+                continue;
+            }
+            visit(chunk);
+        }
+        return skipped;
+    }
+
+    MappedFile file_;
+    std::vector<ColumnarChunk> chunks_;
+};
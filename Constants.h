@@ -1,8 +1,10 @@
 #pragma once
+#include <chrono>
 #include <limits>
 #include "Usings.h"
 
 struct Constants
 {
     static const Price InvalidPrice = std::numeric_limits<Price>::quiet_NaN();
+    static constexpr std::chrono::hours MarketClose{ 16 }; // GoodForDay orders expire at 4pm local time
 };
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define DEPTH_KERNELS_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #endif
+#endif
+
+// MSVC emits AVX2 intrinsics anywhere, GCC & Clang only in functions compiled for it
+#if defined(DEPTH_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+    #define DEPTH_KERNELS_AVX2 __attribute__((target("avx2")))
+#else
+    #define DEPTH_KERNELS_AVX2
+#endif
+
+#include "Usings.h"
+
+// Kernels over a run of contiguous quantities: the orders of one level, or one side's levels best price first
+//  - Sum: total of the run
+//  - Prefix: cumulative depth, out[i] is the total of the first i + 1
+//  - LevelsToSweep: how many leading entries an order of that quantity eats through
+//  - ProRata: every entry's share of an incoming quantity, see below
+// Every kernel has a scalar version and an AVX2 one, Active() picks the AVX2 ones once when the CPU has it
+// so the same binary still runs anywhere. Totals are 64 bit, 32 bit quantities can't overflow them
+struct DepthKernels
+{
+    // LevelsToSweep when the whole run can't cover the quantity
+    static constexpr std::size_t Insufficient = static_cast<std::size_t>(-1);
+
+    struct Table
+    {
+        const char* name_;
+        std::uint64_t (*sum_)(const Quantity*, std::size_t) noexcept;
+        void (*prefix_)(const Quantity*, std::size_t, std::uint64_t*) noexcept;
+        std::size_t (*sweep_)(const Quantity*, std::size_t, std::uint64_t) noexcept;
+        std::uint64_t (*proRata_)(const Quantity*, std::size_t, Quantity, Quantity, Quantity, Quantity*) noexcept;
+    };
+
+    static const Table& Active() noexcept
+    {
+        static const Table table = HasAvx2() ? Avx2() : Scalar();
+        return table;
+    }
+
+    static std::uint64_t Sum(const Quantity* quantities, std::size_t count) noexcept { return Active().sum_(quantities, count); }
+    static void Prefix(const Quantity* quantities, std::size_t count, std::uint64_t* out) noexcept { Active().prefix_(quantities, count, out); }
+    static std::size_t LevelsToSweep(const Quantity* quantities, std::size_t count, std::uint64_t quantity) noexcept { return Active().sweep_(quantities, count, quantity); }
+
+    // shares[i] = quantities[i] * incoming / total rounded down, 0 when that's below minimum. Returns the total of the shares
+    // Only for incoming < total, a share is then always less than its entry. Integer only and exact in every kernel,
+    // so every platform allocates the same. What the rounding leaves over is the caller's to hand out
+    static std::uint64_t ProRata(const Quantity* quantities, std::size_t count, Quantity incoming, Quantity total, Quantity minimum, Quantity* shares) noexcept
+    {
+        return Active().proRata_(quantities, count, incoming, total, minimum, shares);
+    }
+
+    static Table Scalar() noexcept { return Table{ "scalar", &SumScalar, &PrefixScalar, &SweepScalar, &ProRataScalar }; }
+
+    // Only call it when HasAvx2()
+    static Table Avx2() noexcept
+    {
+    #if defined(DEPTH_KERNELS_X86)
+        return Table{ "avx2", &SumAvx2, &PrefixAvx2, &SweepAvx2, &ProRataAvx2 };
+    #else
+        return Scalar();
+    #endif
+    }
+
+    static bool HasAvx2() noexcept
+    {
+    #if defined(DEPTH_KERNELS_X86) && defined(_MSC_VER) && !defined(__clang__)
+        // The CPU has to support it and the OS has to save the ymm registers on a context switch
+        int info[4];
+        __cpuid(info, 1);
+        const bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+        __cpuidex(info, 7, 0);
+        return osSavesYmm && (info[1] & (1 << 5));
+    #elif defined(DEPTH_KERNELS_X86)
+        return __builtin_cpu_supports("avx2");
+    #else
+        return false;
+    #endif
+    }
+
+private:
+    static std::uint64_t SumScalar(const Quantity* quantities, std::size_t count) noexcept
+    {
+        std::uint64_t total{ 0 };
+        for (std::size_t i = 0; i < count; i++)
+            total += quantities[i];
+        return total;
+    }
+
+    static void PrefixScalar(const Quantity* quantities, std::size_t count, std::uint64_t* out) noexcept
+    {
+        std::uint64_t total{ 0 };
+        for (std::size_t i = 0; i < count; i++)
+            out[i] = total += quantities[i];
+    }
+
+    static std::size_t SweepScalar(const Quantity* quantities, std::size_t count, std::uint64_t quantity) noexcept
+    {
+        if (quantity == 0)
+            return 0;
+
+        std::uint64_t total{ 0 };
+        for (std::size_t i = 0; i < count; i++)
+        {
+            total += quantities[i];
+            if (total >= quantity)
+                return i + 1;
+        }
+        return Insufficient;
+    }
+
+    static std::uint64_t ProRataScalar(const Quantity* quantities, std::size_t count, Quantity incoming, Quantity total, Quantity minimum, Quantity* shares) noexcept
+    {
+        std::uint64_t allocated{ 0 };
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const auto share = static_cast<Quantity>(static_cast<std::uint64_t>(quantities[i]) * incoming / total);
+            shares[i] = share >= minimum ? share : 0;
+            allocated += shares[i];
+        }
+        return allocated;
+    }
+
+#if defined(DEPTH_KERNELS_X86)
+    // 8 quantities a step, zero extended to 64 bit lanes (their order doesn't matter for a sum)
+    DEPTH_KERNELS_AVX2 static std::uint64_t SumAvx2(const Quantity* quantities, std::size_t count) noexcept
+    {
+        const auto zero = _mm256_setzero_si256();
+        auto low = zero, high = zero;
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const auto values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(quantities + i));
+            low = _mm256_add_epi64(low, _mm256_unpacklo_epi32(values, zero));
+            high = _mm256_add_epi64(high, _mm256_unpackhi_epi32(values, zero));
+        }
+
+        alignas(32) std::uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(low, high));
+        auto total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        for (; i < count; i++)
+            total += quantities[i];
+        return total;
+    }
+
+    // Inclusive scan of 4 quantities in 64 bit lanes [a, b, c, d] -> [a, a+b, a+b+c, a+b+c+d]
+    // It doesn't depend on the blocks before, so the only serial step left between blocks is adding the running total
+    DEPTH_KERNELS_AVX2 static __m256i ScanAvx2(const Quantity* quantities) noexcept
+    {
+        auto values = _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(quantities)));
+        values = _mm256_add_epi64(values, _mm256_slli_si256(values, 8));
+        const auto lowHalf = _mm256_permute4x64_epi64(values, _MM_SHUFFLE(1, 1, 1, 1));
+        return _mm256_add_epi64(values, _mm256_blend_epi32(_mm256_setzero_si256(), lowHalf, 0xF0));
+    }
+
+    DEPTH_KERNELS_AVX2 static __m256i BlockTotal(__m256i scan) noexcept { return _mm256_permute4x64_epi64(scan, _MM_SHUFFLE(3, 3, 3, 3)); }
+
+    DEPTH_KERNELS_AVX2 static void PrefixAvx2(const Quantity* quantities, std::size_t count, std::uint64_t* out) noexcept
+    {
+        auto carry = _mm256_setzero_si256();
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const auto scan = ScanAvx2(quantities + i);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi64(scan, carry));
+            carry = _mm256_add_epi64(carry, BlockTotal(scan));
+        }
+
+        std::uint64_t total = i > 0 ? out[i - 1] : 0;
+        for (; i < count; i++)
+            out[i] = total += quantities[i];
+    }
+
+    // Running totals stay far below 2^63, a signed compare against quantity - 1 is a >= quantity
+    DEPTH_KERNELS_AVX2 static std::size_t SweepAvx2(const Quantity* quantities, std::size_t count, std::uint64_t quantity) noexcept
+    {
+        if (quantity == 0)
+            return 0;
+
+        const auto target = _mm256_set1_epi64x(static_cast<std::int64_t>(quantity - 1));
+        auto carry = _mm256_setzero_si256();
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const auto scan = ScanAvx2(quantities + i);
+            const auto sums = _mm256_add_epi64(scan, carry);
+            const auto reached = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(sums, target)));
+            if (reached)
+                return i + std::countr_zero(static_cast<unsigned>(reached)) + 1;
+            carry = _mm256_add_epi64(carry, BlockTotal(scan));
+        }
+
+        auto total = static_cast<std::uint64_t>(_mm256_extract_epi64(carry, 0));
+        for (; i < count; i++)
+        {
+            total += quantities[i];
+            if (total >= quantity)
+                return i + 1;
+        }
+        return Insufficient;
+    }
+
+    // No vector division: quantity * (incoming * 2^32 / total, rounded down) / 2^32 is the share or 1 below it,
+    // one multiply & compare against quantity * incoming settles which. 4 shares a step in 64 bit lanes
+    DEPTH_KERNELS_AVX2 static std::uint64_t ProRataAvx2(const Quantity* quantities, std::size_t count, Quantity incoming, Quantity total, Quantity minimum, Quantity* shares) noexcept
+    {
+        const auto ratio = _mm256_set1_epi64x(static_cast<std::int64_t>((static_cast<std::uint64_t>(incoming) << 32) / total));
+        const auto wanted = _mm256_set1_epi64x(incoming);
+        const auto divisor = _mm256_set1_epi64x(total);
+        const auto one = _mm256_set1_epi64x(1);
+        const auto sign = _mm256_set1_epi64x(std::numeric_limits<std::int64_t>::min());
+        const auto floor = _mm256_set1_epi64x(static_cast<std::int64_t>(minimum) - 1);
+        const auto pack = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+        auto allocated = _mm256_setzero_si256();
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const auto values = _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(quantities + i)));
+            auto share = _mm256_srli_epi64(_mm256_mul_epu32(values, ratio), 32);
+
+            // share + 1 still fits when (share + 1) * total <= quantity * incoming, unsigned compare through the sign bit
+            const auto next = _mm256_xor_si256(_mm256_mul_epu32(_mm256_add_epi64(share, one), divisor), sign);
+            const auto exact = _mm256_xor_si256(_mm256_mul_epu32(values, wanted), sign);
+            share = _mm256_add_epi64(share, _mm256_andnot_si256(_mm256_cmpgt_epi64(next, exact), one));
+
+            share = _mm256_and_si256(share, _mm256_cmpgt_epi64(share, floor));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(shares + i), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(share, pack)));
+            allocated = _mm256_add_epi64(allocated, share);
+        }
+
+        alignas(32) std::uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), allocated);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + ProRataScalar(quantities + i, count - i, incoming, total, minimum, shares + i);
+    }
+#endif
+};
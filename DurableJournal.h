@@ -0,0 +1,417 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BookEvent.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <fcntl.h>
+    #include <linux/io_uring.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#if defined(__linux__)
+// Just enough of io_uring for the journal: one linked write + fdatasync pair per batch
+// Talks to the kernel directly so there's no liburing dependency, Setup fails (and the journal
+// falls back to pwrite) on kernels without io_uring or where it is disabled
+class IoUring
+{
+public:
+    IoUring() = default;
+    ~IoUring()
+    {
+        if (sqes_)
+            munmap(sqes_, sqesSize_);
+        if (cqRing_ && cqRing_ != sqRing_)
+            munmap(cqRing_, cqSize_);
+        if (sqRing_)
+            munmap(sqRing_, sqSize_);
+        if (ring_ >= 0)
+            close(ring_);
+    }
+
+    IoUring(const IoUring&) = delete;
+    void operator=(const IoUring&) = delete;
+
+    bool Setup(unsigned entries)
+    {
+        io_uring_params params{ };
+        ring_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ring_ < 0)
+            return false;
+
+        sqSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+            sqSize_ = cqSize_ = std::max(sqSize_, cqSize_);
+
+        sqRing_ = Map(sqSize_, IORING_OFF_SQ_RING);
+        cqRing_ = single ? sqRing_ : Map(cqSize_, IORING_OFF_CQ_RING);
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(Map(sqesSize_, IORING_OFF_SQES));
+        if (!sqRing_ || !cqRing_ || !sqes_)
+            return false;
+
+        auto* sq = static_cast<char*>(sqRing_);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        auto* cq = static_cast<char*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // Writes the buffer at offset and makes it durable, the fdatasync only starts once the write completed
+    // Returns the bytes written, or -errno of whichever step failed
+    long WriteAndSync(int fd, const void* data, std::size_t size, std::uint64_t offset)
+    {
+        auto tail = *sqTail_;
+
+        auto& write = Next(tail++);
+        write.opcode = IORING_OP_WRITE;
+        write.flags = IOSQE_IO_LINK;
+        write.fd = fd;
+        write.addr = reinterpret_cast<std::uint64_t>(data);
+        write.len = static_cast<std::uint32_t>(size);
+        write.off = offset;
+        write.user_data = 1;
+
+        auto& sync = Next(tail++);
+        sync.opcode = IORING_OP_FSYNC;
+        sync.fd = fd;
+        sync.fsync_flags = IORING_FSYNC_DATASYNC;
+        sync.user_data = 2;
+
+        // A signal before anything was submitted fails the call with EINTR, the two entries are still queued
+        __atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+        long submitted;
+        do
+            submitted = syscall(__NR_io_uring_enter, ring_, 2, 2, IORING_ENTER_GETEVENTS, nullptr, 0);
+        while (submitted < 0 && errno == EINTR);
+        if (submitted < 0)
+            return -errno;
+
+        long written = 0, synced = 0;
+        for (int reaped = 0; reaped < 2; )
+        {
+            auto head = *cqHead_;
+            const auto available = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+            if (head == available)
+            {
+                if (syscall(__NR_io_uring_enter, ring_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+                    return -errno;
+                continue;
+            }
+
+            for (; head != available; head++, reaped++)
+            {
+                const auto& completion = cqes_[head & cqMask_];
+                (completion.user_data == 1 ? written : synced) = completion.res;
+            }
+            __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        }
+
+        // A short write cancels the linked sync, the caller finishes the job the plain way
+        return written < 0 ? written : synced < 0 && written == static_cast<long>(size) ? synced : written;
+    }
+
+private:
+    void* Map(std::size_t size, std::uint64_t offset) const
+    {
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, static_cast<off_t>(offset));
+        return memory == MAP_FAILED ? nullptr : memory;
+    }
+
+    io_uring_sqe& Next(unsigned tail)
+    {
+        const auto index = tail & sqMask_;
+        sqArray_[index] = index;
+        sqes_[index] = io_uring_sqe{ };
+        return sqes_[index];
+    }
+
+    int ring_{ -1 };
+    void* sqRing_{ nullptr };
+    void* cqRing_{ nullptr };
+    io_uring_sqe* sqes_{ nullptr };
+    std::size_t sqSize_{ 0 };
+    std::size_t cqSize_{ 0 };
+    std::size_t sqesSize_{ 0 };
+
+    unsigned* sqTail_{ nullptr };
+    unsigned* sqArray_{ nullptr };
+    unsigned sqMask_{ 0 };
+    unsigned* cqHead_{ nullptr };
+    unsigned* cqTail_{ nullptr };
+    unsigned cqMask_{ 0 };
+    io_uring_cqe* cqes_{ nullptr };
+};
+#endif
+
+struct DurableJournalOptions
+{
+    std::size_t batchEvents_{ 256 };                    // Commit as soon as this many events are waiting
+    std::chrono::microseconds maxDelay_{ 200 };         // or once the oldest waiting event is this old
+    bool ioUring_{ true };                              // Submit through io_uring where available, pwrite + fdatasync otherwise
+
+    // Called on the journal's thread after every commit with the highest durable sequence
+    std::function<void(std::uint64_t)> onCommit_;
+};
+
+// Durable BookEvent journal with group commit: attach it with Orderbook::AddListener
+// The matching thread only appends the event to the open batch, a writer thread commits whole batches
+// with one write + one fdatasync, so the cost of a sync is shared by every order in the batch
+// An order may only be acknowledged once its events are durable: WaitDurable(LastSequence()) after the command,
+// or acknowledge from onCommit_ without blocking anyone
+class DurableJournal : public BookEventListener
+{
+public:
+    DurableJournal(const std::filesystem::path& path, const DurableJournalOptions& options = { })
+        : options_{ options }
+    {
+        Open(path);
+
+    #if defined(__linux__)
+        usingIoUring_ = options_.ioUring_ && ring_.Setup(8);
+    #endif
+
+        open_.reserve(options_.batchEvents_);
+        writer_ = std::thread{ [this] { WriterLoop(); } };
+    }
+
+    ~DurableJournal() override
+    {
+        {
+            std::scoped_lock lock{ mutex_ };
+            shutdown_ = true;
+        }
+        batchReady_.notify_one();
+        writer_.join();
+        Close();
+    }
+
+    DurableJournal(const DurableJournal&) = delete;
+    void operator=(const DurableJournal&) = delete;
+
+    void OnBookEvent(const BookEvent& event) override
+    {
+        bool wake;
+        {
+            std::scoped_lock lock{ mutex_ };
+            if (open_.empty())
+                openedAt_ = std::chrono::steady_clock::now();
+            open_.push_back(event);
+            lastSequence_ = event.sequence_;
+
+            // The first event starts the delay clock of an idle writer, a full batch cuts it short
+            wake = open_.size() == 1 || open_.size() == options_.batchEvents_;
+        }
+
+        if (wake)
+            batchReady_.notify_one();
+    }
+
+    // Sequence of the last event handed to the journal, durable or not
+    std::uint64_t LastSequence() const
+    {
+        std::scoped_lock lock{ mutex_ };
+        return lastSequence_;
+    }
+
+    std::uint64_t DurableSequence() const { return durable_.load(std::memory_order_acquire); }
+
+    // Blocks until every event up to sequence is on stable storage
+    void WaitDurable(std::uint64_t sequence)
+    {
+        std::unique_lock lock{ durableMutex_ };
+        committed_.wait(lock, [this, sequence] { return DurableSequence() >= sequence || failed_; });
+        if (failed_)
+            throw std::runtime_error("Durable journal write failed");
+    }
+
+    bool UsesIoUring() const { return usingIoUring_; }
+    std::uint64_t Commits() const { return commits_.load(std::memory_order_relaxed); }
+
+private:
+    void WriterLoop()
+    {
+        std::vector<BookEvent> batch;
+        batch.reserve(options_.batchEvents_);
+
+        while (true)
+        {
+            {
+                std::unique_lock lock{ mutex_ };
+
+                // Full batch, delay expired or shutting down, whichever comes first
+                while (!shutdown_ && open_.size() < options_.batchEvents_)
+                {
+                    if (open_.empty())
+                        batchReady_.wait(lock);
+                    else if (batchReady_.wait_until(lock, openedAt_ + options_.maxDelay_) == std::cv_status::timeout)
+                        break;
+                }
+
+                if (open_.empty() && shutdown_)
+                    return;
+
+                batch.swap(open_);
+            }
+
+            if (batch.empty())
+                continue;
+
+            const bool ok = Commit(batch);
+            {
+                std::scoped_lock lock{ durableMutex_ };
+                if (ok)
+                    durable_.store(batch.back().sequence_, std::memory_order_release);
+                else
+                    failed_ = true;
+            }
+            committed_.notify_all();
+            commits_.fetch_add(1, std::memory_order_relaxed);
+
+            if (ok && options_.onCommit_)
+                options_.onCommit_(batch.back().sequence_);
+
+            batch.clear();
+        }
+    }
+
+    bool Commit(const std::vector<BookEvent>& batch)
+    {
+        const auto* data = reinterpret_cast<const char*>(batch.data());
+        const auto size = batch.size() * sizeof(BookEvent);
+
+    #if defined(__linux__)
+        if (usingIoUring_)
+        {
+            const auto written = ring_.WriteAndSync(fd_, data, size, offset_);
+            if (written == static_cast<long>(size))
+            {
+                offset_ += size;
+                return true;
+            }
+            if (written < 0)
+                return false;
+
+            // Short write: the rest goes the plain way
+            offset_ += written;
+            data += written;
+            return WriteAndSync(data, size - written);
+        }
+    #endif
+
+        return WriteAndSync(data, size);
+    }
+
+#if defined(_WIN32) || defined(_WIN64)
+    void Open(const std::filesystem::path& path)
+    {
+        file_ = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("Cannot open durable journal " + path.string());
+    }
+
+    void Close() { CloseHandle(file_); }
+
+    bool WriteAndSync(const char* data, std::size_t size)
+    {
+        DWORD written{ };
+        if (!WriteFile(file_, data, static_cast<DWORD>(size), &written, nullptr) || written != size)
+            return false;
+        offset_ += size;
+        return FlushFileBuffers(file_) != 0;
+    }
+
+    HANDLE file_{ INVALID_HANDLE_VALUE };
+#else
+    void Open(const std::filesystem::path& path)
+    {
+        fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0)
+            throw std::runtime_error("Cannot open durable journal " + path.string());
+    }
+
+    void Close() { close(fd_); }
+
+    bool WriteAndSync(const char* data, std::size_t size)
+    {
+        while (size > 0)
+        {
+            const auto written = pwrite(fd_, data, size, static_cast<off_t>(offset_));
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+            data += written;
+            size -= written;
+            offset_ += written;
+        }
+        int synced;
+    #if defined(__APPLE__)
+        do
+            synced = fsync(fd_);
+    #else
+        do
+            synced = fdatasync(fd_);
+    #endif
+        while (synced < 0 && errno == EINTR);
+        return synced == 0;
+    }
+
+    int fd_{ -1 };
+#endif
+
+    const DurableJournalOptions options_;
+    std::uint64_t offset_{ 0 };
+    bool usingIoUring_{ false };
+#if defined(__linux__)
+    IoUring ring_;
+#endif
+
+    // The open batch, filled by the matching thread
+    mutable std::mutex mutex_;
+    std::condition_variable batchReady_;
+    std::vector<BookEvent> open_;
+    std::chrono::steady_clock::time_point openedAt_;
+    std::uint64_t lastSequence_{ 0 };
+    bool shutdown_{ false };
+
+    // What is known to be on disk
+    std::mutex durableMutex_;
+    std::condition_variable committed_;
+    std::atomic<std::uint64_t> durable_{ 0 };
+    std::atomic<std::uint64_t> commits_{ 0 };
+    bool failed_{ false };
+
+    std::thread writer_;
+};
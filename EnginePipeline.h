@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "BookEvent.h"
+#include "OrderBook.h"
+#include "SharedMemoryEntry.h"
+#include "ThreadAffinity.h"
+
+// Position of one stage (or of the producer) in the ring, alone on its cache line; -1 before the first entry
+struct alignas(64) PipelineSequence
+{
+    std::int64_t Get() const noexcept { return value_.load(std::memory_order_acquire); }
+    void Set(std::int64_t value) noexcept { value_.store(value, std::memory_order_release); }
+
+    std::atomic<std::int64_t> value_{ -1 };
+};
+
+// What a stage waits on: the slowest of the stages in front of it
+// Spins first, only yields once a wait gets long so an idle pipeline doesn't burn every core
+class SequenceBarrier
+{
+public:
+    static constexpr std::uint32_t SpinsBeforeYield = 4'096;
+
+    SequenceBarrier(std::vector<const PipelineSequence*> dependencies, const std::atomic<bool>& stop)
+        : dependencies_{ std::move(dependencies) }
+        , stop_{ stop }
+    { }
+
+    // Highest sequence all dependencies have passed once it's at least sequence
+    // Returns less than sequence only when the pipeline stops
+    std::int64_t WaitFor(std::int64_t sequence) const noexcept
+    {
+        for (std::uint32_t spins = 0; ; spins++)
+        {
+            const auto available = Minimum();
+            if (available >= sequence || stop_.load(std::memory_order_acquire))
+                return available;
+            if (spins > SpinsBeforeYield)
+                std::this_thread::yield();
+        }
+    }
+
+    std::int64_t Minimum() const noexcept
+    {
+        auto minimum = dependencies_.front()->Get();
+        for (const auto* dependency : dependencies_)
+            minimum = std::min(minimum, dependency->Get());
+        return minimum;
+    }
+
+private:
+    std::vector<const PipelineSequence*> dependencies_;
+    const std::atomic<bool>& stop_;
+};
+
+// One command on its way through the stages, the slots are allocated once and reused
+struct PipelineEntry
+{
+    static constexpr std::size_t InlineEvents = 8;
+
+    EntryRequest request_;
+    EntryResponse response_;
+    bool valid_;                // Cleared by decode, such a command skips matching
+
+    // Events the command caused, the first few inline, a sweep through many orders spills into overflow_
+    // which keeps its capacity from one use of the slot to the next
+    std::uint32_t eventCount_;
+    std::array<BookEvent, InlineEvents> events_;
+    std::vector<BookEvent> overflow_;
+
+    template<typename Handler>
+    void ForEachEvent(Handler&& handler) const
+    {
+        for (std::uint32_t i = 0; i < eventCount_; i++)
+            handler(i < InlineEvents ? events_[i] : overflow_[i - InlineEvents]);
+    }
+};
+
+struct PipelineOptions
+{
+    std::size_t ringSize_{ 4'096 };     // Rounded up to a power of two
+    int decodeCore_{ -1 };
+    int matchCore_{ -1 };
+    int publishCore_{ -1 };
+    int journalCore_{ -1 };
+
+    std::vector<BookEventListener*> publishers_;    // Market data, called on the publish stage
+    std::vector<BookEventListener*> journals_;      // Persistence, called on the journal stage
+
+    // On the publish stage, after the command's events went to the publishers
+    std::function<void(const EntryResponse&)> onResponse_;
+};
+
+// Staged engine over one preallocated sequence ring, Disruptor style:
+//
+//     Submit -> decode -> match -> publish
+//                              \-> journal
+//
+// Every stage is a thread (pinned when given a core) that follows the stages in front of it through a
+// SequenceBarrier and processes whatever became available in one go. Decode validates, match only runs the
+// command against the book, publish and journal fan the resulting events out in parallel. The producer waits
+// for the slower of publish & journal before reusing a slot, so throughput is set by the slowest stage
+// The book should be built with transactionLog_ off, it must not be used by anyone else while the pipeline runs
+class EnginePipeline : private BookEventListener
+{
+public:
+    EnginePipeline(Orderbook& orderbook, PipelineOptions options)
+        : orderbook_{ orderbook }
+        , options_{ std::move(options) }
+        , ring_(std::bit_ceil(std::max<std::size_t>(options_.ringSize_, 2)))
+        , mask_{ static_cast<std::int64_t>(ring_.size() - 1) }
+        , decodeBarrier_{ { &cursor_ }, stop_ }
+        , matchBarrier_{ { &decoded_ }, stop_ }
+        , outputBarrier_{ { &matched_ }, stop_ }
+    {
+        for (auto& entry : ring_)
+            entry.overflow_.reserve(64);
+
+        orderbook_.AddListener(this);
+
+        stages_.emplace_back([this] { RunStage(options_.decodeCore_, decodeBarrier_, decoded_, [this](PipelineEntry& entry) { Decode(entry); }); });
+        stages_.emplace_back([this] { RunStage(options_.matchCore_, matchBarrier_, matched_, [this](PipelineEntry& entry) { Match(entry); }); });
+        stages_.emplace_back([this] { RunStage(options_.publishCore_, outputBarrier_, published_, [this](PipelineEntry& entry) { Publish(entry); }); });
+        stages_.emplace_back([this] { RunStage(options_.journalCore_, outputBarrier_, journaled_, [this](PipelineEntry& entry) { Journal(entry); }); });
+    }
+
+    // Finishes everything submitted before stopping the stages
+    ~EnginePipeline() override
+    {
+        Drain();
+        stop_.store(true, std::memory_order_release);
+        for (auto& stage : stages_)
+            stage.join();
+        orderbook_.RemoveListener(this);
+    }
+
+    EnginePipeline(const EnginePipeline&) = delete;
+    void operator=(const EnginePipeline&) = delete;
+
+    // Single producer: only one thread may submit. Waits while the ring is full
+    // Returns the command's sequence
+    std::int64_t Submit(const EntryRequest& request) noexcept
+    {
+        const auto sequence = ++claimed_;
+
+        // The slot is free once both output stages are done with its previous use
+        const auto wrap = sequence - static_cast<std::int64_t>(ring_.size());
+        for (std::uint32_t spins = 0; std::min(published_.Get(), journaled_.Get()) < wrap; spins++)
+            if (spins > SequenceBarrier::SpinsBeforeYield)
+                std::this_thread::yield();
+
+        auto& entry = ring_[sequence & mask_];
+        entry.request_ = request;
+        cursor_.Set(sequence);
+        return sequence;
+    }
+
+    // Waits until every submitted command went through every stage
+    void Drain() const noexcept
+    {
+        const auto last = cursor_.Get();
+        for (std::uint32_t spins = 0; std::min(published_.Get(), journaled_.Get()) < last; spins++)
+            if (spins > SequenceBarrier::SpinsBeforeYield)
+                std::this_thread::yield();
+    }
+
+    std::size_t RingSize() const { return ring_.size(); }
+
+private:
+    template<typename Handler>
+    void RunStage(int core, const SequenceBarrier& barrier, PipelineSequence& sequence, Handler&& handler)
+    {
+        ThreadAffinity::PinCurrentThread(core);
+
+        std::int64_t next = 0;
+        while (true)
+        {
+            // A whole batch per wait, the sequence is only published once for it
+            const auto available = barrier.WaitFor(next);
+            if (available < next)
+                return;
+
+            for (; next <= available; next++)
+                handler(ring_[next & mask_]);
+            sequence.Set(available);
+        }
+    }
+
+    // Everything the book would reject without looking at its orders, so matching never sees it
+    // Modify and cancel depend on what rests and are left to the book
+    void Decode(PipelineEntry& entry) noexcept
+    {
+        const auto& request = entry.request_;
+        entry.eventCount_ = 0;
+        entry.overflow_.clear();
+        entry.valid_ = true;
+        entry.response_ = EntryResponse{ request.clientSequence_, request.orderId_, 0, 0, CommandStatus::Accepted };
+
+        if (request.type_ == EntryRequestType::Cancel || request.type_ == EntryRequestType::Modify)
+            return;
+
+        if (request.quantity_ == 0)
+            Reject(entry, CommandStatus::InvalidQuantity);
+        else if (request.type_ != EntryRequestType::Market && request.price_ <= 0)
+            Reject(entry, CommandStatus::InvalidPrice);
+    }
+
+    static void Reject(PipelineEntry& entry, CommandStatus status) noexcept
+    {
+        entry.valid_ = false;
+        entry.response_.status_ = status;
+    }
+
+    void Match(PipelineEntry& entry) noexcept
+    {
+        if (!entry.valid_)
+            return;
+
+        current_ = &entry;
+        entry.response_ = SharedMemoryEntryServer::Execute(orderbook_, entry.request_);
+        current_ = nullptr;
+    }
+
+    // Called by the book on the match stage while it runs the current command
+    void OnBookEvent(const BookEvent& event) override
+    {
+        if (!current_)
+            return;
+
+        auto& entry = *current_;
+        if (entry.eventCount_ < PipelineEntry::InlineEvents)
+            entry.events_[entry.eventCount_] = event;
+        else
+            entry.overflow_.push_back(event);
+        entry.eventCount_++;
+    }
+
+    void Publish(PipelineEntry& entry)
+    {
+        entry.ForEachEvent([this](const BookEvent& event)
+            {
+                for (auto* publisher : options_.publishers_)
+                    publisher->OnBookEvent(event);
+            });
+
+        if (options_.onResponse_)
+            options_.onResponse_(entry.response_);
+    }
+
+    void Journal(PipelineEntry& entry)
+    {
+        entry.ForEachEvent([this](const BookEvent& event)
+            {
+                for (auto* journal : options_.journals_)
+                    journal->OnBookEvent(event);
+            });
+    }
+
+    Orderbook& orderbook_;
+    const PipelineOptions options_;
+    std::vector<PipelineEntry> ring_;
+    const std::int64_t mask_;
+
+    std::int64_t claimed_{ -1 };    // Producer only
+    PipelineSequence cursor_;       // Last submitted
+    PipelineSequence decoded_;
+    PipelineSequence matched_;
+    PipelineSequence published_;
+    PipelineSequence journaled_;
+
+    std::atomic<bool> stop_{ false };
+    SequenceBarrier decodeBarrier_;
+    SequenceBarrier matchBarrier_;
+    SequenceBarrier outputBarrier_;
+
+    PipelineEntry* current_{ nullptr };     // Match stage only
+    std::vector<std::thread> stages_;
+};
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BookChecksum.h"
+#include "BookEvent.h"
+#include "OrderbookLevelInfos.h"
+
+// One resting order as the journal remembers it, priority_ is the sequence of its Add (its place in the queue)
+struct JournalOrder
+{
+    OrderId orderId_;
+    std::uint64_t priority_;
+    Price price_;
+    Quantity remaining_;
+    Side side_;
+    OrderType orderType_;
+};
+
+// Entry of the offset table: where the state of the book after sequence_ is stored
+// and where the events following it start in the journal
+struct JournalCheckpoint
+{
+    std::uint64_t sequence_;
+    std::int64_t timestamp_;        // Of the last event included, nanoseconds since the epoch
+    std::uint64_t journalOffset_;   // Byte offset of the first event after the checkpoint
+    std::uint64_t snapshotOffset_;  // Byte offset of its orders in the snapshot file
+    std::uint64_t orderCount_;
+    std::uint64_t checksum_;
+};
+
+// The resting book at one point in the past
+struct HistoricalBook
+{
+    std::uint64_t sequence_{ };
+    std::int64_t timestamp_{ };
+    std::uint64_t checksum_{ };         // BookChecksum the engine stamped on that event
+    std::vector<JournalOrder> orders_;  // Bids best first then asks best first, time priority within a level
+
+    OrderbookLevelInfos Levels() const
+    {
+        LevelInfos bids, asks;
+        for (const auto& order : orders_)
+        {
+            auto& levels = order.side_ == Side::Buy ? bids : asks;
+            if (levels.empty() || levels.back().price_ != order.price_)
+                levels.push_back(LevelInfo{ order.price_, 0 });
+            levels.back().quantity_ += order.remaining_;
+        }
+        return OrderbookLevelInfos{ bids, asks };
+    }
+
+    // The reconstructed orders hash to what the engine had at that sequence
+    bool Consistent() const
+    {
+        std::uint64_t checksum{ 0 };
+        for (const auto& order : orders_)
+            checksum += BookChecksum::Of(order.orderId_, order.side_, order.price_, order.remaining_);
+        return checksum == checksum_;
+    }
+};
+
+// Resting orders rebuilt from events, shared by the writer (for its checkpoints) and the reader
+class JournalState
+{
+public:
+    void Apply(const BookEvent& event)
+    {
+        sequence_ = event.sequence_;
+        timestamp_ = event.timestamp_;
+        checksum_ = event.checksum_;
+
+        switch (event.type_)
+        {
+            case BookEventType::Add:
+                orders_[event.orderId_] = JournalOrder{ event.orderId_, event.sequence_, event.price_, event.remaining_, event.side_, event.orderType_ };
+                break;
+            case BookEventType::Cancel:
+                orders_.erase(event.orderId_);
+                break;
+            case BookEventType::Fill:
+                if (event.remaining_ == 0)
+                    orders_.erase(event.orderId_);
+                else if (auto it = orders_.find(event.orderId_); it != orders_.end())
+                    it->second.remaining_ = event.remaining_;
+                break;
+        }
+    }
+
+    void Load(const JournalCheckpoint& checkpoint, std::vector<JournalOrder> orders)
+    {
+        sequence_ = checkpoint.sequence_;
+        timestamp_ = checkpoint.timestamp_;
+        checksum_ = checkpoint.checksum_;
+        orders_.clear();
+        for (const auto& order : orders)
+            orders_.emplace(order.orderId_, order);
+    }
+
+    std::vector<JournalOrder> Orders() const
+    {
+        std::vector<JournalOrder> orders;
+        orders.reserve(orders_.size());
+        for (const auto& [_, order] : orders_)
+            orders.push_back(order);
+        return orders;
+    }
+
+    HistoricalBook Book() const
+    {
+        HistoricalBook book{ sequence_, timestamp_, checksum_, Orders() };
+        std::sort(book.orders_.begin(), book.orders_.end(), [](const JournalOrder& left, const JournalOrder& right)
+            {
+                if (left.side_ != right.side_)
+                    return left.side_ == Side::Buy;
+                if (left.price_ != right.price_)
+                    return left.side_ == Side::Buy ? left.price_ > right.price_ : left.price_ < right.price_;
+                return left.priority_ < right.priority_;
+            });
+        return book;
+    }
+
+    std::uint64_t Sequence() const { return sequence_; }
+    std::int64_t Timestamp() const { return timestamp_; }
+    std::uint64_t Checksum() const { return checksum_; }
+
+private:
+    std::unordered_map<OrderId, JournalOrder> orders_;
+    std::uint64_t sequence_{ };
+    std::int64_t timestamp_{ };
+    std::uint64_t checksum_{ };
+};
+
+// Event journal with a checkpoint index, attach it with Orderbook::AddListener before the first order
+// Three files: <path> holds every BookEvent as a raw record, <path>.snap a snapshot of the resting orders
+// every checkpointInterval events and <path>.idx the offset table pointing into both
+// so a reader can jump to the nearest checkpoint instead of replaying from the open
+class EventJournal : public BookEventListener
+{
+public:
+    explicit EventJournal(const std::filesystem::path& path, std::uint64_t checkpointInterval = 50'000)
+        : journal_{ path, std::ios::binary | std::ios::trunc }
+        , snapshots_{ SnapshotPath(path), std::ios::binary | std::ios::trunc }
+        , index_{ IndexPath(path), std::ios::binary | std::ios::trunc }
+        , checkpointInterval_{ checkpointInterval == 0 ? 1 : checkpointInterval }
+    {
+        if (!journal_ || !snapshots_ || !index_)
+            throw std::runtime_error("Cannot open event journal " + path.string());
+
+        // The empty book before the first event, so every sequence has a checkpoint at or before it
+        WriteCheckpoint();
+    }
+
+    ~EventJournal() override
+    {
+        journal_.flush();
+        snapshots_.flush();
+        index_.flush();
+    }
+
+    void OnBookEvent(const BookEvent& event) override
+    {
+        journal_.write(reinterpret_cast<const char*>(&event), sizeof(BookEvent));
+        journalOffset_ += sizeof(BookEvent);
+        state_.Apply(event);
+
+        if (++sinceCheckpoint_ == checkpointInterval_)
+            WriteCheckpoint();
+    }
+
+    static std::filesystem::path SnapshotPath(std::filesystem::path path) { return path += ".snap"; }
+    static std::filesystem::path IndexPath(std::filesystem::path path) { return path += ".idx"; }
+
+private:
+    // Costs a walk over the resting orders once every checkpointInterval events
+    void WriteCheckpoint()
+    {
+        const auto orders = state_.Orders();
+        const JournalCheckpoint checkpoint{ state_.Sequence(), state_.Timestamp(), journalOffset_, snapshotOffset_, orders.size(), state_.Checksum() };
+
+        snapshots_.write(reinterpret_cast<const char*>(orders.data()), static_cast<std::streamsize>(orders.size() * sizeof(JournalOrder)));
+        snapshotOffset_ += orders.size() * sizeof(JournalOrder);
+        index_.write(reinterpret_cast<const char*>(&checkpoint), sizeof(JournalCheckpoint));
+
+        // A checkpoint is only useful once the events before it are on disk too
+        journal_.flush();
+        snapshots_.flush();
+        index_.flush();
+        sinceCheckpoint_ = 0;
+    }
+
+    std::ofstream journal_;
+    std::ofstream snapshots_;
+    std::ofstream index_;
+    const std::uint64_t checkpointInterval_;
+
+    JournalState state_;
+    std::uint64_t sinceCheckpoint_{ 0 };
+    std::uint64_t journalOffset_{ 0 };
+    std::uint64_t snapshotOffset_{ 0 };
+};
+
+// Answers "what did the book look like at sequence N / at time T" from an EventJournal's files:
+// binary search of the offset table, load of the nearest earlier snapshot, replay of the events after it
+class JournalReader
+{
+public:
+    explicit JournalReader(const std::filesystem::path& path)
+        : path_{ path }
+    {
+        std::ifstream index{ EventJournal::IndexPath(path), std::ios::binary };
+        if (!index)
+            throw std::runtime_error("Cannot open journal index " + EventJournal::IndexPath(path).string());
+
+        JournalCheckpoint checkpoint;
+        while (index.read(reinterpret_cast<char*>(&checkpoint), sizeof(JournalCheckpoint)))
+            checkpoints_.push_back(checkpoint);
+
+        if (checkpoints_.empty())
+            throw std::runtime_error("Empty journal index " + EventJournal::IndexPath(path).string());
+    }
+
+    const std::vector<JournalCheckpoint>& Checkpoints() const { return checkpoints_; }
+
+    // Timestamp of the first event, 0 for an empty journal
+    std::int64_t FirstTimestamp() const
+    {
+        std::ifstream journal{ path_, std::ios::binary };
+        BookEvent event;
+        return journal.read(reinterpret_cast<char*>(&event), sizeof(BookEvent)) ? event.timestamp_ : 0;
+    }
+
+    // The book right after the event with this sequence (or the last event, if the journal ends before it)
+    HistoricalBook BookAt(std::uint64_t sequence) const
+    {
+        const auto it = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), sequence,
+            [](std::uint64_t value, const JournalCheckpoint& checkpoint) { return value < checkpoint.sequence_; });
+        return Reconstruct(*std::prev(it), [sequence](const BookEvent& event) { return event.sequence_ <= sequence; });
+    }
+
+    // The book as of a point in time: every event stamped at or before it applied
+    HistoricalBook BookAtTime(std::int64_t timestamp) const
+    {
+        // The first checkpoint is the empty book and always qualifies
+        const auto it = std::upper_bound(checkpoints_.begin() + 1, checkpoints_.end(), timestamp,
+            [](std::int64_t value, const JournalCheckpoint& checkpoint) { return value < checkpoint.timestamp_; });
+        return Reconstruct(*std::prev(it), [timestamp](const BookEvent& event) { return event.timestamp_ <= timestamp; });
+    }
+
+private:
+    template<typename Include>
+    HistoricalBook Reconstruct(const JournalCheckpoint& checkpoint, Include&& include) const
+    {
+        std::vector<JournalOrder> orders(checkpoint.orderCount_);
+        {
+            std::ifstream snapshots{ EventJournal::SnapshotPath(path_), std::ios::binary };
+            snapshots.seekg(static_cast<std::streamoff>(checkpoint.snapshotOffset_));
+            snapshots.read(reinterpret_cast<char*>(orders.data()), static_cast<std::streamsize>(orders.size() * sizeof(JournalOrder)));
+            if (!snapshots)
+                throw std::runtime_error("Truncated journal snapshot " + EventJournal::SnapshotPath(path_).string());
+        }
+
+        JournalState state;
+        state.Load(checkpoint, std::move(orders));
+
+        // Only the delta since the checkpoint, read in blocks
+        std::ifstream journal{ path_, std::ios::binary };
+        journal.seekg(static_cast<std::streamoff>(checkpoint.journalOffset_));
+
+        std::vector<BookEvent> events(4'096);
+        while (journal)
+        {
+            journal.read(reinterpret_cast<char*>(events.data()), static_cast<std::streamsize>(events.size() * sizeof(BookEvent)));
+            const auto count = static_cast<std::size_t>(journal.gcount()) / sizeof(BookEvent);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                if (!include(events[i]))
+                    return state.Book();
+                state.Apply(events[i]);
+            }
+        }
+
+        return state.Book();
+    }
+
+    std::filesystem::path path_;
+    std::vector<JournalCheckpoint> checkpoints_;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Side.h"
+#include "Usings.h"
+
+// Aggregated alternative to Trades: one report per aggressor order per price level it traded at
+// instead of one Trade per resting order it touched. The per fill detail stays available as BookEvents
+struct ExecutionReport
+{
+    OrderId aggressorId_;
+    Side side_;                   // Side of the aggressor
+    Price price_;                 // Price level of the resting orders
+    Quantity quantity_;           // Total quantity traded at this level
+    std::uint32_t contraCount_;   // Number of resting orders traded against at this level
+    double vwap_;                 // Average price of the aggressor's fills so far, this level included
+};
+
+using ExecutionReports = std::vector<ExecutionReport>;
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <vector>
+
+#include "Scenario.h"
+
+// Shape of the synthetic order flow, the defaults look roughly like a liquid single name:
+// mostly passive limit orders close to the touch, about as many cancels as adds and bursts of activity
+struct FlowOptions
+{
+    std::uint64_t seed_{ 42 };
+    OrderId firstOrderId_{ 1 };
+
+    // Arrival process: Poisson at messagesPerSecond_, switching into bursts that run burstMultiplier_ times faster
+    double messagesPerSecond_{ 100'000.0 };
+    double burstProbability_{ 0.001 };  // Chance per message that a burst starts
+    double meanBurstLength_{ 200.0 };   // In messages
+    double burstMultiplier_{ 20.0 };
+
+    // Message mix: cancelToAdd_ cancels & modifies per add, modifyShare_ of those are modifies
+    double cancelToAdd_{ 0.9 };
+    double modifyShare_{ 0.1 };
+
+    // Price placement around the mid
+    Price mid_{ 10'000 };
+    double meanDepth_{ 3.0 };           // Passive orders rest a geometric number of ticks behind the touch
+    Price crossTicks_{ 2 };             // Marketable limit orders (FAK / FOK) go this many ticks through the mid
+    double midMoveProbability_{ 0.01 }; // Per message the mid steps one tick up or down
+
+    // Sizes are log normal around the median and rounded to whole lots
+    double medianQuantity_{ 100.0 };
+    double quantitySigma_{ 0.8 };
+    Quantity lotSize_{ 1 };
+
+    // Relative weights of the order types among the adds
+    double goodTillCancel_{ 0.70 };
+    double goodForDay_{ 0.10 };
+    double fillAndKill_{ 0.12 };
+    double fillOrKill_{ 0.03 };
+    double market_{ 0.05 };
+};
+
+struct FlowMessage
+{
+    std::uint64_t time_;    // Nanoseconds since the start of the flow
+    Information action_;
+};
+
+// Seeded synthetic order flow: the same options and seed give the same messages (for a given standard library)
+// It only remembers the orders it placed, not what the engine did with them, so some cancels / modifies
+// target orders that already traded away, like they do on a real venue
+class FlowGenerator
+{
+public:
+    explicit FlowGenerator(const FlowOptions& options)
+        : options_{ options }
+        , gen_{ options.seed_ }
+        , mid_{ options.mid_ }
+        , nextId_{ options.firstOrderId_ }
+        , depth_{ 1.0 / (1.0 + std::max(options.meanDepth_, 0.0)) }
+        , size_{ std::log(std::max(options.medianQuantity_, 1.0)), options.quantitySigma_ }
+        , orderType_{ options.goodTillCancel_, options.fillAndKill_, options.fillOrKill_, options.goodForDay_, options.market_ }
+        , restingType_{ options.goodTillCancel_, options.goodForDay_ }
+    { }
+
+    // A passive order on the given side, used to build a book before the flow starts
+    Information NextResting(Side side)
+    {
+        const auto orderType = restingType_(gen_) == 0 ? OrderType::GoodTillCancel : OrderType::GoodForDay;
+        return Add(orderType, side, PassivePrice(side));
+    }
+
+    FlowMessage Next()
+    {
+        Advance();
+
+        const bool add = live_.empty() || unit_(gen_) * (1.0 + options_.cancelToAdd_) < 1.0;
+        if (add)
+            return FlowMessage{ time_, NextAdd() };
+
+        // A random resting order, recent and old ones alike
+        const auto index = std::uniform_int_distribution<std::size_t>{ 0, live_.size() - 1 }(gen_);
+        const auto [orderId, side] = live_[index];
+
+        if (unit_(gen_) < options_.modifyShare_)
+            return FlowMessage{ time_, Information{ ActionType::Modify, OrderType::GoodTillCancel, side, PassivePrice(side), NextQuantity(), orderId } };
+
+        live_[index] = live_.back();
+        live_.pop_back();
+        return FlowMessage{ time_, Information{ ActionType::Cancel, OrderType::GoodTillCancel, side, 0, 0, orderId } };
+    }
+
+    // Streams count messages into sink(const FlowMessage&), so tens of millions never have to sit in memory
+    template<typename Sink>
+    void Generate(std::size_t count, Sink&& sink)
+    {
+        for (std::size_t i = 0; i < count; i++)
+            sink(Next());
+    }
+
+    // Writes count messages as a recorded session (no R line) that --replay and InputHandler understand
+    void WriteScenario(std::ostream& out, std::size_t count)
+    {
+        Generate(count, [&out](const FlowMessage& message) { ScenarioWriter::Write(out, message.action_); });
+    }
+
+    std::uint64_t Time() const { return time_; }
+    Price Mid() const { return mid_; }
+
+private:
+    struct Resting
+    {
+        OrderId orderId_;
+        Side side_;
+    };
+
+    // Moves the clock to the next arrival and lets the mid & the burst state evolve
+    void Advance()
+    {
+        if (burstRemaining_ > 0)
+            burstRemaining_--;
+        else if (unit_(gen_) < options_.burstProbability_)
+            burstRemaining_ = static_cast<std::size_t>(std::exponential_distribution<>{ 1.0 / std::max(options_.meanBurstLength_, 1.0) }(gen_)) + 1;
+
+        const auto rate = options_.messagesPerSecond_ * (burstRemaining_ > 0 ? options_.burstMultiplier_ : 1.0);
+        time_ += static_cast<std::uint64_t>(std::exponential_distribution<>{ rate }(gen_) * 1e9);
+
+        if (unit_(gen_) < options_.midMoveProbability_)
+            mid_ = std::max<Price>(mid_ + (unit_(gen_) < 0.5 ? -1 : 1), 2);
+    }
+
+    Information NextAdd()
+    {
+        // Order of the weights given to orderType_
+        constexpr OrderType OrderTypes[] = { OrderType::GoodTillCancel, OrderType::FillAndKill, OrderType::FillOrKill, OrderType::GoodForDay, OrderType::Market };
+        const auto orderType = OrderTypes[orderType_(gen_)];
+        const auto side = unit_(gen_) < 0.5 ? Side::Buy : Side::Sell;
+
+        switch (orderType)
+        {
+            case OrderType::Market:
+                return Add(orderType, side, 0);
+            case OrderType::FillAndKill:
+            case OrderType::FillOrKill:
+                return Add(orderType, side, side == Side::Buy ? mid_ + options_.crossTicks_ : std::max<Price>(mid_ - options_.crossTicks_, 1));
+            default:
+                return Add(orderType, side, PassivePrice(side));
+        }
+    }
+
+    Information Add(OrderType orderType, Side side, Price price)
+    {
+        const auto orderId = nextId_++;
+        if (orderType == OrderType::GoodTillCancel || orderType == OrderType::GoodForDay)
+            live_.push_back(Resting{ orderId, side });
+
+        return Information{ ActionType::Add, orderType, side, price, NextQuantity(), orderId };
+    }
+
+    Price PassivePrice(Side side)
+    {
+        const auto ticks = 1 + static_cast<Price>(depth_(gen_));
+        return side == Side::Buy ? std::max<Price>(mid_ - ticks, 1) : mid_ + ticks;
+    }
+
+    Quantity NextQuantity()
+    {
+        const auto lot = std::max<Quantity>(options_.lotSize_, 1);
+        const auto lots = std::max<double>(std::round(size_(gen_) / lot), 1.0);
+        return static_cast<Quantity>(lots) * lot;
+    }
+
+    FlowOptions options_;
+    std::mt19937_64 gen_;
+    Price mid_;
+    OrderId nextId_;
+    std::uint64_t time_{ 0 };
+    std::size_t burstRemaining_{ 0 };
+    std::vector<Resting> live_;
+
+    std::uniform_real_distribution<> unit_{ 0.0, 1.0 };
+    std::geometric_distribution<Price> depth_;
+    std::lognormal_distribution<> size_;
+    std::discrete_distribution<> orderType_;
+    std::discrete_distribution<> restingType_;
+};
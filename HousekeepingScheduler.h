@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// One scheduler shared by many Orderbooks for their periodic maintenance (GoodForDay expiry, pool trimming, stats rollover...)
+// Instead of every book sleeping on its own thread, books register tasks here:
+// a single timer thread wakes up when the earliest task is due, groups every due task into batches
+// and hands the batches to a small worker pool, so 2,000 books closing at 16:00 cost a few batches on a few threads
+class HousekeepingScheduler
+{
+public:
+    using Clock = std::chrono::system_clock;
+    using Task = std::function<void()>;
+    using TaskId = std::uint64_t;
+
+    explicit HousekeepingScheduler(std::size_t workerCount = 2, std::size_t batchSize = 64)
+        : batchSize_{ std::max<std::size_t>(batchSize, 1) }
+        , workers_{ workerCount }
+        , timerThread_{ [this] { TimerLoop(); } }
+    { }
+
+    ~HousekeepingScheduler()
+    {
+        {
+            std::scoped_lock lock{ mutex_ };
+            shutdown_ = true;
+        }
+        wakeUp_.notify_one();
+        timerThread_.join();
+        workers_.Wait();
+    }
+
+    HousekeepingScheduler(const HousekeepingScheduler&) = delete;
+    void operator=(const HousekeepingScheduler&) = delete;
+    HousekeepingScheduler(HousekeepingScheduler&&) = delete;
+    void operator=(HousekeepingScheduler&&) = delete;
+
+    // Runs every day at the given local time of day (eg: the market close)
+    TaskId ScheduleDaily(std::chrono::hours at, Task task)
+    {
+        return Schedule(Entry{ .next_ = NextDailyTime(at), .interval_ = { }, .at_ = at, .daily_ = true, .state_ = { } }, std::move(task));
+    }
+
+    // Runs every interval, starting one interval from now
+    TaskId SchedulePeriodic(std::chrono::milliseconds interval, Task task)
+    {
+        return Schedule(Entry{ .next_ = Clock::now() + interval, .interval_ = interval, .at_ = { }, .daily_ = false, .state_ = { } }, std::move(task));
+    }
+
+    // After Cancel returns the task is not running and will never run again,
+    // so a book can unregister in its destructor and then safely go away
+    void Cancel(TaskId id)
+    {
+        std::shared_ptr<TaskState> state;
+        {
+            std::scoped_lock lock{ mutex_ };
+            auto it = entries_.find(id);
+            if (it == entries_.end())
+                return;
+
+            state = it->second.state_;
+            entries_.erase(it);
+        }
+
+        std::scoped_lock running{ state->running_ };
+        state->cancelled_ = true;
+    }
+
+    // Dispatch every registered task right away, regardless of its schedule, and wait for them
+    // Used for a forced end of day and by the tests
+    void RunNow()
+    {
+        std::vector<std::shared_ptr<TaskState>> due;
+        {
+            std::scoped_lock lock{ mutex_ };
+            for (const auto& [_, entry] : entries_)
+                due.push_back(entry.state_);
+        }
+
+        Dispatch(std::move(due));
+        workers_.Wait();
+    }
+
+    std::size_t Size() const
+    {
+        std::scoped_lock lock{ mutex_ };
+        return entries_.size();
+    }
+
+    // Next occurrence of the given local time of day, used by the daily tasks
+    static Clock::time_point NextDailyTime(std::chrono::hours at)
+    {
+        const auto now = Clock::now();
+        const auto now_c = Clock::to_time_t(now);
+        std::tm now_parts;
+
+        localtime_s(&now_parts, &now_c);
+
+        // Already past today's slot, so the next one is tomorrow
+        if (now_parts.tm_hour >= at.count())
+            now_parts.tm_mday += 1;
+
+        now_parts.tm_hour = static_cast<int>(at.count());
+        now_parts.tm_min = 0;
+        now_parts.tm_sec = 0;
+
+        return Clock::from_time_t(mktime(&now_parts)) + std::chrono::milliseconds(100); // Land just after the slot
+    }
+
+private:
+    // Shared between the registry and in flight batches, the mutex is held while the task runs
+    struct TaskState
+    {
+        Task task_;
+        std::mutex running_;
+        bool cancelled_{ false };
+    };
+
+    struct Entry
+    {
+        Clock::time_point next_;
+        std::chrono::milliseconds interval_;
+        std::chrono::hours at_;
+        bool daily_;
+        std::shared_ptr<TaskState> state_;
+    };
+
+    TaskId Schedule(Entry entry, Task task)
+    {
+        entry.state_ = std::make_shared<TaskState>();
+        entry.state_->task_ = std::move(task);
+
+        bool earliest;
+        TaskId id;
+        {
+            std::scoped_lock lock{ mutex_ };
+            id = nextId_++;
+            earliest = entry.next_ < nextWakeUp_;
+            entries_.emplace(id, std::move(entry));
+        }
+
+        // Registering thousands of books only wakes the timer when the schedule actually moves earlier
+        if (earliest)
+            wakeUp_.notify_one();
+
+        return id;
+    }
+
+    void Dispatch(std::vector<std::shared_ptr<TaskState>> due)
+    {
+        for (std::size_t begin = 0; begin < due.size(); begin += batchSize_)
+        {
+            const auto end = std::min(begin + batchSize_, due.size());
+            std::vector<std::shared_ptr<TaskState>> batch(due.begin() + begin, due.begin() + end);
+
+            workers_.Submit([batch = std::move(batch)]
+                {
+                    for (const auto& state : batch)
+                    {
+                        std::scoped_lock running{ state->running_ };
+                        if (!state->cancelled_)
+                            state->task_();
+                    }
+                });
+        }
+    }
+
+    void TimerLoop()
+    {
+        std::unique_lock lock{ mutex_ };
+
+        while (!shutdown_)
+        {
+            const auto now = Clock::now();
+            std::vector<std::shared_ptr<TaskState>> due;
+
+            // A linear pass is fine, it only happens when something is due or the registry changed
+            nextWakeUp_ = Clock::time_point::max();
+            for (auto& [_, entry] : entries_)
+            {
+                if (entry.next_ <= now)
+                {
+                    due.push_back(entry.state_);
+                    entry.next_ = entry.daily_ ? NextDailyTime(entry.at_) : now + entry.interval_;
+                }
+                nextWakeUp_ = std::min(nextWakeUp_, entry.next_);
+            }
+
+            if (!due.empty())
+            {
+                lock.unlock();
+                Dispatch(std::move(due));
+                lock.lock();
+                continue;
+            }
+
+            if (nextWakeUp_ == Clock::time_point::max())
+                wakeUp_.wait(lock);
+            else
+                wakeUp_.wait_until(lock, nextWakeUp_);
+        }
+    }
+
+    const std::size_t batchSize_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wakeUp_;
+    std::unordered_map<TaskId, Entry> entries_;
+    Clock::time_point nextWakeUp_{ Clock::time_point::max() };
+    TaskId nextId_{ 0 };
+    bool shutdown_{ false };
+
+    ThreadPool workers_;
+    std::thread timerThread_;
+};
@@ -1,4 +1,9 @@
 #pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Side.h"
 #include "Usings.h"
 
 // Represent information about a prive level in the orderbook
@@ -11,3 +16,15 @@ struct LevelInfo
 };
 
 using LevelInfos = std::vector<LevelInfo>;
+
+// Latest state of one price level, quantity 0 means the level is gone
+struct LevelUpdate
+{
+    Side side_;
+    Price price_;
+    Quantity quantity_;
+    std::uint32_t orderCount_;
+    std::uint64_t sequence_;    // Last BookEvent that changed the level
+};
+
+using LevelUpdates = std::vector<LevelUpdate>;
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "DepthKernels.h"
+#include "Order.h"
+#include "Usings.h"
+
+// FIFO queue of the orders resting at one price level
+// The slots live in a contiguous ring buffer (orders and their remaining quantities in two parallel arrays)
+// so walking a level is a sequential scan instead of chasing one list node per order
+// Cancelling leaves a tombstone behind in O(1), matching skips them and the buffer is compacted once they pile up
+// A Fenwick tree over the slots keeps running sums of orders & quantity, so what's ahead of an order is O(log n)
+class LevelQueue
+{
+public:
+    // Absolute slot number, it keeps identifying the same order when the buffer grows
+    // Only a compaction moves orders, and it reports every move through its callback
+    using Position = std::uint64_t;
+
+    // Allocator aware so a book can keep its levels in its own arena
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    // What stands in front of one order in the queue
+    struct Ahead
+    {
+        std::uint64_t orders_{ };
+        std::uint64_t quantity_{ };
+    };
+
+    LevelQueue() = default;
+    explicit LevelQueue(const allocator_type& allocator)
+        : orders_{ allocator }
+        , quantities_{ allocator }
+        , sums_{ allocator }
+    { }
+
+    LevelQueue(LevelQueue&& other, const allocator_type& allocator)
+        : orders_{ std::move(other.orders_), allocator }
+        , quantities_{ std::move(other.quantities_), allocator }
+        , sums_{ std::move(other.sums_), allocator }
+        , mask_{ other.mask_ }
+        , head_{ other.head_ }
+        , tail_{ other.tail_ }
+        , live_{ other.live_ }
+        , tombstones_{ other.tombstones_ }
+    { }
+
+    LevelQueue(LevelQueue&&) = default;
+
+    bool Empty() const { return live_ == 0; }
+    std::size_t Size() const { return live_; }
+    std::size_t Tombstones() const { return tombstones_; }
+
+    // The head is always kept on a live slot, so the front is a plain lookup
+    const OrderPointer& Front() const { return orders_[head_ & mask_]; }
+
+    Position PushBack(OrderPointer order)
+    {
+        if (tail_ - head_ == orders_.size())
+            Grow();
+
+        const auto position = tail_++;
+        quantities_[position & mask_] = order->GetRemainingQuantity();
+        orders_[position & mask_] = std::move(order);
+        Update(position & mask_, 1, quantities_[position & mask_]);
+        live_++;
+        return position;
+    }
+
+    void PopFront()
+    {
+        Clear(head_);
+        live_--;
+        head_++;
+        SkipTombstones();
+    }
+
+    // The front order was partially filled, keep the cached remaining quantity in sync
+    void ReduceFront(Quantity quantity) { Reduce(head_, quantity); }
+
+    // Same for an order anywhere in the queue (pro-rata fills)
+    void Reduce(Position position, Quantity quantity)
+    {
+        quantities_[position & mask_] -= quantity;
+        Update(position & mask_, 0, -static_cast<std::int64_t>(quantity));
+    }
+
+    // Slots from Begin() to End() in time priority, tombstones included (their order is null, their quantity 0)
+    Position Begin() const { return head_; }
+    Position End() const { return tail_; }
+    const OrderPointer& At(Position position) const { return orders_[position & mask_]; }
+
+    // Tombstone the order at position, onRelocate(OrderId, Position) is called for every order a compaction moves
+    template<typename OnRelocate>
+    void Erase(Position position, OnRelocate&& onRelocate)
+    {
+        if (position == head_)
+        {
+            PopFront();
+            return;
+        }
+
+        Clear(position);
+        live_--;
+        tombstones_++;
+
+        // More dead slots than live ones: walks would mostly read tombstones, squeeze them out
+        if (tombstones_ >= MinimumCompaction && tombstones_ > live_)
+            Compact(onRelocate);
+    }
+
+    // Sum of the remaining quantity at this level, tombstones hold 0 so they don't need a branch
+    Quantity TotalQuantity() const
+    {
+        std::uint64_t total{ };
+        ForEachSlot([&total](const Quantity* quantities, std::size_t count)
+            {
+                total += DepthKernels::Sum(quantities, count);
+            });
+        return static_cast<Quantity>(total);
+    }
+
+    // Live orders & their remaining quantity in front of the order at position (itself excluded)
+    // The occupied part of the ring is at most 2 runs of slots, each one a difference of 2 prefix sums
+    Ahead AheadOf(Position position) const
+    {
+        const auto begin = head_ & mask_;
+        const auto slot = position & mask_;
+        if (begin <= slot)
+            return Minus(Prefix(slot), Prefix(begin));
+
+        const auto wrapped = Minus(Prefix(quantities_.size()), Prefix(begin));
+        const auto front = Prefix(slot);
+        return Ahead{ wrapped.orders_ + front.orders_, wrapped.quantity_ + front.quantity_ };
+    }
+
+    // Visit the live orders in time priority
+    template<typename Function>
+    void ForEach(Function&& function) const
+    {
+        for (auto position = head_; position != tail_; position++)
+        {
+            const auto& order = orders_[position & mask_];
+            if (order)
+                function(order);
+        }
+    }
+
+    // Calls function(const Quantity*, count) over the occupied part of the ring, at most 2 contiguous chunks
+    // Together they are the slots from Begin() to End() in that order
+    template<typename Function>
+    void ForEachSlot(Function&& function) const
+    {
+        if (head_ == tail_)
+            return;
+
+        const auto begin = head_ & mask_;
+        const auto count = static_cast<std::size_t>(tail_ - head_);
+        const auto firstChunk = std::min(count, quantities_.size() - begin);
+
+        function(quantities_.data() + begin, firstChunk);
+        if (firstChunk < count)
+            function(quantities_.data(), count - firstChunk);
+    }
+
+private:
+    static constexpr std::size_t InitialCapacity = 8;
+    static constexpr std::size_t MinimumCompaction = 16;
+
+    void Clear(Position position)
+    {
+        Update(position & mask_, -1, -static_cast<std::int64_t>(quantities_[position & mask_]));
+        orders_[position & mask_].reset();
+        quantities_[position & mask_] = 0;
+    }
+
+    void SkipTombstones()
+    {
+        while (head_ != tail_ && !orders_[head_ & mask_])
+        {
+            head_++;
+            tombstones_--;
+        }
+
+        // Nothing left, restart from the beginning of the buffer
+        if (head_ == tail_)
+        {
+            head_ = tail_ = 0;
+            tombstones_ = 0;
+        }
+    }
+
+    // Double the capacity, every order keeps its absolute position
+    void Grow()
+    {
+        const auto capacity = orders_.empty() ? InitialCapacity : orders_.size() * 2;
+        std::pmr::vector<OrderPointer> orders(capacity, orders_.get_allocator());
+        std::pmr::vector<Quantity> quantities(capacity, quantities_.get_allocator());
+
+        for (auto position = head_; position != tail_; position++)
+        {
+            orders[position & (capacity - 1)] = std::move(orders_[position & mask_]);
+            quantities[position & (capacity - 1)] = quantities_[position & mask_];
+        }
+
+        orders_ = std::move(orders);
+        quantities_ = std::move(quantities);
+        mask_ = capacity - 1;
+        Rebuild();
+    }
+
+    // Slide the live orders down over the tombstones, keeping their order and the head position
+    template<typename OnRelocate>
+    void Compact(OnRelocate& onRelocate)
+    {
+        auto write = head_;
+        for (auto read = head_; read != tail_; read++)
+        {
+            auto& order = orders_[read & mask_];
+            if (!order)
+                continue;
+
+            if (read != write)
+            {
+                orders_[write & mask_] = std::move(order);
+                quantities_[write & mask_] = quantities_[read & mask_];
+                quantities_[read & mask_] = 0;
+                onRelocate(orders_[write & mask_]->GetOrderId(), write);
+            }
+            write++;
+        }
+
+        tail_ = write;
+        tombstones_ = 0;
+        Rebuild();
+    }
+
+    // Fenwick tree, node i (1 based, stored at sums_[i - 1]) covers the slots (i - lowbit(i), i]
+    // Same size as the slot arrays so it comes from the same pool bucket
+    // Slots hold 0 / 1 orders and their quantity, tombstones & free slots are 0 so they never count
+    void Update(std::size_t slot, std::int64_t orders, std::int64_t quantity) noexcept
+    {
+        for (auto i = slot + 1; i <= sums_.size(); i += i & (~i + 1))
+        {
+            sums_[i - 1].orders_ += orders;
+            sums_[i - 1].quantity_ += quantity;
+        }
+    }
+
+    // Sum over the slots [0, slot)
+    Ahead Prefix(std::size_t slot) const noexcept
+    {
+        Ahead sum{ };
+        for (auto i = slot; i > 0; i -= i & (~i + 1))
+        {
+            sum.orders_ += sums_[i - 1].orders_;
+            sum.quantity_ += sums_[i - 1].quantity_;
+        }
+        return sum;
+    }
+
+    static Ahead Minus(const Ahead& left, const Ahead& right) noexcept
+    {
+        return Ahead{ left.orders_ - right.orders_, left.quantity_ - right.quantity_ };
+    }
+
+    // O(n) build after the slots moved: every node pushes its total to its parent
+    void Rebuild()
+    {
+        sums_.assign(quantities_.size(), Ahead{ });
+        for (std::size_t i = 1; i <= sums_.size(); i++)
+        {
+            if (orders_[i - 1])
+            {
+                sums_[i - 1].orders_ += 1;
+                sums_[i - 1].quantity_ += quantities_[i - 1];
+            }
+
+            const auto parent = i + (i & (~i + 1));
+            if (parent <= sums_.size())
+            {
+                sums_[parent - 1].orders_ += sums_[i - 1].orders_;
+                sums_[parent - 1].quantity_ += sums_[i - 1].quantity_;
+            }
+        }
+    }
+
+    std::pmr::vector<OrderPointer> orders_;
+    std::pmr::vector<Quantity> quantities_;
+    std::pmr::vector<Ahead> sums_;
+    Position mask_{ 0 };
+    Position head_{ 0 };
+    Position tail_{ 0 };
+    std::size_t live_{ 0 };
+    std::size_t tombstones_{ 0 };
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32) || defined(_WIN64)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Read only memory mapping of a whole file, readers scan it in place and the page cache does the buffering
+// Pages are only read when touched, so skipping part of a file costs nothing
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::filesystem::path& path)
+    {
+    #if defined(_WIN32) || defined(_WIN64)
+        file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER size{ };
+        if (file_ != INVALID_HANDLE_VALUE && GetFileSizeEx(file_, &size) && size.QuadPart > 0)
+        {
+            size_ = static_cast<std::size_t>(size.QuadPart);
+            mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping_)
+                data_ = static_cast<const std::uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        }
+    #else
+        const int fd = open(path.c_str(), O_RDONLY);
+        struct stat status{ };
+        if (fd >= 0 && fstat(fd, &status) == 0 && status.st_size > 0)
+        {
+            size_ = static_cast<std::size_t>(status.st_size);
+            void* memory = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            data_ = memory == MAP_FAILED ? nullptr : static_cast<const std::uint8_t*>(memory);
+        }
+        if (fd >= 0)
+            close(fd);
+    #endif
+
+        if (!data_)
+        {
+            Release();
+            throw std::runtime_error("Cannot map " + path.string());
+        }
+    }
+
+    ~MappedFile() { Release(); }
+
+    MappedFile(const MappedFile&) = delete;
+    void operator=(const MappedFile&) = delete;
+
+    const std::uint8_t* Data() const { return data_; }
+    std::size_t Size() const { return size_; }
+
+private:
+    void Release()
+    {
+    #if defined(_WIN32) || defined(_WIN64)
+        if (data_)
+            UnmapViewOfFile(data_);
+        if (mapping_)
+            CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE)
+            CloseHandle(file_);
+    #else
+        if (data_)
+            munmap(const_cast<std::uint8_t*>(data_), size_);
+    #endif
+        data_ = nullptr;
+    }
+
+    const std::uint8_t* data_{ nullptr };
+    std::size_t size_{ 0 };
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE file_{ INVALID_HANDLE_VALUE };
+    HANDLE mapping_{ nullptr };
+#endif
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "BookEvent.h"
+#include "LevelInfo.h"
+
+// What a subscriber gets from one Poll: every level that changed since its previous Poll, each only once
+struct ConflatedUpdate
+{
+    std::uint64_t sequence_{ };     // Book state as of this event
+    std::uint64_t checksum_{ };     // BookChecksum at sequence_
+    std::uint64_t conflated_{ };    // Level changes merged away because the subscriber hadn't read the previous ones
+    std::vector<LevelUpdate> levels_;   // Bids best first, then asks best first
+};
+
+// One reader of the fan out, only ever holds the latest state per level it hasn't read yet
+// so however far behind the reader falls its buffer is bounded by the number of price levels
+class MarketDataSubscriber
+{
+public:
+    // Takes everything dirty since the last call, false when nothing changed
+    bool Poll(ConflatedUpdate& update)
+    {
+        LevelMap dirty;
+        {
+            // Only swaps the buffer, the publisher never waits on the reader's processing
+            std::scoped_lock lock{ mutex_ };
+            if (dirty_.empty())
+                return false;
+
+            dirty.swap(dirty_);
+            update.sequence_ = sequence_;
+            update.checksum_ = checksum_;
+            update.conflated_ = conflated_;
+            conflated_ = 0;
+        }
+
+        update.levels_.clear();
+        update.levels_.reserve(dirty.size());
+        for (const auto& [_, level] : dirty)
+            update.levels_.push_back(level);
+
+        std::sort(update.levels_.begin(), update.levels_.end(), [](const LevelUpdate& left, const LevelUpdate& right)
+            {
+                if (left.side_ != right.side_)
+                    return left.side_ == Side::Buy;
+                return left.side_ == Side::Buy ? left.price_ > right.price_ : left.price_ < right.price_;
+            });
+        return true;
+    }
+
+    // Levels waiting to be read
+    std::size_t Pending() const
+    {
+        std::scoped_lock lock{ mutex_ };
+        return dirty_.size();
+    }
+
+private:
+    friend class MarketDataFanout;
+
+    using LevelMap = std::unordered_map<std::uint64_t, LevelUpdate>;
+
+    static std::uint64_t Key(Side side, Price price)
+    {
+        return static_cast<std::uint64_t>(static_cast<std::uint32_t>(price)) << 1 | (side == Side::Sell ? 1 : 0);
+    }
+
+    void Publish(const LevelUpdate& level, std::uint64_t checksum)
+    {
+        std::scoped_lock lock{ mutex_ };
+        auto [it, inserted] = dirty_.try_emplace(Key(level.side_, level.price_), level);
+        if (!inserted)
+        {
+            it->second = level;
+            conflated_++;
+        }
+        sequence_ = level.sequence_;
+        checksum_ = checksum;
+    }
+
+    mutable std::mutex mutex_;
+    LevelMap dirty_;
+    std::uint64_t sequence_{ };
+    std::uint64_t checksum_{ };
+    std::uint64_t conflated_{ };
+};
+
+using MarketDataSubscriberPointer = std::shared_ptr<MarketDataSubscriber>;
+
+// Market data stage between the book and its consumers: attach it with Orderbook::AddListener
+// It keeps the aggregated depth of the book and hands every subscriber its own conflated view of it
+// A slow subscriber skips the intermediate states and reads the freshest state of each level that changed,
+// nothing queues up per event and the matching thread never waits for a reader
+class MarketDataFanout : public BookEventListener
+{
+public:
+    // A new subscriber starts with the whole current depth waiting to be read
+    MarketDataSubscriberPointer Subscribe()
+    {
+        auto subscriber = std::make_shared<MarketDataSubscriber>();
+
+        std::scoped_lock lock{ mutex_ };
+        for (const auto& [_, level] : levels_)
+            subscriber->Publish(level, checksum_);
+        subscribers_.push_back(subscriber);
+        return subscriber;
+    }
+
+    void Unsubscribe(const MarketDataSubscriberPointer& subscriber)
+    {
+        std::scoped_lock lock{ mutex_ };
+        subscribers_.erase(std::remove(subscribers_.begin(), subscribers_.end(), subscriber), subscribers_.end());
+    }
+
+    void OnBookEvent(const BookEvent& event) override
+    {
+        std::scoped_lock lock{ mutex_ };
+        checksum_ = event.checksum_;
+
+        // A fill comes once per side, each event only moves the level of its own order
+        auto& level = levels_.try_emplace(MarketDataSubscriber::Key(event.side_, event.price_), LevelUpdate{ event.side_, event.price_, 0, 0, 0 }).first->second;
+        switch (event.type_)
+        {
+            case BookEventType::Add:
+                level.quantity_ += event.quantity_;
+                level.orderCount_++;
+                break;
+            case BookEventType::Cancel:
+                level.quantity_ -= event.quantity_;
+                level.orderCount_--;
+                break;
+            case BookEventType::Fill:
+                level.quantity_ -= event.quantity_;
+                if (event.remaining_ == 0)
+                    level.orderCount_--;
+                break;
+        }
+        level.sequence_ = event.sequence_;
+
+        const auto update = level;
+        if (level.orderCount_ == 0)
+            levels_.erase(MarketDataSubscriber::Key(event.side_, event.price_));
+
+        for (const auto& subscriber : subscribers_)
+            subscriber->Publish(update, checksum_);
+    }
+
+private:
+    std::mutex mutex_;
+    MarketDataSubscriber::LevelMap levels_;
+    std::uint64_t checksum_{ };
+    std::vector<MarketDataSubscriberPointer> subscribers_;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Usings.h"
+
+// How an incoming order is split between the orders resting at a price level
+enum class MatchingAlgorithm : std::uint8_t
+{
+    Fifo,           // Price time priority: the oldest order is filled first, completely
+    ProRata,        // In proportion to each order's remaining quantity
+    TopOrderProRata // The oldest order first (the one that set the level), pro-rata across the rest
+};
+
+// Per book matching policy (OrderbookConfig::matching_)
+// A pro-rata share is rounded down and dropped when below minimumAllocation_, what that leaves of the
+// incoming order is then handed out in time priority, so the same book always allocates the same way
+// An order big enough for the whole level fills it completely whatever the policy
+struct MatchingPolicy
+{
+    MatchingAlgorithm algorithm_{ MatchingAlgorithm::Fifo };
+    Quantity minimumAllocation_{ 1 };
+};
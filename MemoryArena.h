@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+
+#if defined(_WIN32) || defined(_WIN64)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+// One big preallocated block of memory the engine carves its orders, levels and indexes from
+// It is backed by 2MB huge pages when the OS gives us some (far fewer TLB entries for a multi million order book),
+// falls back to transparent huge pages / normal pages otherwise, can be bound to a NUMA node
+// and can be pre-faulted so the first orders of the day don't pay for page faults
+// Allocation is a lock protected bump pointer, memory is never given back: put a pool resource on top to recycle it.
+// Once the block is used up requests go to the upstream resource instead of failing
+class MemoryArena : public std::pmr::memory_resource
+{
+public:
+    static constexpr std::size_t HugePageSize = 2 * 1024 * 1024;
+
+    struct Options
+    {
+        std::size_t bytes_{ 0 };
+        bool hugePages_{ true };
+        int numaNode_{ -1 };     // -1 leaves placement to the OS
+        bool prefault_{ true };
+    };
+
+    explicit MemoryArena(const Options& options, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : upstream_{ upstream }
+    {
+        capacity_ = (options.bytes_ + HugePageSize - 1) / HugePageSize * HugePageSize;
+        if (capacity_ == 0)
+            return;
+
+        Map(options);
+
+        if (base_ && options.prefault_)
+            Prefault();
+    }
+
+    ~MemoryArena() override
+    {
+        if (!base_)
+            return;
+
+    #if defined(_WIN32) || defined(_WIN64)
+        VirtualFree(base_, 0, MEM_RELEASE);
+    #elif defined(__linux__)
+        munmap(base_, capacity_);
+    #else
+        ::operator delete(base_, std::align_val_t{ HugePageSize });
+    #endif
+    }
+
+    MemoryArena(const MemoryArena&) = delete;
+    void operator=(const MemoryArena&) = delete;
+
+    bool UsesHugePages() const { return hugePages_; }
+    bool IsNumaBound() const { return numaBound_; }
+    std::size_t Capacity() const { return base_ ? capacity_ : 0; }
+
+    std::size_t Used() const
+    {
+        std::scoped_lock lock{ mutex_ };
+        return used_;
+    }
+
+    // Bytes that didn't fit into the arena and came from upstream
+    std::size_t Overflow() const
+    {
+        std::scoped_lock lock{ mutex_ };
+        return overflow_;
+    }
+
+private:
+    void Map(const Options& options)
+    {
+    #if defined(_WIN32) || defined(_WIN64)
+        // Large pages need the "Lock pages in memory" privilege, without it VirtualAlloc fails and we retry with normal pages
+        const DWORD flags = MEM_RESERVE | MEM_COMMIT;
+        if (options.hugePages_ && GetLargePageMinimum() != 0)
+        {
+            base_ = options.numaNode_ >= 0
+                ? VirtualAllocExNuma(GetCurrentProcess(), nullptr, capacity_, flags | MEM_LARGE_PAGES, PAGE_READWRITE, options.numaNode_)
+                : VirtualAlloc(nullptr, capacity_, flags | MEM_LARGE_PAGES, PAGE_READWRITE);
+            hugePages_ = base_ != nullptr;
+        }
+        if (!base_)
+        {
+            base_ = options.numaNode_ >= 0
+                ? VirtualAllocExNuma(GetCurrentProcess(), nullptr, capacity_, flags, PAGE_READWRITE, options.numaNode_)
+                : VirtualAlloc(nullptr, capacity_, flags, PAGE_READWRITE);
+        }
+        numaBound_ = base_ && options.numaNode_ >= 0;
+    #elif defined(__linux__)
+        // Explicit huge pages come from the pool reserved in /proc/sys/vm/nr_hugepages
+        if (options.hugePages_)
+        {
+            void* memory = mmap(nullptr, capacity_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (memory != MAP_FAILED)
+            {
+                base_ = memory;
+                hugePages_ = true;
+            }
+        }
+        if (!base_)
+        {
+            void* memory = mmap(nullptr, capacity_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+                return;
+
+            base_ = memory;
+            // No reserved pool, ask for transparent huge pages instead (best effort)
+            if (options.hugePages_)
+                madvise(base_, capacity_, MADV_HUGEPAGE);
+        }
+
+        // Bind before the pages are touched, otherwise they are already placed
+        if (options.numaNode_ >= 0 && options.numaNode_ < 64)
+        {
+            constexpr int BindPolicy = 2; // MPOL_BIND
+            const unsigned long nodeMask = 1ul << options.numaNode_;
+            numaBound_ = syscall(SYS_mbind, base_, capacity_, BindPolicy, &nodeMask, sizeof(nodeMask) * 8, 0) == 0;
+        }
+    #else
+        base_ = ::operator new(capacity_, std::align_val_t{ HugePageSize }, std::nothrow);
+    #endif
+    }
+
+    // Touch every page once so it's backed (and on the right node) before trading starts
+    void Prefault()
+    {
+        constexpr std::size_t PageSize = 4096;
+        auto* bytes = static_cast<volatile std::byte*>(base_);
+        for (std::size_t offset = 0; offset < capacity_; offset += PageSize)
+            bytes[offset] = std::byte{ 0 };
+    }
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        {
+            std::scoped_lock lock{ mutex_ };
+            const auto start = (used_ + alignment - 1) & ~(alignment - 1);
+            if (base_ && start + bytes <= capacity_)
+            {
+                used_ = start + bytes;
+                return static_cast<std::byte*>(base_) + start;
+            }
+            overflow_ += bytes;
+        }
+
+        return upstream_->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override
+    {
+        // Arena memory is only released with the arena, the overflow goes back where it came from
+        const auto* address = static_cast<std::byte*>(pointer);
+        const auto* base = static_cast<std::byte*>(base_);
+        if (base && address >= base && address < base + capacity_)
+            return;
+
+        upstream_->deallocate(pointer, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* upstream_;
+    void* base_{ nullptr };
+    std::size_t capacity_{ 0 };
+    bool hugePages_{ false };
+    bool numaBound_{ false };
+
+    mutable std::mutex mutex_;
+    std::size_t used_{ 0 };
+    std::size_t overflow_{ 0 };
+};
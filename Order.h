@@ -40,23 +40,42 @@ public:
     Quantity GetFilledQuantity() const { return GetInitialQuantity() - GetRemainingQuantity(); }
     bool IsFilled() const { return GetRemainingQuantity() == 0; }
 
+    // Trading account the order belongs to, 0 when the caller doesn't use accounts
+    AccountId GetAccount() const { return account_; }
+    void SetAccount(AccountId account) { account_ = account; }
+
     // Filling the Order
     void Fill(Quantity quantity)
+    {
+        if (!TryFill(quantity))
+            throw std::logic_error("Order (" + std::to_string(GetOrderId()) + ") cannot be filled for more than its remaining quantity");
+    }
+
+    void ToGoodTillCancel(Price price)
+    {
+        if (!TryToGoodTillCancel(price))
+            throw std::logic_error("Order (" + std::to_string(GetOrderId()) + ") cannot have its price adjusted, only market orders can.");
+    }
+
+    // Non throwing versions for the matching path, false leaves the order untouched
+    bool TryFill(Quantity quantity) noexcept
     {
         // it doesnt make sense when the quantity want to fill exceed the reamining quantity
         if (quantity > GetRemainingQuantity())
-            throw std::logic_error("Order (" + std::to_string(GetOrderId()) + ") cannot be filled for more than its remaining quantity");
+            return false;
 
         remainingQuantity_ -= quantity;
+        return true;
     }
 
-    void ToGoodTillCancel(Price price)
+    bool TryToGoodTillCancel(Price price) noexcept
     {
         if (GetOrderType() != OrderType::Market)
-            throw std::logic_error("Order (" + std::to_string(GetOrderId()) + ") cannot have its price adjusted, only market orders can.");
+            return false;
 
         price_ = price;
         orderType_ = OrderType::GoodTillCancel;
+        return true;
     }
 
 private:
@@ -67,6 +86,7 @@ private:
     Price price_;
     Quantity initialQuantity_;
     Quantity remainingQuantity_;
+    AccountId account_{ 0 };
 };
 
 using OrderPointer = std::shared_ptr<Order>;
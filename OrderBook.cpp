@@ -1,4 +1,7 @@
 #include "OrderBook.h"
+#include "FlowGenerator.h"
+#include "ThreadAffinity.h"
+#include "DepthKernels.h"
 #include <numeric>
 #include <chrono>
 #include <ctime>
@@ -7,11 +10,14 @@
 #include <locale>
 #include <iomanip>
 #include <optional>
+#include <algorithm>
+#include <array>
+#include <limits>
 
 void Orderbook::PruneGoodForDayOrders()
 {
 	using namespace std::chrono;
-	const auto end = hours(16);
+	const auto end = Constants::MarketClose;
 
 	// Thread is spinning at a loop until 4pm to cancel all GoodForDays order
 	while (true)
@@ -51,27 +57,33 @@ void Orderbook::PruneGoodForDayOrders()
 		}
 
 		// Proceed after reach 4pm
-		OrderIds orderIds;
+		ExpireGoodForDayOrders();
+	}
+}
 
-		{
-			std::scoped_lock ordersLock{ ordersMutex_ };
+void Orderbook::ExpireGoodForDayOrders()
+{
+	OrderIds orderIds;
 
-			// Iterate every our orders we have outstanding
-			// Collect the order Id of GoodForDay order because this method is particularly for this type of order only
-			for (const auto& [_, entry] : orders_)
-			{
-				const auto& [order, __] = entry;
+	{
+		std::scoped_lock ordersLock{ ordersMutex_ };
 
-				if (order->GetOrderType() != OrderType::GoodForDay)
-					continue;
+		// Iterate every our orders we have outstanding
+		// Collect the order Id of GoodForDay order because this method is particularly for this type of order only
+		for (const auto& [_, entry] : orders_)
+		{
+			const auto& [order, __] = entry;
 
-				orderIds.push_back(order->GetOrderId());
+			if (order->GetOrderType() != OrderType::GoodForDay)
+				continue;
+
+			orderIds.push_back(order->GetOrderId());
+			if (logTransactions_)
 				TransactionLog_.addTransaction("GoodForDay order " + std::to_string(order->GetOrderId()) + " removed due to expiration");
-			}
 		}
-
-		CancelOrders(orderIds);
 	}
+
+	CancelOrders(orderIds);
 }
 
 void Orderbook::CancelOrders(OrderIds orderIds)
@@ -86,53 +98,59 @@ void Orderbook::CancelOrders(OrderIds orderIds)
 		CancelOrderInternal(orderId);
 }
 
-void Orderbook::CancelOrderInternal(OrderId orderId)
+bool Orderbook::CancelOrderInternal(OrderId orderId) noexcept
 {
 	if (!orders_.count(orderId))
-		return;
+		return false;
 
-	const auto [order, iterator] = orders_.at(orderId);
+	const auto [order, location] = orders_.at(orderId);
 	orders_.erase(orderId);
 
+	// The slot only becomes a tombstone, if that triggers a compaction the moved orders get their new slot here
+	auto relocate = [this](OrderId movedId, LevelQueue::Position movedLocation) { orders_.at(movedId).location_ = movedLocation; };
+
 	if (order->GetSide() == Side::Sell)
 	{
 		auto price = order->GetPrice();
 		auto& orders = asks_.at(price);
-		orders.erase(iterator); // Erasing the particular order for the price and the iterator point to
-		if (orders.empty()) // If there is no more order in this price point
+		orders.Erase(location, relocate); // Erasing the particular order for the price and the slot it sits in
+		if (orders.Empty()) // If there is no more order in this price point
 			asks_.erase(price); // straight delete the the key and value pair in the hash
 	}
 	else
 	{
 		auto price = order->GetPrice();
 		auto& orders = bids_.at(price);
-		orders.erase(iterator);
-		if (orders.empty())
+		orders.Erase(location, relocate);
+		if (orders.Empty())
 			bids_.erase(price);
 	}
 
-	TransactionLog_.addTransaction("Order " + std::to_string(orderId) + " cancelled");
+	if (logTransactions_)
+		TransactionLog_.addTransaction("Order " + std::to_string(orderId) + " cancelled");
+	PublishEvent(BookEventType::Cancel, *order, order->GetRemainingQuantity());
 	OnOrderCancelled(order);
+	return true;
 }
 
-void Orderbook::OnOrderCancelled(OrderPointer order)
+void Orderbook::OnOrderCancelled(const OrderPointer& order) noexcept
 {
 	UpdateLevelData(order->GetPrice(), order->GetRemainingQuantity(), LevelData::Action::Remove);
 }
 
-void Orderbook::OnOrderAdded(OrderPointer order)
+void Orderbook::OnOrderAdded(const OrderPointer& order) noexcept
 {
 	UpdateLevelData(order->GetPrice(), order->GetInitialQuantity(), LevelData::Action::Add);
 }
 
-void Orderbook::OnOrderMatched(Price price, Quantity quantity, bool isFullyFilled)
+void Orderbook::OnOrderMatched(Price price, Quantity quantity, bool isFullyFilled) noexcept
 {
 	// If the order is fully filled, we need to remove that order count from our bookkeeping data structure
 	// if not fully filled just dont touch the bookkeeping
 	UpdateLevelData(price, quantity, isFullyFilled ? LevelData::Action::Remove : LevelData::Action::Match);
 }
 
-void Orderbook::UpdateLevelData(Price price, Quantity quantity, LevelData::Action action)
+void Orderbook::UpdateLevelData(Price price, Quantity quantity, LevelData::Action action) noexcept
 {
 	auto& data = data_[price];
 
@@ -153,52 +171,54 @@ void Orderbook::UpdateLevelData(Price price, Quantity quantity, LevelData::Actio
 		data_.erase(price);
 }
 
-bool Orderbook::CanFullyFill(Side side, Price price, Quantity quantity) const
+bool Orderbook::CanFullyFill(Side side, Price price, Quantity quantity) const noexcept
 {
 /*
 Basically work the same as CanMatch but this 1 is specifically designed for CanFullyFill or not the match order
+The totals of the levels the order can reach are copied best price first into a small block of contiguous quantities,
+the sweep kernel then tells whether the block covers what's left of the order
+The totals come from the levels themselves: data_ is keyed by price alone, so an order that crossed and emptied
+its own level at a price also took the bookkeeping of the opposite level resting there
 */
 	if (!CanMatch(side, price))
 		return false;
 
-	std::optional<Price> threshold;
-
-	if (side == Side::Buy)
-	{
-		// Getting the range of asks price for the person [buy price, best ask (cheapest)]
-		const auto [askPrice, _] = *asks_.begin();
-		threshold = askPrice;
-	}
-	else
-	{
-		const auto [bidPrice, _] = *bids_.begin();
-		threshold = bidPrice;
-	}
-
-	for (const auto& [levelPrice, levelData] : data_)
-	{
-		if (threshold.has_value() &&
-			(side == Side::Buy && threshold.value() > levelPrice) ||
-			(side == Side::Sell && threshold.value() < levelPrice))
-			continue;
+	std::array<Quantity, 64> levels;
+	std::size_t count = 0;
+	std::uint64_t remaining = quantity;
 
-		if ((side == Side::Buy && levelPrice > price) ||
-			(side == Side::Sell && levelPrice < price))
-			continue;
+	// Sweeps the block gathered so far, true once it covers the order
+	auto sweep = [&]()
+		{
+			if (DepthKernels::LevelsToSweep(levels.data(), count, remaining) != DepthKernels::Insufficient)
+				return true;
+			remaining -= DepthKernels::Sum(levels.data(), count);
+			count = 0;
+			return false;
+		};
 
-		// if this level of quantity is enough to fill the order straight return
-		if (quantity <= levelData.quantity_)
-			return true;
+	auto walk = [&](const auto& book, auto&& reachable)
+		{
+			// Walking the opposite side from its best price, stop at the first level beyond the order's price
+			for (const auto& [levelPrice, orders] : book)
+			{
+				if (!reachable(levelPrice))
+					break;
 
-		// Keep repeating fill the order if this level of quantity isnt enuf to fully filled
-		quantity -= levelData.quantity_;
-	}
+				levels[count++] = orders.TotalQuantity();
+				if (count == levels.size() && sweep())
+					return true;
+			}
+			// Coulnt fully filled unless the last block does it
+			return count > 0 && sweep();
+		};
 
-	// Coulnt fully filled
-	return false;
+	if (side == Side::Buy)
+		return walk(asks_, [price](Price levelPrice) { return levelPrice <= price; });
+	return walk(bids_, [price](Price levelPrice) { return levelPrice >= price; });
 }
 
-bool Orderbook::CanMatch(Side side, Price price) const
+bool Orderbook::CanMatch(Side side, Price price) const noexcept
 {
 /*
 This function is to check whether we can match this order in the orderbook or not (eg: Match a buy order to a sell order)
@@ -227,11 +247,148 @@ This function is to check whether we can match this order in the orderbook or no
 	}
 }
 
-Trades Orderbook::MatchOrders()
+void Orderbook::MatchOrders(OrderId aggressorId, Trades* trades, ExecutionReports* reports) noexcept
 {
 	// See whether the bestBid and bestAsk can match or not
-	Trades trades;
-	trades.reserve(orders_.size());
+	// Every fill goes out as BookEvents, the caller gets either one Trade per fill or one ExecutionReport per level
+	const auto firstReport = reports ? reports->size() : 0;
+	double aggressorNotional{ };
+	Quantity aggressorQuantity{ };
+
+	// Everything a fill publishes, whichever way the level was allocated
+	auto record = [&](const OrderPointer& bid, const OrderPointer& ask, Quantity quantity)
+		{
+			PublishEvent(BookEventType::Fill, *bid, quantity, ask.get());
+			PublishEvent(BookEventType::Fill, *ask, quantity, bid.get());
+
+			if (trades)
+			{
+				trades->push_back(Trade{
+					TradeInfo{ bid->GetOrderId(), bid->GetPrice(), quantity },
+					TradeInfo{ ask->GetOrderId(), ask->GetPrice(), quantity }
+					});
+			}
+			else if (reports)
+			{
+				// The book was uncrossed before the aggressor came in, so it is on one side of every fill
+				const auto& aggressor = bid->GetOrderId() == aggressorId ? bid : ask;
+				const auto& contra = bid->GetOrderId() == aggressorId ? ask : bid;
+
+				aggressorNotional += static_cast<double>(contra->GetPrice()) * quantity;
+				aggressorQuantity += quantity;
+
+				if (reports->size() == firstReport || reports->back().price_ != contra->GetPrice())
+					reports->push_back(ExecutionReport{ aggressorId, aggressor->GetSide(), contra->GetPrice(), 0, 0, 0.0 });
+
+				auto& report = reports->back();
+				report.quantity_ += quantity;
+				report.contraCount_++;
+				report.vwap_ = aggressorNotional / aggressorQuantity;
+			}
+
+			OnOrderMatched(bid->GetPrice(), quantity, bid->IsFilled());
+			OnOrderMatched(ask->GetPrice(), quantity, ask->IsFilled());
+		};
+
+	// Pro-rata books: split the aggressor over the resting level it crossed in one pass
+	// When it's big enough for the whole level FIFO fills it completely anyway and the FIFO loop does it,
+	// as it does a level holding more than a Quantity can count (the shares are computed in 32 bits)
+	auto allocate = [&](LevelQueue& bids, LevelQueue& asks)
+		{
+			// The book was uncrossed, so the aggressor is alone at the front of its level
+			const bool buying = bids.Front()->GetOrderId() == aggressorId;
+			if (!buying && asks.Front()->GetOrderId() != aggressorId)
+				return;
+
+			auto& incoming = buying ? bids : asks;
+			auto& resting = buying ? asks : bids;
+			const auto aggressor = incoming.Front();
+			auto fill = [&](const OrderPointer& order, Quantity quantity)
+				{
+					aggressor->TryFill(quantity);
+					order->TryFill(quantity);
+					if (buying)
+						record(aggressor, order, quantity);
+					else
+						record(order, aggressor, quantity);
+				};
+
+			// The order that set the level is served first
+			if (matching_.algorithm_ == MatchingAlgorithm::TopOrderProRata)
+			{
+				const auto top = resting.Front();
+				const auto quantity = std::min(aggressor->GetRemainingQuantity(), top->GetRemainingQuantity());
+				if (quantity == top->GetRemainingQuantity())
+				{
+					resting.PopFront();
+					orders_.erase(top->GetOrderId());
+				}
+				else
+					resting.ReduceFront(quantity);
+				fill(top, quantity);
+			}
+
+			std::uint64_t total{ };
+			resting.ForEachSlot([&total](const Quantity* quantities, std::size_t count) { total += DepthKernels::Sum(quantities, count); });
+
+			const auto incomingQuantity = aggressor->GetRemainingQuantity();
+			if (incomingQuantity > 0 && incomingQuantity < total && total <= std::numeric_limits<Quantity>::max())
+			{
+				// Rounded down shares of every slot in one vectorized pass per contiguous chunk
+				shares_.resize(static_cast<std::size_t>(resting.End() - resting.Begin()));
+				std::uint64_t allocated{ };
+				std::size_t offset{ };
+				resting.ForEachSlot([&](const Quantity* quantities, std::size_t count)
+					{
+						allocated += DepthKernels::ProRata(quantities, count, incomingQuantity, static_cast<Quantity>(total), matching_.minimumAllocation_, shares_.data() + offset);
+						offset += count;
+					});
+
+				// What the rounding left over goes in time priority, the level holds more than the aggressor so it always fits
+				auto leftover = static_cast<Quantity>(incomingQuantity - allocated);
+				for (auto position = resting.Begin(); leftover > 0 && position != resting.End(); position++)
+				{
+					const auto& order = resting.At(position);
+					auto& share = shares_[position - resting.Begin()];
+					if (!order)
+						continue;
+
+					const auto extra = std::min(leftover, order->GetRemainingQuantity() - share);
+					share += extra;
+					leftover -= extra;
+				}
+
+				// Filled orders stay in their slots till the end so the shares keep lining up with them
+				matched_.clear();
+				for (auto position = resting.Begin(); position != resting.End(); position++)
+				{
+					const auto share = shares_[position - resting.Begin()];
+					if (share == 0)
+						continue;
+
+					const auto order = resting.At(position);
+					if (share == order->GetRemainingQuantity())
+						matched_.push_back(order->GetOrderId());
+					else
+						resting.Reduce(position, share);
+					fill(order, share);
+				}
+
+				// A compaction on the way moves orders, the callback keeps their entries pointing at their slots
+				auto relocate = [this](OrderId movedId, LevelQueue::Position movedLocation) { orders_.at(movedId).location_ = movedLocation; };
+				for (const auto orderId : matched_)
+				{
+					resting.Erase(orders_.at(orderId).location_, relocate);
+					orders_.erase(orderId);
+				}
+			}
+
+			if (aggressor->IsFilled())
+			{
+				incoming.PopFront();
+				orders_.erase(aggressorId);
+			}
+		};
 
 	while (true)
 	{
@@ -247,97 +404,550 @@ Trades Orderbook::MatchOrders()
 		if (bidPrice < askPrice)
 			break;
 
-		while (!bids.empty() && !asks.empty())
+		if (matching_.algorithm_ != MatchingAlgorithm::Fifo)
+			allocate(bids, asks);
+
+		while (!bids.Empty() && !asks.Empty())
 		{
-			auto bid = bids.front();   // The first in queue for the highest price people offer to buy
-			auto ask = asks.front();   // The first in queue for the lowest price people offer to sell
+			auto bid = bids.Front();   // The first in queue for the highest price people offer to buy
+			auto ask = asks.Front();   // The first in queue for the lowest price people offer to sell
 
 			Quantity quantity = std::min(bid->GetRemainingQuantity(), ask->GetRemainingQuantity());
 
-			bid->Fill(quantity);
-			ask->Fill(quantity);
+			// quantity is the smaller remaining quantity, neither fill can be refused
+			bid->TryFill(quantity);
+			ask->TryFill(quantity);
 
 			// if the order in bid is been filled
-			// we just remove it from the list of orders as well as in bids
+			// we just remove it from the queue of orders as well as in bids
 			if (bid->IsFilled())
 			{
-				bids.pop_front();
+				bids.PopFront();
 				orders_.erase(bid->GetOrderId());
 			}
+			else
+				bids.ReduceFront(quantity);
 
 			// Same goes to ask
 			if (ask->IsFilled())
 			{
-				asks.pop_front();
+				asks.PopFront();
 				orders_.erase(ask->GetOrderId());
 			}
+			else
+				asks.ReduceFront(quantity);
 
-
-			trades.push_back(Trade{
-				TradeInfo{ bid->GetOrderId(), bid->GetPrice(), quantity },
-				TradeInfo{ ask->GetOrderId(), ask->GetPrice(), quantity }
-				});
-
-			OnOrderMatched(bid->GetPrice(), quantity, bid->IsFilled());
-			OnOrderMatched(ask->GetPrice(), quantity, ask->IsFilled());
+			record(bid, ask, quantity);
 		}
 
-		if (bids.empty())
+		if (bids.Empty())
 		{
-			bids_.erase(bidPrice);
+			// bidPrice refers into the map node, so it has to be used before the node is erased
 			data_.erase(bidPrice);
+			bids_.erase(bidPrice);
 		}
 
-		if (asks.empty())
+		if (asks.Empty())
 		{
-			asks_.erase(askPrice);
+			// askPrice refers into the map node, so it has to be used before the node is erased
 			data_.erase(askPrice);
+			asks_.erase(askPrice);
 		}
 	}
 
 	if (!bids_.empty())
 	{
 		auto& [_, bids] = *bids_.begin();
-		auto& order = bids.front();
+		auto& order = bids.Front();
 		if (order->GetOrderType() == OrderType::FillAndKill)
-			CancelOrder(order->GetOrderId());
+			CancelOrderInternal(order->GetOrderId()); // Already holding ordersMutex_ from AddOrder
 	}
 
 	if (!asks_.empty())
 	{
 		auto& [_, asks] = *asks_.begin();
-		auto& order = asks.front();
+		auto& order = asks.Front();
 		if (order->GetOrderType() == OrderType::FillAndKill)
-			CancelOrder(order->GetOrderId());
+			CancelOrderInternal(order->GetOrderId()); // Already holding ordersMutex_ from AddOrder
+	}
+
+	if (!logTransactions_)
+		return;
+
+	if (trades)
+	{
+		for (const auto& trade : *trades) 
+		{
+			TransactionLog_.addTransaction("Trade executed: Bid " + std::to_string(trade.GetBidTrade().orderdId_) +
+				" matched with Ask " + std::to_string(trade.GetAskTrade().orderdId_) +
+				" for " + std::to_string(trade.GetBidTrade().quantity_) +
+				" @ $" + std::to_string(trade.GetBidTrade().price_));
+		}
+	}
+	else if (reports)
+	{
+		for (auto it = reports->begin() + firstReport; it != reports->end(); it++)
+		{
+			TransactionLog_.addTransaction("Execution: " + std::string{ it->side_ == Side::Buy ? "Bid " : "Ask " } + std::to_string(it->aggressorId_) +
+				" traded " + std::to_string(it->quantity_) + " @ $" + std::to_string(it->price_) +
+				" against " + std::to_string(it->contraCount_) + " orders");
+		}
 	}
+}
+
+void Orderbook::PublishEvent(BookEventType type, const Order& order, Quantity quantity, const Order* contra) noexcept
+{
+	// Every change to the resting book goes through here, listened to or not
+	UpdateChecksum(type, order, quantity);
+	if (preTradeCheck_)
+		preTradeCheck_->OnExposure(type, order.GetAccount(), order.GetPrice(), quantity);
+
+	// A quote replace reports each level once at the end, here it only notes which ones it touched
+	if (quoteLevels_ && std::none_of(quoteLevels_->begin(), quoteLevels_->end(),
+		[&order](const LevelUpdate& level) { return level.side_ == order.GetSide() && level.price_ == order.GetPrice(); }))
+		quoteLevels_->push_back(LevelUpdate{ order.GetSide(), order.GetPrice(), 0, 0, 0 });
+
+	// Numbered whether anyone listens or not, so a listener attached later sees the book's own sequence
+	const auto sequence = ++sequence_;
+	if (listeners_.empty())
+		return;
+
+	const auto event = BookEvent{
+		sequence,
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count(),
+		order.GetOrderId(),
+		contra ? contra->GetOrderId() : 0,
+		order.GetPrice(),
+		contra ? contra->GetPrice() : order.GetPrice(),
+		quantity,
+		order.GetRemainingQuantity(),
+		checksum_,
+		type,
+		order.GetSide(),
+		order.GetOrderType(),
+		order.GetAccount() };
+
+	for (auto* listener : listeners_)
+		listener->OnBookEvent(event);
+}
+
+void Orderbook::UpdateChecksum(BookEventType type, const Order& order, Quantity quantity) noexcept
+{
+	const auto remaining = order.GetRemainingQuantity();
 
-	for (const auto& trade : trades) 
+	// Unsigned arithmetic wraps, so adding & subtracting terms works in any order
+	switch (type)
 	{
-		TransactionLog_.addTransaction("Trade executed: Bid " + std::to_string(trade.GetBidTrade().orderdId_) +
-			" matched with Ask " + std::to_string(trade.GetAskTrade().orderdId_) +
-			" for " + std::to_string(trade.GetBidTrade().quantity_) +
-			" @ $" + std::to_string(trade.GetBidTrade().price_));
+		case BookEventType::Add:
+			checksum_ += BookChecksum::Of(order.GetOrderId(), order.GetSide(), order.GetPrice(), remaining);
+			break;
+		case BookEventType::Cancel:
+			checksum_ -= BookChecksum::Of(order.GetOrderId(), order.GetSide(), order.GetPrice(), remaining);
+			break;
+		case BookEventType::Fill:
+			checksum_ -= BookChecksum::Of(order.GetOrderId(), order.GetSide(), order.GetPrice(), remaining + quantity);
+			checksum_ += BookChecksum::Of(order.GetOrderId(), order.GetSide(), order.GetPrice(), remaining);
+			break;
 	}
+}
 
-	return trades;
+void Orderbook::AddListener(BookEventListener* listener)
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+	listeners_.push_back(listener);
+}
+
+void Orderbook::SetPreTradeCheck(PreTradeCheck* check)
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+	preTradeCheck_ = check;
+}
+
+void Orderbook::RemoveListener(BookEventListener* listener)
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+	listeners_.erase(std::remove(listeners_.begin(), listeners_.end(), listener), listeners_.end());
 }
 
-Orderbook::Orderbook() : ordersPruneThread_{ [this] { PruneGoodForDayOrders(); } }
+Orderbook::Orderbook() : Orderbook(OrderbookConfig{ })
+{ }
+
+Orderbook::Orderbook(const OrderbookConfig& config)
+	: arena_{ config.arenaBytes_ == 0 ? nullptr : std::make_unique<MemoryArena>(MemoryArena::Options{
+		config.arenaBytes_, config.hugePages_, ThreadAffinity::NumaNodeOfCore(config.matchingCore_), config.prefault_ }) }
+	// Blocks up to 1MB are pooled: the default limit is a few KB and a deep level's queue (it doubles as it grows)
+	// would otherwise go to the upstream every time it's rebuilt
+	, pool_{ arena_ || config.recycleMemory_
+		? std::make_unique<std::pmr::synchronized_pool_resource>(std::pmr::pool_options{ .largest_required_pool_block = 1 << 20 },
+			arena_ ? arena_.get() : std::pmr::get_default_resource())
+		: nullptr }
+	, memory_{ pool_ ? static_cast<std::pmr::memory_resource*>(pool_.get()) : std::pmr::get_default_resource() }
+	, matchingCore_{ config.matchingCore_ }
+	, logTransactions_{ config.transactionLog_ }
+	, matching_{ config.matching_ }
+	, data_{ memory_ }
+	, bids_{ memory_ }
+	, asks_{ memory_ }
+	, orders_{ memory_ }
+	, shares_{ memory_ }
+	, matched_{ memory_ }
+	, housekeeping_{ config.housekeeping_ }
+	, quotes_{ memory_ }
+	, quoteRisk_{ memory_ }
 {
-	// When an orderbook is created, a new thread is also created.
-	// The purpose of this thread is to wait till the end of day, for every order that is GoodForDay
-	// All the order will be cancel
-	prepopulateOrderBook();
+	// Every GoodForDay order has to be cancelled at the end of the day
+	// With a shared scheduler the book only registers a daily task and no thread is created,
+	// otherwise a thread of its own waits till the end of day
+	if (config.expireGoodForDay_)
+	{
+		if (housekeeping_)
+			expiryTask_ = housekeeping_->ScheduleDaily(Constants::MarketClose, [this] { ExpireGoodForDayOrders(); });
+		else
+			ordersPruneThread_ = std::thread{ [this] { PruneGoodForDayOrders(); } };
+	}
+
+	if (config.prepopulate_)
+		prepopulateOrderBook();
 }
 
 Orderbook::~Orderbook()
 {
-	shutdown_.store(true, std::memory_order_release);
-	shutdownConditionVariable_.notify_one();
-	ordersPruneThread_.join();
+	// Once Cancel returns the scheduler won't touch this book again
+	if (housekeeping_ && expiryTask_.has_value())
+		housekeeping_->Cancel(expiryTask_.value());
+
+	if (ordersPruneThread_.joinable())
+	{
+		{
+			// Taking the lock orders the store against the prune thread's check & wait, so the notify can't be missed
+			std::scoped_lock ordersLock{ ordersMutex_ };
+			shutdown_.store(true, std::memory_order_release);
+		}
+		shutdownConditionVariable_.notify_one();
+		ordersPruneThread_.join();
+	}
 }
 
 Trades Orderbook::AddOrder(OrderPointer order)
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+
+	Trades trades;
+	if (CheckPreTrade(order->GetOrderType(), order->GetOrderId(), order->GetSide(), order->GetPrice(), order->GetInitialQuantity(), order->GetAccount()) != CommandStatus::Accepted)
+		return trades;
+
+	// No reserve: most adds don't trade and sizing it by the book allocated far more than any match fills
+	if (InsertOrder(order) == CommandStatus::Accepted)
+		MatchOrders(order->GetOrderId(), &trades, nullptr);
+
+	return trades;
+}
+
+void Orderbook::AddOrder(OrderPointer order, ExecutionReports& reports)
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+
+	if (CheckPreTrade(order->GetOrderType(), order->GetOrderId(), order->GetSide(), order->GetPrice(), order->GetInitialQuantity(), order->GetAccount()) != CommandStatus::Accepted)
+		return;
+
+	if (InsertOrder(order) == CommandStatus::Accepted)
+		MatchOrders(order->GetOrderId(), nullptr, &reports);
+}
+
+CommandResult Orderbook::AddLimit(const OrderCommand& command) noexcept
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+	return SubmitInternal(OrderType::GoodTillCancel, command.orderId_, command.side_, command.price_, command.quantity_, command.account_);
+}
+
+CommandResult Orderbook::AddMarket(const MarketCommand& command) noexcept
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+	return SubmitInternal(OrderType::Market, command.orderId_, command.side_, Constants::InvalidPrice, command.quantity_, command.account_);
+}
+
+CommandResult Orderbook::AddIOC(const OrderCommand& command) noexcept
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+	return SubmitInternal(OrderType::FillAndKill, command.orderId_, command.side_, command.price_, command.quantity_, command.account_);
+}
+
+CommandResult Orderbook::AddFOK(const OrderCommand& command) noexcept
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+	return SubmitInternal(OrderType::FillOrKill, command.orderId_, command.side_, command.price_, command.quantity_, command.account_);
+}
+
+CommandResult Orderbook::Modify(const OrderCommand& command) noexcept
+{
+	// Cancel & re-add under one lock, nobody can slip in between
+	std::scoped_lock ordersLock{ ordersMutex_ };
+
+	const auto entry = orders_.find(command.orderId_);
+	if (entry == orders_.end())
+		return CommandResult{ CommandStatus::UnknownOrderId };
+
+	const auto& existing = *entry->second.order_;
+	const auto orderType = existing.GetOrderType();
+	const auto account = existing.GetAccount();
+
+	// Checked before the cancel, a modify that is invalid or that the risk turns down leaves the original order where it was
+	if (const auto status = CheckModify(existing, command.side_, command.price_, command.quantity_); status != CommandStatus::Accepted)
+		return CommandResult{ status };
+
+	CancelOrderInternal(command.orderId_);
+	return SubmitInternal(orderType, command.orderId_, command.side_, command.price_, command.quantity_, account, false);
+}
+
+CommandStatus Orderbook::Cancel(OrderId orderId) noexcept
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+	return CancelOrderInternal(orderId) ? CommandStatus::Accepted : CommandStatus::UnknownOrderId;
+}
+
+QuoteResult Orderbook::ReplaceQuotes(AccountId session, std::span<const Quote> bids, std::span<const Quote> asks, LevelUpdates* levels) noexcept
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+
+	// Nothing changes unless the whole set is good, the previous quotes keep resting otherwise
+	// and a session whose first set is turned down doesn't get an entry
+	const auto known = quotes_.find(session);
+	const auto status = CheckQuotes(session, known != quotes_.end() ? std::span<const OrderId>{ known->second } : std::span<const OrderId>{ }, bids, asks);
+	if (status != CommandStatus::Accepted)
+		return QuoteResult{ status };
+	auto& previous = known != quotes_.end() ? known->second : quotes_[session];
+
+	QuoteResult result{ CommandStatus::Accepted };
+	if (levels)
+		levels->clear();
+	quoteLevels_ = levels;
+
+	auto find = [](std::span<const Quote> quotes, OrderId orderId) -> const Quote*
+		{
+			const auto it = std::find_if(quotes.begin(), quotes.end(), [orderId](const Quote& quote) { return quote.orderId_ == orderId; });
+			return it == quotes.end() ? nullptr : &*it;
+		};
+
+	// Out with the old quotes first so the new ones can't trade against them
+	for (const auto orderId : previous)
+	{
+		const auto entry = orders_.find(orderId);
+		if (entry == orders_.end())
+			continue;
+
+		const auto& order = *entry->second.order_;
+		const auto* quote = find(order.GetSide() == Side::Buy ? bids : asks, orderId);
+		if (quote && quote->price_ == order.GetPrice() && quote->quantity_ == order.GetRemainingQuantity())
+		{
+			result.kept_++;
+			continue;
+		}
+
+		CancelOrderInternal(orderId);
+		result.cancelled_++;
+	}
+
+	// Whatever of the set still rests at this point is a kept quote
+	previous.clear();
+	auto add = [&](Side side, std::span<const Quote> quotes)
+		{
+			for (const auto& quote : quotes)
+			{
+				previous.push_back(quote.orderId_);
+				if (orders_.count(quote.orderId_))
+					continue;
+
+				// The risk already passed the set as a whole
+				const auto added = SubmitInternal(OrderType::GoodTillCancel, quote.orderId_, side, quote.price_, quote.quantity_, session, false);
+				if (added.status_ != CommandStatus::Accepted)
+				{
+					result.rejected_++;
+					continue;
+				}
+				result.added_++;
+				result.filled_ += added.filled_;
+			}
+		};
+	add(Side::Buy, bids);
+	add(Side::Sell, asks);
+
+	quoteLevels_ = nullptr;
+	if (levels)
+	{
+		// Both sides can't rest at one price, so the price's level data belongs to the side that has the level
+		for (auto& level : *levels)
+		{
+			const bool resting = level.side_ == Side::Buy ? bids_.count(level.price_) : asks_.count(level.price_);
+			const auto data = data_.find(level.price_);
+			if (resting && data != data_.end())
+			{
+				level.quantity_ = data->second.quantity_;
+				level.orderCount_ = data->second.count_;
+			}
+			level.sequence_ = sequence_;
+		}
+
+		std::sort(levels->begin(), levels->end(), [](const LevelUpdate& left, const LevelUpdate& right)
+			{
+				if (left.side_ != right.side_)
+					return left.side_ == Side::Buy;
+				return left.side_ == Side::Buy ? left.price_ > right.price_ : left.price_ < right.price_;
+			});
+	}
+	return result;
+}
+
+CommandStatus Orderbook::CheckQuotes(AccountId session, std::span<const OrderId> previous, std::span<const Quote> bids, std::span<const Quote> asks) noexcept
+{
+	// Quote sets are a few tens of levels, plain scans beat building a lookup
+	// later: the quotes checked after these, an id may not show up there either
+	auto check = [&](std::span<const Quote> quotes, std::span<const Quote> later)
+		{
+			for (std::size_t i = 0; i < quotes.size(); i++)
+			{
+				const auto& quote = quotes[i];
+				if (const auto status = ValidateOrder(OrderType::GoodTillCancel, quote.price_, quote.quantity_); status != CommandStatus::Accepted)
+					return status;
+
+				// An id appears once in the set, and if it rests already it has to be one of the session's own quotes
+				const auto same = [&quote](const Quote& other) { return other.orderId_ == quote.orderId_; };
+				if (std::any_of(quotes.begin() + i + 1, quotes.end(), same) || std::any_of(later.begin(), later.end(), same))
+					return CommandStatus::DuplicateOrderId;
+				if (orders_.count(quote.orderId_) && std::find(previous.begin(), previous.end(), quote.orderId_) == previous.end())
+					return CommandStatus::DuplicateOrderId;
+			}
+			return CommandStatus::Accepted;
+		};
+
+	if (const auto status = check(bids, asks); status != CommandStatus::Accepted)
+		return status;
+	if (const auto status = check(asks, { }); status != CommandStatus::Accepted)
+		return status;
+
+	if (!bids.empty() && !asks.empty())
+	{
+		const auto bestBid = std::max_element(bids.begin(), bids.end(), [](const Quote& left, const Quote& right) { return left.price_ < right.price_; })->price_;
+		const auto bestAsk = std::min_element(asks.begin(), asks.end(), [](const Quote& left, const Quote& right) { return left.price_ < right.price_; })->price_;
+		if (bestBid >= bestAsk)
+			return CommandStatus::CrossedQuotes;
+	}
+
+	if (!preTradeCheck_)
+		return CommandStatus::Accepted;
+
+	// The risk sees the whole swap at once: the quotes going in and the resting ones they cancel, so the set
+	// is judged by the exposure it leaves. Kept quotes don't move and aren't part of it
+	// Collars are against the book as it stands, the session's own quotes on the other side included
+	auto kept = [&](const Order& order)
+		{
+			const auto quotes = order.GetSide() == Side::Buy ? bids : asks;
+			return std::any_of(quotes.begin(), quotes.end(), [&order](const Quote& quote)
+				{ return quote.orderId_ == order.GetOrderId() && quote.price_ == order.GetPrice() && quote.quantity_ == order.GetRemainingQuantity(); });
+		};
+
+	std::optional<Price> bestBid, bestAsk;
+	if (!bids_.empty())
+		bestBid = bids_.begin()->first;
+	if (!asks_.empty())
+		bestAsk = asks_.begin()->first;
+
+	quoteRisk_.clear();
+	for (const auto orderId : previous)
+	{
+		const auto entry = orders_.find(orderId);
+		if (entry == orders_.end() || kept(*entry->second.order_))
+			continue;
+
+		const auto& order = *entry->second.order_;
+		quoteRisk_.push_back(RiskOrder{ orderId, session, order.GetSide(), OrderType::GoodTillCancel, 0, 0, order.GetRemainingQuantity(), order.GetPrice(), bestBid, bestAsk });
+	}
+
+	auto add = [&](Side side, std::span<const Quote> quotes)
+		{
+			for (const auto& quote : quotes)
+			{
+				const auto entry = orders_.find(quote.orderId_);
+				if (entry == orders_.end() || !kept(*entry->second.order_))
+					quoteRisk_.push_back(RiskOrder{ quote.orderId_, session, side, OrderType::GoodTillCancel, quote.price_, quote.quantity_, 0, 0, bestBid, bestAsk });
+			}
+		};
+	add(Side::Buy, bids);
+	add(Side::Sell, asks);
+
+	return preTradeCheck_->CheckSet(quoteRisk_);
+}
+
+CommandStatus Orderbook::CheckModify(const Order& existing, Side side, Price price, Quantity quantity) noexcept
+{
+	if (const auto status = ValidateOrder(existing.GetOrderType(), price, quantity); status != CommandStatus::Accepted)
+		return status;
+	return CheckPreTrade(existing.GetOrderType(), existing.GetOrderId(), side, price, quantity, existing.GetAccount(), &existing);
+}
+
+CommandStatus Orderbook::ValidateOrder(OrderType orderType, Price price, Quantity quantity) noexcept
+{
+	if (quantity == 0)
+		return CommandStatus::InvalidQuantity;
+	if (orderType != OrderType::Market && price <= 0)
+		return CommandStatus::InvalidPrice;
+	return CommandStatus::Accepted;
+}
+
+CommandResult Orderbook::SubmitInternal(OrderType orderType, OrderId orderId, Side side, Price price, Quantity quantity, AccountId account, bool checkRisk) noexcept
+{
+	if (const auto status = ValidateOrder(orderType, price, quantity); status != CommandStatus::Accepted)
+		return CommandResult{ status };
+
+	if (checkRisk)
+	{
+		const auto risk = CheckPreTrade(orderType, orderId, side, price, quantity, account);
+		if (risk != CommandStatus::Accepted)
+			return CommandResult{ risk };
+	}
+
+	// The order lives in the book's pool, the shared_ptr control block included
+	const auto order = CreateOrder(orderType, orderId, side, price, quantity);
+	order->SetAccount(account);
+	const auto status = InsertOrder(order);
+	if (status != CommandStatus::Accepted)
+		return CommandResult{ status };
+
+	MatchOrders(orderId, nullptr, nullptr);
+
+	const bool resting = !order->IsFilled() && orders_.count(orderId);
+	return CommandResult{ CommandStatus::Accepted, order->GetFilledQuantity(), resting ? order->GetRemainingQuantity() : 0 };
+}
+
+CommandStatus Orderbook::CheckPreTrade(OrderType orderType, OrderId orderId, Side side, Price price, Quantity quantity, AccountId account, const Order* replacing) noexcept
+{
+	if (!preTradeCheck_)
+		return CommandStatus::Accepted;
+
+	RiskOrder order{ orderId, account, side, orderType, price, quantity, 0, 0, std::nullopt, std::nullopt };
+	if (!bids_.empty())
+		order.bestBid_ = bids_.begin()->first;
+	if (!asks_.empty())
+		order.bestAsk_ = asks_.begin()->first;
+
+	// A market order can sweep up to the far end of the other side, that's the price it is risked at
+	// With nothing on the other side the book turns it down anyway
+	if (orderType == OrderType::Market)
+	{
+		if (side == Side::Buy ? asks_.empty() : bids_.empty())
+			return CommandStatus::Accepted;
+		order.price_ = side == Side::Buy ? asks_.rbegin()->first : bids_.rbegin()->first;
+	}
+
+	if (replacing)
+	{
+		order.replacedQuantity_ = replacing->GetRemainingQuantity();
+		order.replacedPrice_ = replacing->GetPrice();
+	}
+
+	return preTradeCheck_->Check(order);
+}
+
+CommandStatus Orderbook::InsertOrder(const OrderPointer& order) noexcept
 {
 	/*
 	This function add order to the orderbook
@@ -346,12 +956,12 @@ Trades Orderbook::AddOrder(OrderPointer order)
 	- Looking to Buy, only valid theres someone selling. If there arent any sell, we just return empty Trade (nothing happen) --> Order is cancelled
 	- If there exists some1 asking to sell, theoretically the worst asks will be executed on
 	- Then pass on to good till cancel order
+	Returns Accepted when the order made it into the book, the reason it didn't otherwise (the caller holds ordersMutex_)
 	*/
-	std::scoped_lock ordersLock{ ordersMutex_ };
 
 	// if contain this orderId already, we have to reject it because each order has an unique orderId
 	if (orders_.count(order->GetOrderId()))
-		return { };
+		return CommandStatus::DuplicateOrderId;
 
 	// Deals with OrderType::Market
 	if (order->GetOrderType() == OrderType::Market)
@@ -363,7 +973,7 @@ Trades Orderbook::AddOrder(OrderPointer order)
 			// your Market order will be filled fully and then remove from the oder book or else
 			// it will fill with what left in the book and then become a limit order
 			const auto& [worstAsk, _] = *asks_.rbegin();
-			order->ToGoodTillCancel(worstAsk);
+			order->TryToGoodTillCancel(worstAsk);
 			// Change the price to the best price which is the lowest people offer because market order
 			// we buying at the cheapest option (Want to buy no matter what according to market rate)
 		}
@@ -372,43 +982,49 @@ Trades Orderbook::AddOrder(OrderPointer order)
 		else if (order->GetSide() == Side::Sell && !bids_.empty())
 		{
 			const auto& [worstBid, _] = *bids_.rbegin();
-			order->ToGoodTillCancel(worstBid);
+			order->TryToGoodTillCancel(worstBid);
 		}
 		else
-			return { };
+			return CommandStatus::NoLiquidity;
 	}
 
 	if (order->GetOrderType() == OrderType::FillAndKill && !CanMatch(order->GetSide(), order->GetPrice()))
-		return { };
+		return CommandStatus::NoLiquidity;
 
 	if (order->GetOrderType() == OrderType::FillOrKill && !CanFullyFill(order->GetSide(), order->GetPrice(), order->GetInitialQuantity()))
 	{
-		TransactionLog_.addTransaction("FillOrKill order " + std::to_string(order->GetOrderId()) + " rejected - cannot be fully filled");
-		return { };
+		if (logTransactions_)
+			TransactionLog_.addTransaction("FillOrKill order " + std::to_string(order->GetOrderId()) + " rejected - cannot be fully filled");
+		return CommandStatus::CannotFullyFill;
 	}
 
-	OrderPointers::iterator iterator; // Pointed to the last order
+	LevelQueue::Position location; // Slot of the order at the back of its level
 
 	if (order->GetSide() == Side::Buy)
-	{
-		auto& orders = bids_[order->GetPrice()];
-		orders.push_back(order);
-		iterator = std::prev(orders.end());
-	}
+		location = bids_[order->GetPrice()].PushBack(order);
 	else
-	{
-		auto& orders = asks_[order->GetPrice()];
-		orders.push_back(order);
-		iterator = std::prev(orders.end());
-	}
+		location = asks_[order->GetPrice()].PushBack(order);
 
-	orders_.insert({ order->GetOrderId(), OrderEntry{ order, iterator } });
-	TransactionLog_.addTransaction("Order " + std::to_string(order->GetOrderId()) + " added");
+	orders_.insert({ order->GetOrderId(), OrderEntry{ order, location } });
+	if (logTransactions_)
+		TransactionLog_.addTransaction("Order " + std::to_string(order->GetOrderId()) + " added");
+	PublishEvent(BookEventType::Add, *order, order->GetInitialQuantity());
 	OnOrderAdded(order);
 
 	// When a new order is added to the orderbook, there's a possibility that it can be immediately matched with existing orders 
-	//on the opposite side. By calling MatchOrders() right after adding the new order, we ensure that any potential trades are executed without delay.
-	return MatchOrders();
+	//on the opposite side. The caller calls MatchOrders() right after adding the new order, so any potential trades are executed without delay.
+	return CommandStatus::Accepted;
+}
+
+OrderPointer Orderbook::CreateOrder(OrderType orderType, OrderId orderId, Side side, Price price, Quantity quantity) const
+{
+	// The control block & the order come from the arena's pool and go back to it when the last reference drops
+	return std::allocate_shared<Order>(std::pmr::polymorphic_allocator<Order>{ memory_ }, orderType, orderId, side, price, quantity);
+}
+
+bool Orderbook::BindMatchingThread() const
+{
+	return ThreadAffinity::PinCurrentThread(matchingCore_);
 }
 
 void Orderbook::CancelOrder(OrderId orderId)
@@ -417,22 +1033,42 @@ void Orderbook::CancelOrder(OrderId orderId)
 	CancelOrderInternal(orderId);
 }
 
-Trades Orderbook::ModifyOrder(OrderModify order)
+OrderPointer Orderbook::ReplaceOrder(const OrderModify& modify)
 {
-	OrderType orderType;
+	const auto entry = orders_.find(modify.GetOrderId());
+	if (entry == orders_.end())
+		return nullptr;
+
+	const auto& existing = *entry->second.order_;
+	if (CheckModify(existing, modify.GetSide(), modify.GetPrice(), modify.GetQuantity()) != CommandStatus::Accepted)
+		return nullptr;
+
+	// Same type & account as the order it replaces, made before the cancel releases the existing one
+	auto order = CreateOrder(existing.GetOrderType(), modify.GetOrderId(), modify.GetSide(), modify.GetPrice(), modify.GetQuantity());
+	order->SetAccount(existing.GetAccount());
+	CancelOrderInternal(modify.GetOrderId());
+	return order;
+}
 
-	{
-		std::scoped_lock ordersLock{ ordersMutex_ };
+Trades Orderbook::ModifyOrder(OrderModify modify)
+{
+	// Cancel & re-add under one lock like Modify, an invalid or risk rejected modify leaves the order as it was
+	std::scoped_lock ordersLock{ ordersMutex_ };
 
-		if (!orders_.count(order.GetOrderId()))
-			return { };
+	Trades trades;
+	const auto order = ReplaceOrder(modify);
+	if (order && InsertOrder(order) == CommandStatus::Accepted)
+		MatchOrders(order->GetOrderId(), &trades, nullptr);
+	return trades;
+}
 
-		const auto& [existingOrder, _] = orders_.at(order.GetOrderId());
-		orderType = existingOrder->GetOrderType();
-	}
+void Orderbook::ModifyOrder(OrderModify modify, ExecutionReports& reports)
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
 
-	CancelOrder(order.GetOrderId());
-	return AddOrder(order.ToOrderPointer(orderType));
+	const auto order = ReplaceOrder(modify);
+	if (order && InsertOrder(order) == CommandStatus::Accepted)
+		MatchOrders(order->GetOrderId(), nullptr, &reports);
 }
 
 std::size_t Orderbook::Size() const
@@ -441,17 +1077,49 @@ std::size_t Orderbook::Size() const
 	return orders_.size();
 }
 
+std::optional<OrderStatus> Orderbook::GetOrderStatus(OrderId orderId) const
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+
+	const auto it = orders_.find(orderId);
+	if (it == orders_.end())
+		return std::nullopt;
+
+	const auto& [order, location] = it->second;
+	const auto ahead = order->GetSide() == Side::Buy
+		? bids_.at(order->GetPrice()).AheadOf(location)
+		: asks_.at(order->GetPrice()).AheadOf(location);
+
+	return OrderStatus{ order->GetOrderId(), order->GetAccount(), order->GetSide(), order->GetOrderType(), order->GetPrice(),
+		order->GetInitialQuantity(), order->GetRemainingQuantity(), order->GetFilledQuantity(), ahead.orders_, ahead.quantity_ };
+}
+
+std::uint64_t Orderbook::Checksum() const
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+	return checksum_;
+}
+
+std::uint64_t Orderbook::RecomputeChecksum() const
+{
+	std::scoped_lock ordersLock{ ordersMutex_ };
+
+	std::uint64_t checksum{ 0 };
+	for (const auto& [_, entry] : orders_)
+		checksum += BookChecksum::Of(entry.order_->GetOrderId(), entry.order_->GetSide(), entry.order_->GetPrice(), entry.order_->GetRemainingQuantity());
+	return checksum;
+}
+
 OrderbookLevelInfos Orderbook::GetOrderInfos() const
 {
 	LevelInfos bidInfos, askInfos;
 	bidInfos.reserve(orders_.size());
 	askInfos.reserve(orders_.size());
 
-	auto CreateLevelInfos = [](Price price, const OrderPointers& orders)
+	// The level queue keeps the remaining quantities in one contiguous array, summing it is a sequential scan
+	auto CreateLevelInfos = [](Price price, const LevelQueue& orders)
 		{
-			return LevelInfo{ price, std::accumulate(orders.begin(), orders.end(), (Quantity)0,
-				[](Quantity runningSum, const OrderPointer& order)
-				{ return runningSum + order->GetRemainingQuantity(); }) };
+			return LevelInfo{ price, orders.TotalQuantity() };
 		};
 
 	for (const auto& [price, orders] : bids_)
@@ -465,61 +1133,21 @@ OrderbookLevelInfos Orderbook::GetOrderInfos() const
 
 void Orderbook::prepopulateOrderBook()
 {
-	// Prepopulate the orderbook with 10 bid & 10 ask
-	for (int i = 0; i < 10; i++)
-	{
-		OrderType OrderType_ = getRandomOrderType();
-		Price Price_ = getRandomPrice(90, 100);
-		Quantity Quantitiy_ = getRandomQuantity(50, 100);
+	// Prepopulate the orderbook with 10 bid & 10 ask of GoodTillCancel & GoodForDay orders resting around 100
+	// A fresh seed every run so the demo book differs each time, the ids come from the shared counter
+	FlowGenerator flow{ FlowOptions{ .seed_ = std::random_device{ }(), .mid_ = 100, .meanDepth_ = 4.0,
+		.medianQuantity_ = 75.0, .quantitySigma_ = 0.2, .goodTillCancel_ = 0.5, .goodForDay_ = 0.5 } };
 
-		OrderPointer order = std::make_shared<Order>(OrderType_, id_cnt++, Side::Buy, Price_, Quantitiy_);
-		AddOrder(order);
-	}
-
-	for (int i = 0; i < 10; i++)
-	{
-		OrderType OrderType_ = getRandomOrderType();
-		Price Price_ = getRandomPrice(100, 110);
-		Quantity Quantitiy_ = getRandomQuantity(50, 100);
-
-		OrderPointer order = std::make_shared<Order>(OrderType_, id_cnt++, Side::Sell, Price_, Quantitiy_);
-		AddOrder(order);
-	}
-}
-
-OrderType Orderbook::getRandomOrderType()
-{
-// Prepoulate the orderbook with GoodTillCancel & GoodForDay order
-
-	static std::random_device rd;
-	static std::mt19937 gen(rd());
-	static std::uniform_int_distribution<> dis(0, 1);
-
-	switch (dis(gen))
+	for (const auto side : { Side::Buy, Side::Sell })
 	{
-		case 0: return OrderType::GoodTillCancel;
-		case 1: return OrderType::GoodForDay;
+		for (int i = 0; i < 10; i++)
+		{
+			const auto resting = flow.NextResting(side);
+			AddOrder(CreateOrder(resting.orderType_, id_cnt++, resting.side_, resting.price_, resting.quantity_));
+		}
 	}
 }
 
-Price Orderbook::getRandomPrice(int min, int max)
-{
-	static std::random_device rd;
-	static std::mt19937 gen(rd());
-	std::uniform_int_distribution<> dis(min, max);
-
-	return static_cast<Price>(dis(gen));
-}
-
-Quantity Orderbook::getRandomQuantity(int min, int max)
-{
-	static std::random_device rd;
-	static std::mt19937 gen(rd());
-	std::uniform_int_distribution<> dis(min, max);
-
-	return static_cast<Quantity>(dis(gen));
-}
-
 void Orderbook::printVisual() const 
 {
 	using namespace std::chrono;
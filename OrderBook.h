@@ -6,11 +6,24 @@
 #include <condition_variable>
 #include <mutex>
 #include <atomic>
+#include <optional>
+#include <memory_resource>
+#include <span>
 
 #include "Usings.h"
+#include "BookChecksum.h"
+#include "BookEvent.h"
+#include "ExecutionReport.h"
+#include "HousekeepingScheduler.h"
 #include "Order.h"
+#include "OrderCommand.h"
+#include "LevelQueue.h"
+#include "MemoryArena.h"
 #include "OrderModify.h"
+#include "OrderbookConfig.h"
 #include "OrderbookLevelInfos.h"
+#include "OrderStatus.h"
+#include "PreTradeRisk.h"
 #include "Trade.h"
 #include "TransactionLog.h"
 
@@ -29,7 +42,7 @@ private:
     struct OrderEntry
     {
         OrderPointer order_{ nullptr };
-        OrderPointers::iterator location_; // An iterator to the list of OrderPointer
+        LevelQueue::Position location_; // Slot of the order in its price level queue
     };
 
     // Store the data of a level (Price level)
@@ -46,10 +59,23 @@ private:
         };
     };
 
-    std::unordered_map<Price, LevelData> data_;
-    std::map<Price, OrderPointers, std::greater<Price>> bids_; // Descending Order. Key : Price, Value: OrderPointers (List of orderpointer of type "Order")
-    std::map<Price, OrderPointers, std::less<Price>> asks_; // Ascending Order
-    std::unordered_map<OrderId, OrderEntry> orders_; //Key: OrderId, Value: Content of the order
+    // Where orders, levels and the id index live: an optional (huge page) arena with a pool on top recycling its memory
+    // Declared before the containers because they are built on it
+    std::unique_ptr<MemoryArena> arena_;
+    std::unique_ptr<std::pmr::synchronized_pool_resource> pool_;
+    std::pmr::memory_resource* memory_;
+    int matchingCore_{ -1 };
+    bool logTransactions_{ true };
+    MatchingPolicy matching_;
+
+    std::pmr::unordered_map<Price, LevelData> data_;
+    std::pmr::map<Price, LevelQueue, std::greater<Price>> bids_; // Descending Order. Key : Price, Value: LevelQueue (FIFO ring buffer of orderpointer of type "Order")
+    std::pmr::map<Price, LevelQueue, std::less<Price>> asks_; // Ascending Order
+    std::pmr::unordered_map<OrderId, OrderEntry> orders_; //Key: OrderId, Value: Content of the order
+
+    // Scratch of the pro-rata allocation: the share of every slot of the level & the orders it filled
+    std::pmr::vector<Quantity> shares_;
+    std::pmr::vector<OrderId> matched_;
 
     // Use for GoodForDay
     mutable std::mutex ordersMutex_;
@@ -57,25 +83,58 @@ private:
     std::condition_variable shutdownConditionVariable_;
     std::atomic<bool> shutdown_{ false };
 
+    // GoodForDay expiry either runs on the book's own thread or as a task of a shared scheduler
+    HousekeepingScheduler* housekeeping_{ nullptr };
+    std::optional<HousekeepingScheduler::TaskId> expiryTask_;
+
     void PruneGoodForDayOrders();
+    void ExpireGoodForDayOrders();
 
     void CancelOrders(OrderIds);
-    void CancelOrderInternal(OrderId);
+    bool CancelOrderInternal(OrderId) noexcept;
 
     // Methods relevant for FillOrKill order
-    void OnOrderCancelled(OrderPointer);
-    void OnOrderAdded(OrderPointer);
-    void OnOrderMatched(Price, Quantity, bool);
-    void UpdateLevelData(Price, Quantity, LevelData::Action);
-
-    bool CanFullyFill(Side, Price, Quantity) const;
-    bool CanMatch(Side, Price) const;
-    Trades MatchOrders();
+    void OnOrderCancelled(const OrderPointer&) noexcept;
+    void OnOrderAdded(const OrderPointer&) noexcept;
+    void OnOrderMatched(Price, Quantity, bool) noexcept;
+    void UpdateLevelData(Price, Quantity, LevelData::Action) noexcept;
+
+    // The matching path is noexcept end to end: the only failures left are out of memory
+    // and a listener throwing, both leave a half matched book behind so they terminate
+    bool CanFullyFill(Side, Price, Quantity) const noexcept;
+    bool CanMatch(Side, Price) const noexcept;
+    CommandStatus InsertOrder(const OrderPointer&) noexcept;
+    void MatchOrders(OrderId, Trades*, ExecutionReports*) noexcept;
+    static CommandStatus ValidateOrder(OrderType, Price, Quantity) noexcept; // Quantity & price, before anything is touched
+    CommandResult SubmitInternal(OrderType, OrderId, Side, Price, Quantity, AccountId, bool checkRisk = true) noexcept;
+    CommandStatus CheckPreTrade(OrderType, OrderId, Side, Price, Quantity, AccountId, const Order* replacing = nullptr) noexcept;
+
+    // A modify keeps the order's type & account and is checked with the order it replaces netted out, before the cancel
+    CommandStatus CheckModify(const Order& existing, Side, Price, Quantity) noexcept;
+    OrderPointer ReplaceOrder(const OrderModify&); // nullptr when unknown or rejected, the existing order is cancelled otherwise
+
+    // Binary event stream of every change to the book, the sequence numbers every change even with no listener
+    std::vector<BookEventListener*> listeners_;
+    std::uint64_t sequence_{ 0 };
+    std::uint64_t checksum_{ 0 }; // Rolling BookChecksum, every event swaps the order's old term for its new one
+
+    void PublishEvent(BookEventType, const Order&, Quantity, const Order* contra = nullptr) noexcept;
+
+    // Runs before any order enters the book and follows every change to it
+    PreTradeCheck* preTradeCheck_{ nullptr };
+
+    // Ids of each session's last quote set, some may have traded or been cancelled since
+    std::pmr::unordered_map<AccountId, std::pmr::vector<OrderId>> quotes_;
+    LevelUpdates* quoteLevels_{ nullptr }; // Levels touched by the ReplaceQuotes in progress, filled by PublishEvent
+    std::pmr::vector<RiskOrder> quoteRisk_; // The set as the pre-trade risk sees it, kept to reuse its memory
+    CommandStatus CheckQuotes(AccountId, std::span<const OrderId>, std::span<const Quote>, std::span<const Quote>) noexcept;
+    void UpdateChecksum(BookEventType, const Order&, Quantity) noexcept;
 
     TransactionLog TransactionLog_;
 public:
 
     Orderbook();
+    explicit Orderbook(const OrderbookConfig&);
     ~Orderbook();
 
     // Preventing copis and moves to ensure that only one instance of the Orderbookclass exists, making it a singleton
@@ -88,14 +147,53 @@ public:
     void CancelOrder(OrderId);
     Trades ModifyOrder(OrderModify);
 
+    // Aggregated reporting: one ExecutionReport per price level the order traded at instead of a Trade per fill
+    void AddOrder(OrderPointer, ExecutionReports&);
+    void ModifyOrder(OrderModify, ExecutionReports&);
+
+    // Allocation free entry API: value commands in, status codes out, fills go out as BookEvents
+    // AddIOC is a FillAndKill order, AddFOK a FillOrKill one. Modify keeps the order's type and loses its time priority
+    CommandResult AddLimit(const OrderCommand&) noexcept;
+    CommandResult AddMarket(const MarketCommand&) noexcept;
+    CommandResult AddIOC(const OrderCommand&) noexcept;
+    CommandResult AddFOK(const OrderCommand&) noexcept;
+    CommandResult Modify(const OrderCommand&) noexcept;
+    CommandStatus Cancel(OrderId) noexcept;
+
+    // Swaps a market maker's whole quote set (one per session, the session is the quotes' account) in one go
+    // Quotes whose id, side, price & remaining quantity didn't change keep resting with their time priority,
+    // the others are cancelled and the new ones added, all under one lock so nobody sees the set half replaced
+    // An invalid set, or one the pre-trade risk turns down for the exposure it would leave, is turned down as a whole
+    // before anything is cancelled. levels (when given) gets the resulting state of every level that moved
+    QuoteResult ReplaceQuotes(AccountId session, std::span<const Quote> bids, std::span<const Quote> asks, LevelUpdates* levels = nullptr) noexcept;
+
+    // Orders allocated from the book's arena (plain make_shared when it has none), they must not outlive the book
+    OrderPointer CreateOrder(OrderType, OrderId, Side, Price, Quantity) const;
+
+    // Pin the calling thread to OrderbookConfig::matchingCore_, returns false when not configured or not supported
+    bool BindMatchingThread() const;
+    const MemoryArena* GetArena() const { return arena_.get(); }
+
+    void AddListener(BookEventListener*);
+    void RemoveListener(BookEventListener*);
+
+    // Pre-trade risk for every new & modified order (nullptr turns it off), attach it before the first order
+    // so its exposure covers everything resting
+    void SetPreTradeCheck(PreTradeCheck*);
+
     std::size_t Size() const;
+
+    // Quantities & queue position of a resting order, nullopt once it's gone (filled, cancelled or never there)
+    // Read from the level's running sums, the cost doesn't grow with the number of orders ahead
+    std::optional<OrderStatus> GetOrderStatus(OrderId) const;
+
+    // Order independent checksum of the resting book, kept up to date on every change (see BookChecksum)
+    // RecomputeChecksum walks every order to get the same value, it's there to verify the rolling one
+    std::uint64_t Checksum() const;
+    std::uint64_t RecomputeChecksum() const;
     OrderbookLevelInfos GetOrderInfos() const;
 
     void prepopulateOrderBook();
-
-    OrderType getRandomOrderType();
-    Price getRandomPrice(int, int);
-    Quantity getRandomQuantity(int, int);
     void printVisual() const;
     std::string getTransactionLog() const;
 
@@ -1,281 +1,1679 @@
 #include "pch.h"
 #include "../OrderBook/OrderBook.cpp"
+#include "../OrderBook/Scenario.h"
+#include "../OrderBook/BinaryEventStream.h"
+#include "../OrderBook/PerfCounters.h"
+#include "../OrderBook/FlowGenerator.h"
+#include "../OrderBook/MarketDataFanout.h"
+#include "../OrderBook/BookAnalytics.h"
+#include "../OrderBook/EventJournal.h"
+#include "../OrderBook/DurableJournal.h"
+#include "../OrderBook/SharedMemoryEntry.h"
+#include "../OrderBook/EnginePipeline.h"
+#include "../OrderBook/Replication.h"
+#include "../OrderBook/ColumnarExport.h"
+#include "../OrderBook/DepthKernels.h"
+#include "../OrderBook/AsyncOrderbook.h"
+#include "../OrderBook/RecordedFeed.h"
+#include "../OrderBook/AllocationTracker.cpp"
+#include "../OrderBook/ScenarioRunner.cpp"
+#include "../OrderBook/ThreadPool.h"
+#if defined(__linux__)
+    #include <csignal>
+    #include <sys/wait.h>
+#endif
 OrderId Orderbook::id_cnt = 0;
 
 namespace googletest = ::testing;
 
-struct Information
+// Defines a test fixture class for Google Test parameterized tests
+// This test fixtured is paramterized & the type is const char* (string)
+class OrderbookTestsFixture : public googletest::TestWithParam<const char*>
 {
-    ActionType type_;
-    OrderType orderType_;
-    Side side_;
-    Price price_;
-    Quantity quantity_;
-    OrderId orderId_;
+private:
+    const static inline std::filesystem::path Root{ std::filesystem::current_path() };
+    const static inline std::filesystem::path TestFolder{ "TestFolder" };
+public:
+    const static inline std::filesystem::path TestFolderPath{ Root / TestFolder };
 };
 
-using Informations = std::vector<Information>;
+// Empty & deterministic: no prepopulation, no expiry thread and no transaction log
+OrderbookConfig TestConfig()
+{
+    return OrderbookConfig{ .prepopulate_ = false, .expireGoodForDay_ = false, .transactionLog_ = false };
+}
 
-struct Result
+// A generated or scenario action through the order API (AddOrder / ModifyOrder / CancelOrder)
+Trades ApplyAction(Orderbook& orderbook, const Information& action)
 {
-    std::size_t allCount_;
-    std::size_t bidCount_;
-    std::size_t askCount_;
-};
+    switch (action.type_)
+    {
+        case ActionType::Cancel:
+            orderbook.CancelOrder(action.orderId_);
+            return { };
+        case ActionType::Modify:
+            return orderbook.ModifyOrder(OrderModify{ action.orderId_, action.side_, action.price_, action.quantity_ });
+        default:
+            return orderbook.AddOrder(std::make_shared<Order>(action.orderType_, action.orderId_, action.side_, action.price_, action.quantity_));
+    }
+}
 
-using Results = std::vector<Result>;
+// The same action as a request of the shared memory / pipeline / replication entry
+EntryRequest ToEntryRequest(const Information& action, std::uint64_t sequence, AccountId account = 0)
+{
+    auto type = EntryRequestType::Limit;
+    if (action.type_ == ActionType::Cancel)
+        type = EntryRequestType::Cancel;
+    else if (action.type_ == ActionType::Modify)
+        type = EntryRequestType::Modify;
+    else if (action.orderType_ == OrderType::Market)
+        type = EntryRequestType::Market;
+    else if (action.orderType_ == OrderType::FillAndKill)
+        type = EntryRequestType::ImmediateOrCancel;
+    else if (action.orderType_ == OrderType::FillOrKill)
+        type = EntryRequestType::FillOrKill;
+    return EntryRequest{ sequence, action.orderId_, action.price_, action.quantity_, action.side_, type, account };
+}
 
-struct InputHandler
+// This function is use to define parameterized test. Allow to execute same test logic with diff parameters
+TEST_P(OrderbookTestsFixture, OrderbookTestSuite)
 {
-private:
-    std::uint32_t ToNumber(const std::string_view& str) const
+    // Arrange
+    const auto file = OrderbookTestsFixture::TestFolderPath / GetParam();
+
+    InputHandler handler;
+    const auto [actions, result] = handler.GetInformations(file);
+
+    auto GetOrder = [](const Information& action)
+        {
+            return std::make_shared<Order>(
+                action.orderType_,
+                action.orderId_,
+                action.side_,
+                action.price_,
+                action.quantity_);
+        };
+
+    auto GetOrderModify = [](const Information& action)
+        {
+            return OrderModify
+            {
+                action.orderId_,
+                action.side_,
+                action.price_,
+                action.quantity_,
+            };
+        };
+
+    // Act
+    Orderbook orderbook{ TestConfig() };
+    for (const auto& action : actions)
+    {
+        switch (action.type_)
+        {
+            case ActionType::Add:
+            {
+                const Trades& trades = orderbook.AddOrder(GetOrder(action));
+            }
+            break;
+            case ActionType::Modify:
+            {
+                const Trades& trades = orderbook.ModifyOrder(GetOrderModify(action));
+            }
+            break;
+            case ActionType::Cancel:
+            {
+                orderbook.CancelOrder(action.orderId_);
+            }
+            break;
+            default:
+                throw std::logic_error("Unsupported Action.");
+        }
+    }
+
+    // Assert
+    const auto& orderbookInfos = orderbook.GetOrderInfos();
+    ASSERT_EQ(orderbook.Size(), result.allCount_);
+    ASSERT_EQ(orderbookInfos.GetBids().size(), result.bidCount_);
+    ASSERT_EQ(orderbookInfos.GetAsks().size(), result.askCount_);
+}
+
+// Argument: TestName, Test Fixture, Paramter
+INSTANTIATE_TEST_CASE_P(Tests, OrderbookTestsFixture, googletest::ValuesIn({
+    "Match_GoodTillCancel.txt",
+    "Match_FillAndKill.txt",
+    "Match_FillOrKill_Hit.txt",
+    "Match_FillOrKill_Miss.txt",
+    "Cancel_Success.txt",
+    "Modify_Side.txt",
+    "Match_Market.txt"
+    }));
+
+// The same directory replayed on one thread and on several reports the same files & the same checksum
+TEST(ScenarioRunnerTests, ParallelReplayMatchesSingleThreaded)
+{
+    const auto directory = std::filesystem::temp_directory_path() / "ScenarioRunnerTests";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    for (const auto* name : { "Match_GoodTillCancel.txt", "Match_FillAndKill.txt", "Modify_Side.txt", "Match_Market.txt" })
+        std::filesystem::copy_file(OrderbookTestsFixture::TestFolderPath / name, directory / name);
+    for (std::uint64_t seed = 1; seed <= 4; seed++)
+    {
+        std::ofstream file{ directory / ("Flow_" + std::to_string(seed) + ".txt") };
+        FlowGenerator{ FlowOptions{ .seed_ = seed } }.WriteScenario(file, 5'000);
+    }
+    {
+        // One resting bid, not the two the R line expects. The R line has to end the file
+        std::ofstream file{ directory / "Wrong_Result.txt" };
+        file << "A B GoodTillCancel 100 10 1\nR 2 1 0";
+    }
+
+    const auto single = ScenarioRunner{ 1 }.Run(directory);
+    const auto parallel = ScenarioRunner{ 4 }.Run(directory);
+    std::filesystem::remove_all(directory);
+
+    ASSERT_EQ(single.reports_.size(), 9);
+    ASSERT_EQ(single.passed_, 8);
+    ASSERT_EQ(single.failed_, 1);
+    ASSERT_GT(single.trades_, 0);
+
+    ASSERT_EQ(parallel.reports_.size(), single.reports_.size());
+    for (std::size_t i = 0; i < single.reports_.size(); i++)
+    {
+        const auto& report = single.reports_[i];
+        ASSERT_EQ(report.passed_, report.file_.filename() != "Wrong_Result.txt") << report.file_;
+        ASSERT_TRUE(report.error_.empty()) << report.file_;
+        ASSERT_EQ(parallel.reports_[i].file_, report.file_);
+        ASSERT_EQ(parallel.reports_[i].passed_, report.passed_);
+        ASSERT_EQ(parallel.reports_[i].checksum_, report.checksum_) << report.file_;
+    }
+    ASSERT_EQ(parallel.passed_, single.passed_);
+    ASSERT_EQ(parallel.trades_, single.trades_);
+    ASSERT_EQ(parallel.checksum_, single.checksum_);
+}
+
+// Tasks that submit more tasks from inside the pool are covered by the same Wait
+TEST(ThreadPoolTests, WaitCoversSubtasks)
+{
+    ThreadPool pool{ 4 };
+    std::atomic<std::size_t> leaves{ 0 };
+
+    // Every task below the last depth spawns two more: 2^depth leaves in the end
+    std::function<void(int)> spawn = [&](int depth)
+        {
+            if (depth == 0)
+            {
+                leaves.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            pool.Submit([&spawn, depth] { spawn(depth - 1); });
+            pool.Submit([&spawn, depth] { spawn(depth - 1); });
+        };
+
+    for (int round = 0; round < 3; round++)
+    {
+        leaves = 0;
+        pool.Submit([&spawn] { spawn(10); });
+        pool.Wait();
+        ASSERT_EQ(leaves.load(), 1024);
+    }
+}
+
+// Books registered with a shared scheduler don't own a thread, the scheduler expires all of them at once
+TEST(HousekeepingSchedulerTests, ExpiresGoodForDayOrdersOfEveryRegisteredBook)
+{
+    HousekeepingScheduler scheduler{ 2, 16 };
+    std::vector<std::unique_ptr<Orderbook>> orderbooks;
+    for (int i = 0; i < 100; i++)
+    {
+        orderbooks.push_back(std::make_unique<Orderbook>(OrderbookConfig{ .prepopulate_ = false, .housekeeping_ = &scheduler }));
+        orderbooks.back()->AddOrder(std::make_shared<Order>(OrderType::GoodForDay, 1, Side::Buy, 100, 10));
+        orderbooks.back()->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 2, Side::Buy, 99, 10));
+    }
+    ASSERT_EQ(scheduler.Size(), 100);
+
+    scheduler.RunNow();
+
+    for (const auto& orderbook : orderbooks)
+        ASSERT_EQ(orderbook->Size(), 1);
+
+    orderbooks.clear();
+    ASSERT_EQ(scheduler.Size(), 0);
+}
+
+// Cancels inside a deep level leave tombstones & trigger compactions, the survivors must keep their time priority
+TEST(LevelQueueTests, CancelsKeepTimePriorityThroughCompaction)
+{
+    Orderbook orderbook{ TestConfig() };
+    for (OrderId orderId = 1; orderId <= 200; orderId++)
+        orderbook.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, orderId, Side::Buy, 100, 1));
+
+    for (OrderId orderId = 2; orderId <= 200; orderId++)
     {
-        std::int64_t value{};
-        std::from_chars(str.data(), str.data() + str.size(), value);
-        if (value < 0)
-            throw std::logic_error("Value is below zero.");
-        return static_cast<std::uint32_t>(value);
+        if (orderId % 5 != 0)
+            orderbook.CancelOrder(orderId);
     }
+    ASSERT_EQ(orderbook.Size(), 41);
+    ASSERT_EQ(orderbook.GetOrderInfos().GetBids().at(0).quantity_, 41);
+
+    const auto trades = orderbook.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 1000, Side::Sell, 100, 41));
+    ASSERT_EQ(trades.size(), 41);
+    ASSERT_EQ(trades.front().GetBidTrade().orderdId_, 1);
+    for (std::size_t i = 1; i < trades.size(); i++)
+        ASSERT_EQ(trades[i].GetBidTrade().orderdId_, i * 5);
+    ASSERT_EQ(orderbook.Size(), 0);
+}
+
+// A sweep through 500 small resting orders over 2 levels reports 2 executions, the fills stay in the event stream
+TEST(ExecutionReportTests, AggregatesSweepPerPriceLevel)
+{
+    Orderbook orderbook{ TestConfig() };
+    std::stringstream stream;
+    BinaryEventStream events{ stream };
+    orderbook.AddListener(&events);
+
+    for (OrderId orderId = 1; orderId <= 500; orderId++)
+        orderbook.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, orderId, Side::Sell, orderId <= 300 ? 100 : 101, 2));
+
+    ExecutionReports reports;
+    orderbook.AddOrder(std::make_shared<Order>(OrderType::FillAndKill, 1000, Side::Buy, 101, 1000), reports);
+
+    ASSERT_EQ(reports.size(), 2);
+    ASSERT_EQ(reports[0].price_, 100);
+    ASSERT_EQ(reports[0].quantity_, 600);
+    ASSERT_EQ(reports[0].contraCount_, 300);
+    ASSERT_EQ(reports[1].price_, 101);
+    ASSERT_EQ(reports[1].quantity_, 400);
+    ASSERT_EQ(reports[1].contraCount_, 200);
+    ASSERT_DOUBLE_EQ(reports[1].vwap_, (100.0 * 600 + 101.0 * 400) / 1000);
+    ASSERT_EQ(orderbook.Size(), 0);
+
+    orderbook.RemoveListener(&events);
+    const auto recorded = BinaryEventStream::ReadAll(stream);
+    ASSERT_EQ(recorded.size(), 501 + 500 * 2);
+    ASSERT_EQ(std::count_if(recorded.begin(), recorded.end(), [](const BookEvent& event) { return event.type_ == BookEventType::Fill; }), 1000);
+    for (std::size_t i = 0; i < recorded.size(); i++)
+        ASSERT_EQ(recorded[i].sequence_, i + 1);
+}
+
+// The arena falls back to normal pages when no huge pages are reserved, the book must work the same either way
+TEST(MemoryArenaTests, BookStorageComesFromTheArena)
+{
+    auto config = TestConfig();
+    config.arenaBytes_ = 8 * 1024 * 1024;
+    Orderbook orderbook{ config };
+    ASSERT_NE(orderbook.GetArena(), nullptr);
+    ASSERT_GE(orderbook.GetArena()->Capacity(), 8 * 1024 * 1024);
+
+    for (OrderId orderId = 1; orderId <= 1000; orderId++)
+        orderbook.AddOrder(orderbook.CreateOrder(OrderType::GoodTillCancel, orderId, orderId % 2 ? Side::Buy : Side::Sell, orderId % 2 ? 99 : 101, 10));
+    orderbook.AddOrder(orderbook.CreateOrder(OrderType::FillAndKill, 5000, Side::Buy, 101, 100));
+
+    ASSERT_EQ(orderbook.Size(), 990);
+    ASSERT_GT(orderbook.GetArena()->Used(), 0);
+    ASSERT_EQ(orderbook.GetArena()->Overflow(), 0);
+}
 
-    bool TryParseResult(const std::string_view& str, Result& result) const
+// Without counter access (containers, VMs, non Linux) profiling still has to time and count every operation
+TEST(PerfCountersTests, ProfileMergesPerOperation)
+{
+    PerfCounters counters;
+    PerfProfile first{ { "add", "cancel" }, counters.Supported() };
+    PerfProfile second{ { "cancel" }, counters.Supported() };
+
+    volatile std::uint64_t sink = 0;
+    for (int i = 0; i < 3; i++)
+        counters.Measure(first.At(0), [&] { sink = sink + i; });
+    counters.Measure(second.At(0), [&] { sink = sink + 1; });
+
+    PerfProfile merged;
+    merged.Merge(first);
+    merged.Merge(second);
+
+    ASSERT_EQ(merged.At(0).count_, 3);
+    ASSERT_EQ(merged.At(1).count_, 1);
+    ASSERT_EQ(merged.CountersAvailable(), counters.Available());
+}
+
+// Same seed, same flow, and what gets written to a scenario file parses back to the same messages
+TEST(FlowGeneratorTests, SeededFlowRoundTripsThroughScenarioFile)
+{
+    const FlowOptions options{ .seed_ = 7 };
+    FlowGenerator first{ options }, second{ options };
+
+    Informations messages;
+    first.Generate(10'000, [&messages](const FlowMessage& message) { messages.push_back(message.action_); });
+
+    const auto path = std::filesystem::temp_directory_path() / "FlowGeneratorTests.txt";
     {
-        if (str.at(0) != 'R')
-            return false;
+        std::ofstream file{ path };
+        second.WriteScenario(file, 10'000);
+    }
+    const auto [parsed, result] = InputHandler{ }.GetRecording(path);
+    std::filesystem::remove(path);
 
-        auto values = Split(str, ' ');
-        result.allCount_ = ToNumber(values[1]);
-        result.bidCount_ = ToNumber(values[2]);
-        result.askCount_ = ToNumber(values[3]);
+    ASSERT_FALSE(result.has_value());
+    ASSERT_EQ(parsed.size(), messages.size());
+    for (std::size_t i = 0; i < messages.size(); i++)
+    {
+        ASSERT_EQ(parsed[i].type_, messages[i].type_);
+        ASSERT_EQ(parsed[i].orderId_, messages[i].orderId_);
+        if (messages[i].type_ == ActionType::Cancel)
+            continue;
+        ASSERT_EQ(parsed[i].side_, messages[i].side_);
+        ASSERT_EQ(parsed[i].price_, messages[i].price_);
+        ASSERT_EQ(parsed[i].quantity_, messages[i].quantity_);
+        if (messages[i].type_ == ActionType::Add)
+        {
+            ASSERT_EQ(parsed[i].orderType_, messages[i].orderType_);
+        }
+    }
+    ASSERT_EQ(first.Time(), second.Time());
+}
 
-        return true;
+// The same resting orders give the same checksum whatever order they came in, and the rolling value matches a full recompute
+TEST(BookChecksumTests, RollingChecksumIsOrderIndependent)
+{
+    Orderbook first{ TestConfig() };
+    Orderbook second{ TestConfig() };
+    ASSERT_EQ(first.Checksum(), 0);
+
+    first.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 1, Side::Buy, 99, 10));
+    first.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 2, Side::Sell, 101, 10));
+    first.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 3, Side::Buy, 98, 10));
+
+    second.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 3, Side::Buy, 98, 10));
+    second.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 2, Side::Sell, 101, 10));
+    second.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 1, Side::Buy, 99, 10));
+    ASSERT_EQ(first.Checksum(), second.Checksum());
+
+    // A partial fill, a modify and a cancel all move it, and it keeps agreeing with the full walk
+    const auto before = first.Checksum();
+    first.AddOrder(std::make_shared<Order>(OrderType::FillAndKill, 4, Side::Sell, 99, 4));
+    ASSERT_NE(first.Checksum(), before);
+    ASSERT_EQ(first.Checksum(), first.RecomputeChecksum());
+
+    first.ModifyOrder(OrderModify{ 3, Side::Buy, 97, 5 });
+    first.CancelOrder(2);
+    ASSERT_EQ(first.Checksum(), first.RecomputeChecksum());
+
+    first.CancelOrder(1);
+    first.CancelOrder(3);
+    ASSERT_EQ(first.Checksum(), 0);
+}
+
+// A subscriber that doesn't read only ever holds the latest state of each level, a reader keeping up sees every change
+TEST(MarketDataFanoutTests, SlowSubscriberGetsConflatedLevels)
+{
+    Orderbook orderbook{ TestConfig() };
+    MarketDataFanout fanout;
+    orderbook.AddListener(&fanout);
+
+    auto slow = fanout.Subscribe();
+    auto fast = fanout.Subscribe();
+    ConflatedUpdate update;
+
+    std::size_t fastUpdates = 0;
+    for (OrderId orderId = 1; orderId <= 1000; orderId++)
+    {
+        orderbook.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, orderId, Side::Buy, 99 - static_cast<Price>(orderId % 3), 10));
+        while (fast->Poll(update))
+            fastUpdates++;
     }
+    orderbook.AddOrder(std::make_shared<Order>(OrderType::FillAndKill, 2000, Side::Sell, 99, 15));
 
-    bool TryParseInformation(const std::string_view& str, Information& action) const
+    // 1000 adds over 3 bid levels then a fill: only those 3 levels and the aggressor's (now empty) ask level wait in the slow buffer
+    ASSERT_EQ(fastUpdates, 1000);
+    ASSERT_EQ(slow->Pending(), 4);
+    ASSERT_TRUE(slow->Poll(update));
+    ASSERT_EQ(update.levels_.size(), 4);
+    ASSERT_EQ(update.levels_.back().side_, Side::Sell);
+    ASSERT_EQ(update.levels_.back().quantity_, 0);
+    ASSERT_EQ(update.checksum_, orderbook.Checksum());
+
+    const auto infos = orderbook.GetOrderInfos();
+    for (std::size_t i = 0; i < infos.GetBids().size(); i++)
     {
-        auto value = str.at(0);
-        auto values = Split(str, ' ');
-        if (value == 'A')
+        ASSERT_EQ(update.levels_[i].price_, infos.GetBids()[i].price_);
+        ASSERT_EQ(update.levels_[i].quantity_, infos.GetBids()[i].quantity_);
+    }
+    ASSERT_FALSE(slow->Poll(update));
+
+    // A late subscriber starts from the current depth
+    auto late = fanout.Subscribe();
+    ASSERT_TRUE(late->Poll(update));
+    ASSERT_EQ(update.levels_.size(), 3);
+
+    orderbook.RemoveListener(&fanout);
+}
+
+// Every rejection comes back as a status code, fills are reported in the result
+TEST(CommandApiTests, StatusCodesInsteadOfExceptions)
+{
+    Orderbook orderbook{ TestConfig() };
+
+    ASSERT_EQ(orderbook.AddMarket(MarketCommand{ 1, Side::Buy, 10 }).status_, CommandStatus::NoLiquidity);
+    ASSERT_EQ(orderbook.AddIOC(OrderCommand{ 2, Side::Buy, 100, 10 }).status_, CommandStatus::NoLiquidity);
+    ASSERT_EQ(orderbook.AddLimit(OrderCommand{ 3, Side::Sell, 0, 10 }).status_, CommandStatus::InvalidPrice);
+    ASSERT_EQ(orderbook.AddLimit(OrderCommand{ 3, Side::Sell, 100, 0 }).status_, CommandStatus::InvalidQuantity);
+
+    ASSERT_EQ(orderbook.AddLimit(OrderCommand{ 3, Side::Sell, 100, 10 }).resting_, 10);
+    ASSERT_EQ(orderbook.AddLimit(OrderCommand{ 3, Side::Sell, 101, 10 }).status_, CommandStatus::DuplicateOrderId);
+    ASSERT_EQ(orderbook.AddFOK(OrderCommand{ 4, Side::Buy, 100, 11 }).status_, CommandStatus::CannotFullyFill);
+
+    const auto ioc = orderbook.AddIOC(OrderCommand{ 5, Side::Buy, 100, 15 });
+    ASSERT_EQ(ioc.status_, CommandStatus::Accepted);
+    ASSERT_EQ(ioc.filled_, 10);
+    ASSERT_EQ(ioc.resting_, 0);
+    ASSERT_EQ(orderbook.Size(), 0);
+
+    ASSERT_EQ(orderbook.AddLimit(OrderCommand{ 6, Side::Buy, 99, 10 }).status_, CommandStatus::Accepted);
+    ASSERT_EQ(orderbook.Modify(OrderCommand{ 6, Side::Buy, 98, 5 }).resting_, 5);
+    ASSERT_EQ(orderbook.Modify(OrderCommand{ 7, Side::Buy, 98, 5 }).status_, CommandStatus::UnknownOrderId);
+
+    // An invalid modify is turned down before the cancel, the order keeps resting as it was with its place in the queue
+    ASSERT_EQ(orderbook.AddLimit(OrderCommand{ 8, Side::Buy, 98, 7 }).status_, CommandStatus::Accepted);
+    ASSERT_EQ(orderbook.Modify(OrderCommand{ 6, Side::Buy, 98, 0 }).status_, CommandStatus::InvalidQuantity);
+    ASSERT_EQ(orderbook.Modify(OrderCommand{ 6, Side::Buy, 0, 5 }).status_, CommandStatus::InvalidPrice);
+    ASSERT_EQ(orderbook.Modify(OrderCommand{ 6, Side::Buy, -1, 5 }).status_, CommandStatus::InvalidPrice);
+    ASSERT_EQ(orderbook.Size(), 2);
+    const auto status = orderbook.GetOrderStatus(6);
+    ASSERT_TRUE(status.has_value());
+    ASSERT_EQ(status->side_, Side::Buy);
+    ASSERT_EQ(status->price_, 98);
+    ASSERT_EQ(status->remainingQuantity_, 5);
+    ASSERT_EQ(status->ordersAhead_, 0);
+    ASSERT_EQ(orderbook.GetOrderStatus(8)->ordersAhead_, 1);
+    ASSERT_EQ(orderbook.Cancel(8), CommandStatus::Accepted);
+    ASSERT_EQ(orderbook.Cancel(6), CommandStatus::Accepted);
+    ASSERT_EQ(orderbook.Cancel(6), CommandStatus::UnknownOrderId);
+    ASSERT_EQ(orderbook.getTransactionLog(), "Transaction Log:\n");
+}
+
+// Once the pool has warmed up, a steady flow of orders is served from recycled blocks and the arena stops growing
+TEST(CommandApiTests, SteadyStateTakesNoNewMemory)
+{
+    auto config = TestConfig();
+    config.arenaBytes_ = 8 * 1024 * 1024;
+    Orderbook orderbook{ config };
+
+    auto cycle = [&orderbook](OrderId first)
         {
-            action.type_ = ActionType::Add;
-            action.side_ = ParseSide(values[1]);
-            action.orderType_ = ParseOrderType(values[2]);
-            action.price_ = ParsePrice(values[3]);
-            action.quantity_ = ParseQuantity(values[4]);
-            action.orderId_ = ParseOrderId(values[5]);
+            for (OrderId orderId = first; orderId < first + 500; orderId++)
+                orderbook.AddLimit(OrderCommand{ orderId, orderId % 2 ? Side::Buy : Side::Sell, orderId % 2 ? 99 - static_cast<Price>(orderId % 5) : 101, 10 });
+            orderbook.AddIOC(OrderCommand{ first + 500, Side::Buy, 101, 100 });
+            for (OrderId orderId = first; orderId < first + 500; orderId++)
+                orderbook.Cancel(orderId);
+        };
+
+    cycle(0);
+    cycle(1'000);
+    const auto warm = orderbook.GetArena()->Used();
+    for (OrderId first = 2'000; first < 50'000; first += 1'000)
+        cycle(first);
+
+    ASSERT_EQ(orderbook.Size(), 0);
+    ASSERT_EQ(orderbook.GetArena()->Used(), warm);
+    ASSERT_EQ(orderbook.GetArena()->Overflow(), 0);
+}
+
+// The incrementally kept metrics agree with a full scan of the book after a generated session
+TEST(BookAnalyticsTests, MetricsMatchFullRecompute)
+{
+    constexpr std::size_t Depth = 3;
+    Orderbook orderbook{ TestConfig() };
+    BookAnalytics analytics{ Depth };
+    orderbook.AddListener(&analytics);
+
+    FlowGenerator flow{ FlowOptions{ .seed_ = 11, .mid_ = 1'000, .midMoveProbability_ = 0.05 } };
+    Quantity volume{ };
+    double notional{ };
+    for (int i = 0; i < 20'000; i++)
+    {
+        const auto action = flow.Next().action_;
+        const auto trades = ApplyAction(orderbook, action);
+
+        for (const auto& trade : trades)
+        {
+            // The resting order sets the trade price: the one that isn't the new order
+            const auto& resting = trade.GetBidTrade().orderdId_ == action.orderId_ ? trade.GetAskTrade() : trade.GetBidTrade();
+            volume += resting.quantity_;
+            notional += static_cast<double>(resting.price_) * resting.quantity_;
         }
-        else if (value == 'M')
+
+        if (i % 1'000 != 0)
+            continue;
+
+        const auto metrics = analytics.Metrics();
+        const auto infos = orderbook.GetOrderInfos();
+        const auto& bids = infos.GetBids();
+        const auto& asks = infos.GetAsks();
+
+        ASSERT_EQ(metrics.bestBid_.has_value(), !bids.empty());
+        ASSERT_EQ(metrics.bestAsk_.has_value(), !asks.empty());
+        if (!bids.empty() && !asks.empty())
         {
-            action.type_ = ActionType::Modify;
-            action.orderId_ = ParseOrderId(values[1]);
-            action.side_ = ParseSide(values[2]);
-            action.price_ = ParsePrice(values[3]);
-            action.quantity_ = ParseQuantity(values[4]);
+            ASSERT_EQ(*metrics.bestBid_, bids.front().price_);
+            ASSERT_EQ(*metrics.bestAsk_, asks.front().price_);
+            ASSERT_DOUBLE_EQ(*metrics.mid_, (bids.front().price_ + asks.front().price_) / 2.0);
         }
-        else if (value == 'C')
+
+        double bidTop{ }, askTop{ };
+        for (std::size_t level = 0; level < Depth && level < bids.size(); level++)
+            bidTop += bids[level].quantity_;
+        for (std::size_t level = 0; level < Depth && level < asks.size(); level++)
+            askTop += asks[level].quantity_;
+        if (bidTop + askTop > 0)
         {
-            action.type_ = ActionType::Cancel;
-            action.orderId_ = ParseOrderId(values[1]);
+            ASSERT_DOUBLE_EQ(*metrics.imbalance_, (bidTop - askTop) / (bidTop + askTop));
         }
-        else return false;
 
-        return true;
+        ASSERT_EQ(metrics.volume_, volume);
+        if (volume > 0)
+        {
+            ASSERT_DOUBLE_EQ(*metrics.vwap_, notional / volume);
+        }
     }
 
-    std::vector<std::string_view> Split(const std::string_view& str, char delimeter) const
+    Quantity profile{ };
+    for (const auto& [price, quantity] : analytics.TradedVolume())
+        profile += quantity;
+    ASSERT_EQ(profile, volume);
+    ASSERT_EQ(analytics.Metrics().flow_.buyVolume_ + analytics.Metrics().flow_.sellVolume_, volume);
+
+    orderbook.RemoveListener(&analytics);
+}
+
+// Rebuilding from the nearest checkpoint gives the exact book the engine had at that sequence
+TEST(EventJournalTests, BookAtMatchesTheLiveBook)
+{
+    struct LastEvent : BookEventListener
+    {
+        void OnBookEvent(const BookEvent& event) override { last_ = event; }
+        BookEvent last_{ };
+    };
+
+    const auto path = std::filesystem::temp_directory_path() / "EventJournalTests.jnl";
+    std::vector<std::tuple<std::uint64_t, std::uint64_t, LevelInfos, LevelInfos>> expected;
+    std::int64_t lastTimestamp{ };
     {
-        std::vector<std::string_view> columns;
-        columns.reserve(5);
-        std::size_t start_index{}, end_index{};
-        while ((end_index = str.find(delimeter, start_index)) && end_index != std::string::npos)
+        Orderbook orderbook{ TestConfig() };
+        EventJournal journal{ path, 1'000 };
+        LastEvent last;
+        orderbook.AddListener(&journal);
+        orderbook.AddListener(&last);
+
+        FlowGenerator flow{ FlowOptions{ .seed_ = 5, .mid_ = 500 } };
+        for (int i = 0; i < 20'000; i++)
         {
-            auto distance = end_index - start_index;
-            auto column = str.substr(start_index, distance);
-            start_index = end_index + 1;
-            columns.push_back(column);
+            ApplyAction(orderbook, flow.Next().action_);
+
+            if (i % 2'500 == 0)
+            {
+                const auto infos = orderbook.GetOrderInfos();
+                expected.emplace_back(last.last_.sequence_, orderbook.Checksum(), infos.GetBids(), infos.GetAsks());
+            }
         }
-        columns.push_back(str.substr(start_index));
-        return columns;
+        lastTimestamp = last.last_.timestamp_;
+        expected.emplace_back(last.last_.sequence_, orderbook.Checksum(), orderbook.GetOrderInfos().GetBids(), orderbook.GetOrderInfos().GetAsks());
+
+        orderbook.RemoveListener(&last);
+        orderbook.RemoveListener(&journal);
     }
 
-    Side ParseSide(const std::string_view& str) const
+    const JournalReader reader{ path };
+    ASSERT_GT(reader.Checkpoints().size(), 10);
+
+    auto equal = [](const LevelInfos& left, const LevelInfos& right)
+        {
+            return left.size() == right.size() && std::equal(left.begin(), left.end(), right.begin(),
+                [](const LevelInfo& a, const LevelInfo& b) { return a.price_ == b.price_ && a.quantity_ == b.quantity_; });
+        };
+
+    for (const auto& [sequence, checksum, bids, asks] : expected)
     {
-        if (str == "B")
-            return Side::Buy;
-        else if (str == "S")
-            return Side::Sell;
-        else throw std::logic_error("Unknown Side");
+        const auto book = reader.BookAt(sequence);
+        ASSERT_EQ(book.sequence_, sequence);
+        ASSERT_EQ(book.checksum_, checksum);
+        ASSERT_TRUE(book.Consistent());
+        ASSERT_TRUE(equal(book.Levels().GetBids(), bids));
+        ASSERT_TRUE(equal(book.Levels().GetAsks(), asks));
     }
 
-    OrderType ParseOrderType(const std::string_view& str) const
+    ASSERT_EQ(reader.BookAtTime(lastTimestamp).sequence_, std::get<0>(expected.back()));
+    ASSERT_EQ(reader.BookAtTime(reader.FirstTimestamp() - 1).orders_.size(), 0);
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(EventJournal::SnapshotPath(path));
+    std::filesystem::remove(EventJournal::IndexPath(path));
+}
+
+TEST(DurableJournalTests, WaitDurableMeansTheEventsAreOnDisk)
+{
+    struct Recorder : BookEventListener
     {
-        if (str == "FillAndKill")
-            return OrderType::FillAndKill;
-        else if (str == "GoodTillCancel")
-            return OrderType::GoodTillCancel;
-        else if (str == "GoodForDay")
-            return OrderType::GoodForDay;
-        else if (str == "FillOrKill")
-            return OrderType::FillOrKill;
-        else if (str == "Market")
-            return OrderType::Market;
-        else throw std::logic_error("Unknown OrderType");
-    }
+        void OnBookEvent(const BookEvent& event) override { events_.push_back(event); }
+        std::vector<BookEvent> events_;
+    };
 
-    Price ParsePrice(const std::string_view& str) const
+    const auto path = std::filesystem::temp_directory_path() / "DurableJournalTests.jnl";
+
+    // Same flow through io_uring (where the kernel allows it) and through pwrite
+    for (const bool ioUring : { true, false })
     {
-        if (str.empty())
-            throw std::logic_error("Unknown Price");
+        Recorder recorder;
+        std::uint64_t commits{ };
+        {
+            Orderbook orderbook{ TestConfig() };
+            DurableJournalOptions options;
+            options.batchEvents_ = 64;
+            options.maxDelay_ = std::chrono::microseconds{ 500 };
+            options.ioUring_ = ioUring;
+            DurableJournal journal{ path, options };
+            orderbook.AddListener(&journal);
+            orderbook.AddListener(&recorder);
+
+            FlowGenerator flow{ FlowOptions{ .seed_ = 9, .mid_ = 500 } };
+            for (int i = 0; i < 5'000; i++)
+            {
+                ApplyAction(orderbook, flow.Next().action_);
+
+                // Acknowledging an order means waiting for its batch
+                if (i % 1'000 == 999)
+                {
+                    ASSERT_FALSE(recorder.events_.empty());
+                    journal.WaitDurable(journal.LastSequence());
+                    ASSERT_GE(journal.DurableSequence(), recorder.events_.back().sequence_);
+                    ASSERT_EQ(std::filesystem::file_size(path), recorder.events_.size() * sizeof(BookEvent));
+                }
+            }
+            journal.WaitDurable(journal.LastSequence());
+            commits = journal.Commits();
+            if (!ioUring)
+            {
+                ASSERT_FALSE(journal.UsesIoUring());
+            }
+
+            orderbook.RemoveListener(&recorder);
+            orderbook.RemoveListener(&journal);
+        }
+
+        // Events from many orders share a commit
+        ASSERT_LT(commits, recorder.events_.size());
 
-        return ToNumber(str);
+        std::ifstream file{ path, std::ios::binary };
+        std::vector<BookEvent> written(recorder.events_.size() + 1);
+        file.read(reinterpret_cast<char*>(written.data()), static_cast<std::streamsize>(written.size() * sizeof(BookEvent)));
+        ASSERT_EQ(static_cast<std::size_t>(file.gcount()), recorder.events_.size() * sizeof(BookEvent));
+        for (std::size_t i = 0; i < recorder.events_.size(); i++)
+        {
+            ASSERT_EQ(written[i].sequence_, recorder.events_[i].sequence_);
+            ASSERT_EQ(written[i].orderId_, recorder.events_[i].orderId_);
+            ASSERT_EQ(written[i].checksum_, recorder.events_[i].checksum_);
+        }
     }
 
-    Quantity ParseQuantity(const std::string_view& str) const
+    std::filesystem::remove(path);
+}
+
+TEST(SharedMemoryEntryTests, ClientsAreServedRoundRobin)
+{
+    // Every client maps the segment on its own, exactly as another process would
+    SharedMemoryEntryServer server{ "OrderBookEntryTests", 2, 4 };
+    Orderbook orderbook{ TestConfig() };
+
+    SharedMemoryEntryClient busy{ "OrderBookEntryTests" };
+    std::optional<SharedMemoryEntryClient> quiet{ "OrderBookEntryTests" };
+    ASSERT_THROW(SharedMemoryEntryClient{ "OrderBookEntryTests" }, std::runtime_error);
+
+    for (std::uint64_t i = 0; i < 100; i++)
+        ASSERT_TRUE(busy.Submit(EntryRequest{ i, 1'000 + i, 100, 10, Side::Buy, EntryRequestType::Limit }));
+    ASSERT_TRUE(quiet->Submit(EntryRequest{ 7, 5'000, 100, 25, Side::Sell, EntryRequestType::ImmediateOrCancel }));
+
+    // One round serves at most a burst of the busy client before the quiet one gets its turn
+    ASSERT_EQ(server.Poll(orderbook), 5);
+
+    EntryResponse response;
+    ASSERT_TRUE(quiet->Poll(response));
+    ASSERT_EQ(response.clientSequence_, 7);
+    ASSERT_EQ(response.status_, CommandStatus::Accepted);
+    ASSERT_EQ(response.filled_, 25);
+    ASSERT_EQ(response.resting_, 0);
+    ASSERT_FALSE(quiet->Poll(response));
+
+    while (server.Poll(orderbook) != 0)
+        ;
+
+    for (std::uint64_t i = 0; i < 100; i++)
     {
-        if (str.empty())
-            throw std::logic_error("Unknown Quantity");
+        ASSERT_TRUE(busy.Poll(response));
+        ASSERT_EQ(response.clientSequence_, i);
+        ASSERT_EQ(response.orderId_, 1'000 + i);
+        ASSERT_EQ(response.status_, CommandStatus::Accepted);
+    }
+    ASSERT_EQ(orderbook.Size(), 98);
+
+    ASSERT_TRUE(busy.Submit(EntryRequest{ 100, 1'000, 0, 10, Side::Buy, EntryRequestType::Limit }));
+    ASSERT_TRUE(busy.Submit(EntryRequest{ 101, 1'050, 0, 0, Side::Buy, EntryRequestType::Cancel }));
+    ASSERT_TRUE(busy.Submit(EntryRequest{ 102, 1'050, 0, 0, Side::Buy, EntryRequestType::Cancel }));
+    server.Poll(orderbook);
+    ASSERT_TRUE(busy.Poll(response));
+    ASSERT_EQ(response.status_, CommandStatus::InvalidPrice);
+    ASSERT_TRUE(busy.Poll(response));
+    ASSERT_EQ(response.status_, CommandStatus::Accepted);
+    ASSERT_TRUE(busy.Poll(response));
+    ASSERT_EQ(response.status_, CommandStatus::UnknownOrderId);
+
+    // A client's slot is handed out again once the engine has seen it leave
+    quiet.reset();
+    ASSERT_THROW(SharedMemoryEntryClient{ "OrderBookEntryTests" }, std::runtime_error);
+    server.Poll(orderbook);
+    quiet.emplace("OrderBookEntryTests");
+    ASSERT_FALSE(quiet->Poll(response));
+}
 
-        return ToNumber(str);
+#if defined(__linux__)
+// A client process that dies without detaching doesn't keep its slot forever, the engine's liveness check frees it
+TEST(SharedMemoryEntryTests, SlotOfADeadClientIsReclaimed)
+{
+    SharedMemoryEntryServer server{ "OrderBookEntryReclaimTests", 1 };
+    Orderbook orderbook{ TestConfig() };
+
+    const auto clientProcess = fork();
+    ASSERT_GE(clientProcess, 0);
+    if (clientProcess == 0)
+    {
+        // Leaves without the client's destructor, like a crash
+        SharedMemoryEntryClient client{ "OrderBookEntryReclaimTests" };
+        client.Submit(EntryRequest{ 1, 1, 100, 10, Side::Buy, EntryRequestType::Limit });
+        _exit(0);
     }
+    int status{ };
+    ASSERT_EQ(waitpid(clientProcess, &status, 0), clientProcess);
+    ASSERT_THROW(SharedMemoryEntryClient{ "OrderBookEntryReclaimTests" }, std::runtime_error);
+
+    // Until the next liveness check the slot is served as attached
+    for (std::uint32_t round = 1; round < SharedEntryLayout::LivenessRounds; round++)
+        server.Poll(orderbook);
+    ASSERT_EQ(orderbook.Size(), 1);
+    ASSERT_THROW(SharedMemoryEntryClient{ "OrderBookEntryReclaimTests" }, std::runtime_error);
+
+    server.Poll(orderbook);
+    SharedMemoryEntryClient client{ "OrderBookEntryReclaimTests" };
+    EntryResponse response;
+    ASSERT_FALSE(client.Poll(response));
+    ASSERT_TRUE(client.Submit(EntryRequest{ 2, 2, 100, 10, Side::Sell, EntryRequestType::Limit }));
+    server.Poll(orderbook);
+    ASSERT_TRUE(client.Poll(response));
+    ASSERT_EQ(response.filled_, 10);
+
+    // A live client is left alone by the check
+    for (std::uint32_t round = 0; round < SharedEntryLayout::LivenessRounds; round++)
+        server.Poll(orderbook);
+    ASSERT_TRUE(client.Submit(EntryRequest{ 3, 3, 100, 10, Side::Sell, EntryRequestType::Limit }));
+    server.Poll(orderbook);
+    ASSERT_TRUE(client.Poll(response));
+    ASSERT_EQ(response.clientSequence_, 3);
+}
+#endif
+
+TEST(EnginePipelineTests, StagesMatchTheSingleThreadedBook)
+{
+    struct Recorder : BookEventListener
+    {
+        void OnBookEvent(const BookEvent& event) override { sequences_.push_back(event.sequence_); }
+        std::vector<std::uint64_t> sequences_;
+    };
+
+    std::vector<EntryRequest> requests;
+    FlowGenerator flow{ FlowOptions{ .seed_ = 13, .mid_ = 500 } };
+    for (std::uint64_t i = 0; i < 20'000; i++)
+        requests.push_back(ToEntryRequest(flow.Next().action_, i));
+    // Decode turns these away before they reach the match stage
+    requests[100].quantity_ = 0;
+    requests[200].type_ = EntryRequestType::Limit;
+    requests[200].price_ = 0;
+    requests[200].quantity_ = 5;
+
+    const auto config = TestConfig();
 
-    OrderId ParseOrderId(const std::string_view& str) const
+    Orderbook direct{ config };
+    Recorder directEvents;
+    direct.AddListener(&directEvents);
+    std::vector<EntryResponse> expected;
+    for (const auto& request : requests)
+        expected.push_back(SharedMemoryEntryServer::Execute(direct, request));
+    direct.RemoveListener(&directEvents);
+
+    Orderbook staged{ config };
+    Recorder published, journaled;
+    std::vector<EntryResponse> responses;
     {
-        if (str.empty())
-            throw std::logic_error("Empty OrderId");
+        PipelineOptions options;
+        options.ringSize_ = 256;
+        options.publishers_ = { &published };
+        options.journals_ = { &journaled };
+        options.onResponse_ = [&responses](const EntryResponse& response) { responses.push_back(response); };
 
-        return static_cast<OrderId>(ToNumber(str));
+        EnginePipeline pipeline{ staged, options };
+        for (const auto& request : requests)
+            pipeline.Submit(request);
+        pipeline.Drain();
     }
 
-public:
-    std::tuple<Informations, Result> GetInformations(const std::filesystem::path& path) const
+    ASSERT_EQ(responses.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); i++)
     {
-        Informations actions;
-        actions.reserve(1'000);
+        ASSERT_EQ(responses[i].clientSequence_, i);
+        ASSERT_EQ(responses[i].status_, expected[i].status_);
+        ASSERT_EQ(responses[i].filled_, expected[i].filled_);
+        ASSERT_EQ(responses[i].resting_, expected[i].resting_);
+    }
+    ASSERT_EQ(responses[100].status_, CommandStatus::InvalidQuantity);
+    ASSERT_EQ(responses[200].status_, CommandStatus::InvalidPrice);
 
-        std::string line;
-        std::ifstream file{ path };
-        while (std::getline(file, line))
-        {
-            if (line.empty())
-                break;
+    // Both output stages saw every event, in order
+    ASSERT_EQ(published.sequences_.size(), directEvents.sequences_.size());
+    ASSERT_EQ(published.sequences_, journaled.sequences_);
+    ASSERT_TRUE(std::is_sorted(published.sequences_.begin(), published.sequences_.end()));
+    ASSERT_EQ(staged.Checksum(), direct.Checksum());
+    ASSERT_EQ(staged.Size(), direct.Size());
+}
+
+TEST(PreTradeRiskTests, RejectsLeaveTheBookUntouched)
+{
+    Orderbook orderbook{ TestConfig() };
+    PreTradeRisk risk{ RiskLimits{ .maxOrderQuantity_ = 100, .priceCollar_ = 5, .maxOpenQuantity_ = 150, .maxOpenNotional_ = 15'000 }, 4 };
+    orderbook.SetPreTradeCheck(&risk);
 
-            const bool isResult = line.at(0) == 'R'; // R  stands for result
-            const bool isAction = !isResult;
+    ASSERT_EQ(orderbook.AddLimit(OrderCommand{ 1, Side::Sell, 100, 50, 1 }).status_, CommandStatus::Accepted);
+    ASSERT_EQ(orderbook.AddLimit(OrderCommand{ 2, Side::Sell, 101, 50, 1 }).status_, CommandStatus::Accepted);
+    ASSERT_EQ(risk.Exposure(1).openQuantity_, 100);
+    ASSERT_EQ(risk.Exposure(1).openNotional_, 10'050);
 
-            if (isAction)
-            {
-                Information action;
+    const auto checksum = orderbook.Checksum();
+    ASSERT_EQ(orderbook.AddLimit(OrderCommand{ 3, Side::Buy, 90, 101, 0 }).status_, CommandStatus::RiskOrderSize);
+    ASSERT_EQ(orderbook.AddLimit(OrderCommand{ 4, Side::Buy, 106, 10, 0 }).status_, CommandStatus::RiskPriceCollar);
+    ASSERT_EQ(orderbook.AddLimit(OrderCommand{ 5, Side::Sell, 102, 60, 1 }).status_, CommandStatus::RiskOpenQuantity);
+    ASSERT_EQ(orderbook.AddLimit(OrderCommand{ 6, Side::Sell, 150, 45, 1 }).status_, CommandStatus::RiskNotional);
+    ASSERT_EQ(orderbook.AddLimit(OrderCommand{ 7, Side::Buy, 99, 10, 9 }).status_, CommandStatus::RiskUnknownAccount);
+    ASSERT_EQ(orderbook.AddMarket(MarketCommand{ 8, Side::Buy, 101, 0 }).status_, CommandStatus::RiskOrderSize);
 
-                auto isValid = TryParseInformation(line, action);
-                if (!isValid)
-                    continue;
+    // A modify turned down keeps the original order, its time priority included
+    ASSERT_EQ(orderbook.Modify(OrderCommand{ 1, Side::Sell, 100, 120 }).status_, CommandStatus::RiskOrderSize);
+    ASSERT_EQ(orderbook.Checksum(), checksum);
+    ASSERT_EQ(orderbook.Size(), 2);
+    ASSERT_EQ(risk.Exposure(1).openQuantity_, 100);
+    ASSERT_EQ(risk.Exposure(0).openQuantity_, 0);
+
+    // The replaced order's exposure is taken out before the new one is counted, otherwise 190 > 150
+    ASSERT_EQ(orderbook.Modify(OrderCommand{ 1, Side::Sell, 100, 90 }).status_, CommandStatus::Accepted);
+    ASSERT_EQ(risk.Exposure(1).openQuantity_, 140);
+    ASSERT_EQ(risk.Exposure(1).openNotional_, 14'050);
+
+    // Fills and cancels release exposure, the fully traded aggressor leaves none behind
+    const auto ioc = orderbook.AddIOC(OrderCommand{ 9, Side::Buy, 101, 60, 0 });
+    ASSERT_EQ(ioc.filled_, 60);
+    ASSERT_EQ(risk.Exposure(1).openQuantity_, 80);
+    ASSERT_EQ(risk.Exposure(1).openNotional_, 8'050);
+    ASSERT_EQ(risk.Exposure(0).openQuantity_, 0);
+    ASSERT_EQ(risk.Exposure(0).openNotional_, 0);
+
+    ASSERT_EQ(orderbook.Cancel(2), CommandStatus::Accepted);
+    ASSERT_EQ(risk.Exposure(1).openQuantity_, 30);
+    ASSERT_EQ(risk.Exposure(1).openNotional_, 3'000);
+}
+
+// ModifyOrder goes through the same checks as Modify: the order keeps its account and a reject keeps the order
+TEST(PreTradeRiskTests, ModifyOrderKeepsTheAccount)
+{
+    Orderbook orderbook{ TestConfig() };
+    PreTradeRisk risk{ RiskLimits{ .maxOpenQuantity_ = 150 }, 8 };
+    orderbook.SetPreTradeCheck(&risk);
+    constexpr AccountId Account = 7;
+
+    auto order = orderbook.CreateOrder(OrderType::GoodTillCancel, 1, Side::Sell, 100, 50);
+    order->SetAccount(Account);
+    orderbook.AddOrder(order);
+    ASSERT_EQ(risk.Exposure(Account).openQuantity_, 50);
+
+    // Netted against the order it replaces: 130 is within 150, 50 + 130 wouldn't be
+    ASSERT_TRUE(orderbook.ModifyOrder(OrderModify{ 1, Side::Sell, 101, 130 }).empty());
+    ASSERT_EQ(risk.Exposure(Account).openQuantity_, 130);
+    ASSERT_EQ(risk.Exposure(Account).openNotional_, 13'130);
+    ASSERT_EQ(risk.Exposure(0).openQuantity_, 0);
+    ASSERT_EQ(orderbook.GetOrderStatus(1)->account_, Account);
+
+    // Rejected by the risk or as invalid, the order rests as it was
+    const auto checksum = orderbook.Checksum();
+    ASSERT_TRUE(orderbook.ModifyOrder(OrderModify{ 1, Side::Sell, 101, 160 }).empty());
+    ASSERT_TRUE(orderbook.ModifyOrder(OrderModify{ 1, Side::Sell, 101, 0 }).empty());
+    ExecutionReports reports;
+    orderbook.ModifyOrder(OrderModify{ 1, Side::Sell, 0, 10 }, reports);
+    ASSERT_TRUE(reports.empty());
+    ASSERT_EQ(orderbook.Size(), 1);
+    ASSERT_EQ(orderbook.Checksum(), checksum);
+    ASSERT_EQ(risk.Exposure(Account).openQuantity_, 130);
+
+    // Fills of the modified order are charged to its own account
+    orderbook.ModifyOrder(OrderModify{ 1, Side::Sell, 100, 40 }, reports);
+    ASSERT_EQ(orderbook.AddIOC(OrderCommand{ 2, Side::Buy, 100, 15, 0 }).filled_, 15);
+    ASSERT_EQ(risk.Exposure(Account).openQuantity_, 25);
+    ASSERT_EQ(risk.Exposure(Account).openNotional_, 2'500);
+    ASSERT_EQ(risk.Exposure(0).openQuantity_, 0);
+}
 
-                actions.push_back(action);
+// Queue position against a plain model of the level through cancels, compactions, partial fills and wrap arounds
+TEST(OrderStatusTests, QueuePositionFollowsTheLevel)
+{
+    Orderbook orderbook{ TestConfig() };
+    std::vector<std::pair<OrderId, Quantity>> level;
+
+    const auto verify = [&]
+        {
+            std::uint64_t quantityAhead{ 0 };
+            for (std::size_t i = 0; i < level.size(); i++)
+            {
+                const auto status = orderbook.GetOrderStatus(level[i].first);
+                ASSERT_TRUE(status.has_value());
+                ASSERT_EQ(status->remainingQuantity_, level[i].second);
+                ASSERT_EQ(status->filledQuantity_, status->initialQuantity_ - level[i].second);
+                ASSERT_EQ(status->ordersAhead_, i);
+                ASSERT_EQ(status->quantityAhead_, quantityAhead);
+                quantityAhead += level[i].second;
             }
-            else
+        };
+    const auto add = [&](OrderId orderId)
+        {
+            const Quantity quantity = orderId % 7 + 1;
+            orderbook.AddLimit(OrderCommand{ orderId, Side::Buy, 100, quantity });
+            level.emplace_back(orderId, quantity);
+        };
+    const auto cancel = [&](OrderId orderId)
+        {
+            orderbook.Cancel(orderId);
+            std::erase_if(level, [orderId](const auto& entry) { return entry.first == orderId; });
+        };
+    const auto sell = [&](OrderId orderId, Quantity quantity)
+        {
+            orderbook.AddIOC(OrderCommand{ orderId, Side::Sell, 100, quantity });
+            while (quantity > 0 && !level.empty())
             {
-                if (!file.eof())
-                    throw std::logic_error("Result should only be specified at the end.");
+                const auto fill = std::min(quantity, level.front().second);
+                level.front().second -= fill;
+                quantity -= fill;
+                if (level.front().second == 0)
+                    level.erase(level.begin());
+            }
+        };
 
-                Result result;
+    for (OrderId orderId = 1; orderId <= 300; orderId++)
+        add(orderId);
+    verify();
 
-                auto isValid = TryParseResult(line, result);
-                if (!isValid)
-                    continue;
+    // Enough cancels in the middle to compact the level
+    for (OrderId orderId = 50; orderId <= 250; orderId++)
+        if (orderId % 4 != 0)
+            cancel(orderId);
+    verify();
 
-                return { actions, result };
-            }
+    // Partial fills at the front, then new orders wrapping around the ring behind the head
+    sell(10'000, 123);
+    verify();
+    for (OrderId orderId = 301; orderId <= 340; orderId++)
+        add(orderId);
+    sell(10'001, 57);
+    cancel(320);
+    verify();
+
+    ASSERT_FALSE(orderbook.GetOrderStatus(1).has_value());
+    ASSERT_FALSE(orderbook.GetOrderStatus(10'000).has_value());
+    const auto last = orderbook.GetOrderStatus(340);
+    ASSERT_EQ(last->side_, Side::Buy);
+    ASSERT_EQ(last->price_, 100);
+    ASSERT_EQ(last->ordersAhead_, level.size() - 1);
+}
+
+// Unchanged quotes keep their place in the queue, changed ones go to the back, a bad set changes nothing
+TEST(ReplaceQuotesTests, UnchangedLevelsKeepPriority)
+{
+    Orderbook orderbook{ TestConfig() };
+    constexpr AccountId MarketMaker = 7;
+
+    std::vector<Quote> bids{ { 1, 99, 10 }, { 2, 98, 10 } };
+    std::vector<Quote> asks{ { 3, 101, 10 }, { 4, 102, 10 } };
+    auto result = orderbook.ReplaceQuotes(MarketMaker, bids, asks);
+    ASSERT_EQ(result.status_, CommandStatus::Accepted);
+    ASSERT_EQ(result.added_, 4);
+
+    // Someone else joins behind the quotes at 99 & 101
+    orderbook.AddLimit(OrderCommand{ 100, Side::Buy, 99, 5 });
+    orderbook.AddLimit(OrderCommand{ 101, Side::Sell, 101, 5 });
+
+    // 99 & 101 stay, 98 grows, 102 moves to 103 and a bid at 97 comes in
+    bids = { { 1, 99, 10 }, { 2, 98, 20 }, { 5, 97, 10 } };
+    asks = { { 3, 101, 10 }, { 4, 103, 10 } };
+    LevelUpdates levels;
+    result = orderbook.ReplaceQuotes(MarketMaker, bids, asks, &levels);
+    ASSERT_EQ(result.status_, CommandStatus::Accepted);
+    ASSERT_EQ(result.kept_, 2);
+    ASSERT_EQ(result.cancelled_, 2);
+    ASSERT_EQ(result.added_, 3);
+    ASSERT_EQ(orderbook.GetOrderStatus(1)->ordersAhead_, 0);
+    ASSERT_EQ(orderbook.GetOrderStatus(100)->ordersAhead_, 1);
+    ASSERT_EQ(orderbook.GetOrderStatus(3)->ordersAhead_, 0);
+    ASSERT_EQ(orderbook.GetOrderStatus(5)->account_, MarketMaker);
+
+    // Each level that moved once, with where it ended up
+    ASSERT_EQ(levels.size(), 4);
+    ASSERT_EQ(levels[0].price_, 98);
+    ASSERT_EQ(levels[0].quantity_, 20);
+    ASSERT_EQ(levels[1].price_, 97);
+    ASSERT_EQ(levels[1].orderCount_, 1);
+    ASSERT_EQ(levels[2].side_, Side::Sell);
+    ASSERT_EQ(levels[2].price_, 102);
+    ASSERT_EQ(levels[2].quantity_, 0);
+    ASSERT_EQ(levels[3].price_, 103);
+    ASSERT_EQ(levels[3].quantity_, 10);
+
+    // A quote that traded away since is simply added again, behind whoever is there now
+    ASSERT_EQ(orderbook.AddIOC(OrderCommand{ 200, Side::Sell, 99, 10 }).filled_, 10);
+    result = orderbook.ReplaceQuotes(MarketMaker, bids, asks);
+    ASSERT_EQ(result.kept_, 4);
+    ASSERT_EQ(result.added_, 1);
+    ASSERT_EQ(result.cancelled_, 0);
+    ASSERT_EQ(orderbook.GetOrderStatus(1)->ordersAhead_, 1);
+
+    // Bad sets leave everything as it was
+    const auto checksum = orderbook.Checksum();
+    const std::vector<Quote> crossed{ { 1, 99, 10 }, { 2, 101, 10 } };
+    const std::vector<Quote> foreign{ { 100, 99, 10 } };
+    const std::vector<Quote> repeated{ { 1, 105, 10 } };
+    const std::vector<Quote> empty{ { 1, 99, 0 } };
+    ASSERT_EQ(orderbook.ReplaceQuotes(MarketMaker, crossed, asks).status_, CommandStatus::CrossedQuotes);
+    ASSERT_EQ(orderbook.ReplaceQuotes(MarketMaker, foreign, { }).status_, CommandStatus::DuplicateOrderId);
+    ASSERT_EQ(orderbook.ReplaceQuotes(MarketMaker, bids, repeated).status_, CommandStatus::DuplicateOrderId);
+    ASSERT_EQ(orderbook.ReplaceQuotes(MarketMaker, empty, asks).status_, CommandStatus::InvalidQuantity);
+    ASSERT_EQ(orderbook.Checksum(), checksum);
+    ASSERT_EQ(orderbook.Size(), 7);
+
+    // An empty set pulls every quote
+    result = orderbook.ReplaceQuotes(MarketMaker, { }, { });
+    ASSERT_EQ(result.cancelled_, 5);
+    ASSERT_EQ(orderbook.Size(), 2);
+}
+
+// The risk judges a quote set by the exposure it leaves once the quotes it replaces are gone,
+// and a set it turns down cancels nothing
+TEST(ReplaceQuotesTests, RiskTurnsDownTheWholeSet)
+{
+    Orderbook orderbook{ TestConfig() };
+    PreTradeRisk risk{ RiskLimits{ .maxOrderQuantity_ = 50, .maxOpenQuantity_ = 100 }, 8 };
+    orderbook.SetPreTradeCheck(&risk);
+    constexpr AccountId MarketMaker = 7;
+
+    // Over the open quantity as a whole though every quote is fine on its own
+    const std::vector<Quote> tooMuch{ { 1, 99, 40 }, { 2, 98, 40 }, { 3, 97, 40 } };
+    ASSERT_EQ(orderbook.ReplaceQuotes(MarketMaker, tooMuch, { }).status_, CommandStatus::RiskOpenQuantity);
+    ASSERT_EQ(orderbook.Size(), 0);
+
+    std::vector<Quote> bids{ { 1, 99, 25 }, { 2, 98, 25 } };
+    std::vector<Quote> asks{ { 3, 101, 25 }, { 4, 102, 25 } };
+    ASSERT_EQ(orderbook.ReplaceQuotes(MarketMaker, bids, asks).added_, 4);
+    ASSERT_EQ(risk.Exposure(MarketMaker).openQuantity_, 100);
 
+    // At the limit already, a new set of the same size fits once the replaced quotes are netted out
+    bids = { { 1, 99, 25 }, { 5, 97, 25 } };
+    asks = { { 3, 101, 25 }, { 6, 103, 25 } };
+    const auto result = orderbook.ReplaceQuotes(MarketMaker, bids, asks);
+    ASSERT_EQ(result.status_, CommandStatus::Accepted);
+    ASSERT_EQ(result.kept_, 2);
+    ASSERT_EQ(result.cancelled_, 2);
+    ASSERT_EQ(result.added_, 2);
+    ASSERT_EQ(result.rejected_, 0);
+    ASSERT_EQ(risk.Exposure(MarketMaker).openQuantity_, 100);
+
+    // One more lot, or one quote over the order size, and the whole set is turned down with every quote still resting
+    const auto checksum = orderbook.Checksum();
+    const std::vector<Quote> grown{ { 1, 99, 25 }, { 5, 97, 26 } };
+    const std::vector<Quote> large{ { 7, 98, 51 } };
+    ASSERT_EQ(orderbook.ReplaceQuotes(MarketMaker, grown, asks).status_, CommandStatus::RiskOpenQuantity);
+    ASSERT_EQ(orderbook.ReplaceQuotes(MarketMaker, large, { }).status_, CommandStatus::RiskOrderSize);
+    ASSERT_EQ(orderbook.Checksum(), checksum);
+    ASSERT_EQ(orderbook.Size(), 4);
+    ASSERT_EQ(risk.Exposure(MarketMaker).openQuantity_, 100);
+
+    // The set that was turned down didn't replace the one resting, pulling the quotes still works
+    ASSERT_EQ(orderbook.ReplaceQuotes(MarketMaker, { }, { }).cancelled_, 4);
+    ASSERT_EQ(risk.Exposure(MarketMaker).openQuantity_, 0);
+}
+
+// Every event comes back column by column, chunk statistics let a scan skip what can't match
+// and the last depth snapshot is the book's own top of book
+TEST(ColumnarExportTests, ColumnsRoundTripTheEventStream)
+{
+    struct Recorder : BookEventListener
+    {
+        void OnBookEvent(const BookEvent& event) override { events_.push_back(event); }
+        std::vector<BookEvent> events_;
+    };
+
+    const auto path = std::filesystem::temp_directory_path() / "ColumnarExportTests.col";
+    const ColumnarOptions options{ .chunkRows_ = 1'000, .snapshotInterval_ = 500, .depthLevels_ = 5 };
+    Recorder recorder;
+    OrderbookLevelInfos top{ { }, { } };
+    {
+        Orderbook orderbook{ TestConfig() };
+        ColumnarExporter exporter{ path, options };
+        orderbook.AddListener(&exporter);
+        orderbook.AddListener(&recorder);
+
+        FlowGenerator flow{ FlowOptions{ .seed_ = 9, .mid_ = 800 } };
+        for (int i = 0; i < 10'000; i++)
+        {
+            ApplyAction(orderbook, flow.Next().action_);
         }
 
-        throw std::logic_error("No result specified.");
+        // Deep resting bids are one event each, line the stream up with a snapshot
+        for (OrderId id = 1'000'000'000; recorder.events_.size() % options.snapshotInterval_ != 0; id++)
+            orderbook.AddLimit(OrderCommand{ id, Side::Buy, 1, 1 });
+        top = orderbook.GetOrderInfos();
+
+        orderbook.RemoveListener(&recorder);
+        orderbook.RemoveListener(&exporter);
     }
-};
 
+    const ColumnarReader reader{ path };
+    const auto& events = recorder.events_;
+    ASSERT_EQ(reader.Rows(ColumnarTable::Events), events.size());
 
-// Defines a test fixture class for Google Test parameterized tests
-// This test fixtured is paramterized & the type is const char* (string)
-class OrderbookTestsFixture : public googletest::TestWithParam<const char*>
+    std::size_t row{ 0 };
+    for (const auto& chunk : reader.Chunks())
+    {
+        if (chunk.table_ != ColumnarTable::Events)
+            continue;
+        ASSERT_LE(chunk.rows_, options.chunkRows_);
+
+        const auto sequences = reader.Column<std::uint64_t>(chunk, EventColumn::Sequence);
+        const auto orderIds = reader.Column<std::uint64_t>(chunk, EventColumn::OrderId);
+        const auto prices = reader.Column<std::int32_t>(chunk, EventColumn::Price);
+        const auto quantities = reader.Column<std::uint32_t>(chunk, EventColumn::Quantity);
+        const auto remaining = reader.Column<std::uint32_t>(chunk, EventColumn::Remaining);
+        const auto types = reader.Column<std::uint8_t>(chunk, EventColumn::Type);
+        const auto sides = reader.Column<std::uint8_t>(chunk, EventColumn::Side);
+        for (std::size_t i = 0; i < chunk.rows_; i++, row++)
+        {
+            ASSERT_EQ(sequences[i], events[row].sequence_);
+            ASSERT_EQ(orderIds[i], events[row].orderId_);
+            ASSERT_EQ(prices[i], events[row].price_);
+            ASSERT_EQ(quantities[i], events[row].quantity_);
+            ASSERT_EQ(remaining[i], events[row].remaining_);
+            ASSERT_EQ(types[i], static_cast<std::uint8_t>(events[row].type_));
+            ASSERT_EQ(sides[i], static_cast<std::uint8_t>(events[row].side_));
+        }
+
+        const auto column = static_cast<std::size_t>(EventColumn::Sequence);
+        ASSERT_EQ(chunk.min_[column], static_cast<std::int64_t>(sequences.front()));
+        ASSERT_EQ(chunk.max_[column], static_cast<std::int64_t>(sequences.back()));
+    }
+    ASSERT_EQ(row, events.size());
+    ASSERT_THROW(reader.Column<std::uint32_t>(reader.Chunks().front(), EventColumn::Sequence), std::logic_error);
+
+    // Sequences only grow, so a narrow range lands in a single chunk
+    std::size_t visited{ 0 };
+    const auto skipped = reader.Scan(EventColumn::Sequence, 2'500, 2'600, [&visited](const ColumnarChunk&) { visited++; });
+    ASSERT_EQ(visited, 1);
+    ASSERT_EQ(skipped + visited, (events.size() + options.chunkRows_ - 1) / options.chunkRows_);
+
+    // The last snapshot was taken on the last event
+    std::vector<std::tuple<std::uint8_t, Price, Quantity>> depth;
+    for (const auto& chunk : reader.Chunks())
+    {
+        if (chunk.table_ != ColumnarTable::Depth)
+            continue;
+        const auto sequences = reader.Column<std::uint64_t>(chunk, DepthColumn::Sequence);
+        const auto sides = reader.Column<std::uint8_t>(chunk, DepthColumn::Side);
+        const auto prices = reader.Column<std::int32_t>(chunk, DepthColumn::Price);
+        const auto quantities = reader.Column<std::uint32_t>(chunk, DepthColumn::Quantity);
+        for (std::size_t i = 0; i < chunk.rows_; i++)
+        {
+            if (sequences[i] == events.back().sequence_)
+                depth.emplace_back(sides[i], prices[i], quantities[i]);
+        }
+    }
+
+    std::vector<std::tuple<std::uint8_t, Price, Quantity>> expected;
+    for (std::size_t i = 0; i < std::min<std::size_t>(options.depthLevels_, top.GetBids().size()); i++)
+        expected.emplace_back(static_cast<std::uint8_t>(Side::Buy), top.GetBids()[i].price_, top.GetBids()[i].quantity_);
+    for (std::size_t i = 0; i < std::min<std::size_t>(options.depthLevels_, top.GetAsks().size()); i++)
+        expected.emplace_back(static_cast<std::uint8_t>(Side::Sell), top.GetAsks()[i].price_, top.GetAsks()[i].quantity_);
+    ASSERT_FALSE(expected.empty());
+    ASSERT_EQ(depth, expected);
+
+    std::filesystem::remove(path);
+}
+
+// Both rows of a fill carry the resting order's price, whichever side was the aggressor
+TEST(ColumnarExportTests, FillsCarryTheTradePrice)
 {
-private:
-    const static inline std::filesystem::path Root{ std::filesystem::current_path() };
-    const static inline std::filesystem::path TestFolder{ "TestFolder" };
-public:
-    const static inline std::filesystem::path TestFolderPath{ Root / TestFolder };
-};
+    const auto path = std::filesystem::temp_directory_path() / "ColumnarTradePrice.col";
+    {
+        Orderbook orderbook{ TestConfig() };
+        ColumnarExporter exporter{ path, ColumnarOptions{ .chunkRows_ = 4, .snapshotInterval_ = 0 } };
+        orderbook.AddListener(&exporter);
 
-// This function is use to define parameterized test. Allow to execute same test logic with diff parameters
-TEST_P(OrderbookTestsFixture, OrderbookTestSuite)
+        // A sell hits a bid at 100, then a buy lifts an offer at 105
+        orderbook.AddLimit(OrderCommand{ 1, Side::Buy, 100, 10 });
+        orderbook.AddLimit(OrderCommand{ 2, Side::Sell, 95, 4 });
+        orderbook.AddLimit(OrderCommand{ 3, Side::Sell, 105, 5 });
+        orderbook.AddLimit(OrderCommand{ 4, Side::Buy, 110, 5 });
+        orderbook.RemoveListener(&exporter);
+    }
+
+    const ColumnarReader reader{ path };
+    std::vector<Price> tradePrices;
+    for (const auto& chunk : reader.Chunks())
+    {
+        const auto prices = reader.Column<std::int32_t>(chunk, EventColumn::TradePrice);
+        tradePrices.insert(tradePrices.end(), prices.begin(), prices.end());
+    }
+    ASSERT_EQ(tradePrices, (std::vector<Price>{ 0, 0, 100, 100, 0, 0, 105, 105 }));
+
+    // The first chunk traded at 100 only, a scan above it skips it
+    std::size_t visited{ 0 };
+    const auto skipped = reader.Scan(EventColumn::TradePrice, 101, 110, [&visited](const ColumnarChunk&) { visited++; });
+    ASSERT_EQ(visited, 1);
+    ASSERT_EQ(skipped, 1);
+
+    std::filesystem::remove(path);
+}
+
+// The AVX2 kernels (when the CPU has them) agree with the scalar ones on every length, tails included
+TEST(DepthKernelsTests, DispatchedKernelsMatchScalar)
 {
-    // Arrange
-    const auto file = OrderbookTestsFixture::TestFolderPath / GetParam();
+    std::vector<DepthKernels::Table> tables{ DepthKernels::Scalar(), DepthKernels::Active() };
+    if (DepthKernels::HasAvx2())
+        tables.push_back(DepthKernels::Avx2());
 
-    InputHandler handler;
-    const auto [actions, result] = handler.GetInformations(file);
+    std::mt19937 random{ 3 };
+    for (std::size_t length = 0; length < 70; length++)
+    {
+        std::vector<Quantity> quantities(length);
+        for (auto& quantity : quantities)
+            quantity = random() % 3 == 0 ? 0 : static_cast<Quantity>(random() % 4'000'000'000u);
 
-    auto GetOrder = [](const Information& action)
+        std::vector<std::uint64_t> expected(length);
+        std::uint64_t total{ 0 };
+        for (std::size_t i = 0; i < length; i++)
+            expected[i] = total += quantities[i];
+
+        for (const auto& kernels : tables)
         {
-            return std::make_shared<Order>(
-                action.orderType_,
-                action.orderId_,
-                action.side_,
-                action.price_,
-                action.quantity_);
+            ASSERT_EQ(kernels.sum_(quantities.data(), length), total) << kernels.name_ << ' ' << length;
+
+            std::vector<std::uint64_t> prefix(length);
+            kernels.prefix_(quantities.data(), length, prefix.data());
+            ASSERT_EQ(prefix, expected) << kernels.name_ << ' ' << length;
+
+            // Pro-rata shares are exact, whatever the kernel
+            if (total > 0 && total <= std::numeric_limits<Quantity>::max())
+            {
+                const auto incoming = static_cast<Quantity>(random() % total);
+                const Quantity minimum = random() % 2 ? 1 : 1'000;
+                std::vector<Quantity> shares(length);
+                std::uint64_t allocated{ 0 };
+                for (std::size_t i = 0; i < length; i++)
+                {
+                    const auto share = static_cast<Quantity>(static_cast<std::uint64_t>(quantities[i]) * incoming / total);
+                    allocated += share >= minimum ? share : 0;
+                }
+                ASSERT_EQ(kernels.proRata_(quantities.data(), length, incoming, static_cast<Quantity>(total), minimum, shares.data()), allocated);
+                for (std::size_t i = 0; i < length; i++)
+                {
+                    const auto share = static_cast<Quantity>(static_cast<std::uint64_t>(quantities[i]) * incoming / total);
+                    ASSERT_EQ(shares[i], share >= minimum ? share : 0) << kernels.name_ << ' ' << length;
+                }
+            }
+
+            ASSERT_EQ(kernels.sweep_(quantities.data(), length, 0), 0);
+            ASSERT_EQ(kernels.sweep_(quantities.data(), length, total + 1), DepthKernels::Insufficient);
+            for (std::size_t i = 0; i < length; i++)
+            {
+                // Exactly the cumulative depth of a level ends the sweep there, one more needs the next non empty one
+                const auto levels = static_cast<std::size_t>(std::lower_bound(expected.begin(), expected.end(), expected[i]) - expected.begin()) + 1;
+                if (expected[i] > 0)
+                {
+                    ASSERT_EQ(kernels.sweep_(quantities.data(), length, expected[i]), levels) << kernels.name_ << ' ' << length;
+                }
+            }
+        }
+    }
+
+    // A FillOrKill checks the levels in blocks, more levels than a block still add up
+    Orderbook orderbook{ TestConfig() };
+    for (Price price = 100; price < 300; price++)
+        orderbook.AddLimit(OrderCommand{ static_cast<OrderId>(price), Side::Sell, price, 2 });
+    ASSERT_EQ(orderbook.AddFOK(OrderCommand{ 1'000, Side::Buy, 249, 301 }).status_, CommandStatus::CannotFullyFill);
+    ASSERT_EQ(orderbook.AddFOK(OrderCommand{ 1'001, Side::Buy, 250, 301 }).filled_, 301);
+    ASSERT_EQ(orderbook.AddFOK(OrderCommand{ 1'002, Side::Buy, 1'000, 100 }).status_, CommandStatus::CannotFullyFill);
+    ASSERT_EQ(orderbook.AddFOK(OrderCommand{ 1'003, Side::Buy, 1'000, 99 }).filled_, 99);
+}
+
+// Pro-rata allocates in proportion with rounded down shares, leftovers in time priority
+TEST(MatchingPolicyTests, ProRataSplitsTheLevel)
+{
+    auto config = TestConfig();
+    auto remaining = [](const Orderbook& orderbook, OrderId orderId)
+        {
+            const auto status = orderbook.GetOrderStatus(orderId);
+            return status ? status->remainingQuantity_ : Quantity{ 0 };
         };
 
-    auto GetOrderModify = [](const Information& action)
+    config.matching_ = MatchingPolicy{ MatchingAlgorithm::ProRata, 1 };
+    {
+        Orderbook orderbook{ config };
+        orderbook.AddLimit(OrderCommand{ 1, Side::Sell, 100, 100 });
+        orderbook.AddLimit(OrderCommand{ 2, Side::Sell, 100, 300 });
+        orderbook.AddLimit(OrderCommand{ 3, Side::Sell, 100, 600 });
+
+        ASSERT_EQ(orderbook.AddIOC(OrderCommand{ 10, Side::Buy, 100, 100 }).filled_, 100);
+        ASSERT_EQ(remaining(orderbook, 1), 90);
+        ASSERT_EQ(remaining(orderbook, 2), 270);
+        ASSERT_EQ(remaining(orderbook, 3), 540);
+
+        // 0.7, 2.1 & 4.2 round down to 0, 2 & 4, the 1 left goes to the oldest order
+        ASSERT_EQ(orderbook.AddIOC(OrderCommand{ 11, Side::Buy, 100, 7 }).filled_, 7);
+        ASSERT_EQ(remaining(orderbook, 1), 89);
+        ASSERT_EQ(remaining(orderbook, 2), 268);
+        ASSERT_EQ(remaining(orderbook, 3), 536);
+        ASSERT_EQ(orderbook.Checksum(), orderbook.RecomputeChecksum());
+
+        // Bigger than the level: everything fills, as with FIFO
+        ASSERT_EQ(orderbook.AddIOC(OrderCommand{ 12, Side::Buy, 100, 2'000 }).filled_, 893);
+        ASSERT_EQ(orderbook.Size(), 0);
+    }
+
+    // Shares below the minimum are dropped and go to the queue in time priority instead
+    config.matching_ = MatchingPolicy{ MatchingAlgorithm::ProRata, 3 };
+    {
+        Orderbook orderbook{ config };
+        orderbook.AddLimit(OrderCommand{ 1, Side::Buy, 100, 90 });
+        orderbook.AddLimit(OrderCommand{ 2, Side::Buy, 100, 270 });
+        orderbook.AddLimit(OrderCommand{ 3, Side::Buy, 100, 540 });
+        ASSERT_EQ(orderbook.AddIOC(OrderCommand{ 10, Side::Sell, 100, 7 }).filled_, 7);
+        ASSERT_EQ(remaining(orderbook, 1), 87);
+        ASSERT_EQ(remaining(orderbook, 2), 270);
+        ASSERT_EQ(remaining(orderbook, 3), 536);
+    }
+
+    // The top order first, the rest pro-rata
+    config.matching_ = MatchingPolicy{ MatchingAlgorithm::TopOrderProRata, 1 };
+    {
+        Orderbook orderbook{ config };
+        orderbook.AddLimit(OrderCommand{ 1, Side::Sell, 100, 100 });
+        orderbook.AddLimit(OrderCommand{ 2, Side::Sell, 100, 300 });
+        orderbook.AddLimit(OrderCommand{ 3, Side::Sell, 100, 600 });
+        ASSERT_EQ(orderbook.AddIOC(OrderCommand{ 10, Side::Buy, 100, 400 }).filled_, 400);
+        ASSERT_FALSE(orderbook.GetOrderStatus(1).has_value());
+        ASSERT_EQ(remaining(orderbook, 2), 200);
+        ASSERT_EQ(remaining(orderbook, 3), 400);
+    }
+
+    // The orders the leftover completes leave the queue, the survivors keep their place
+    config.matching_ = MatchingPolicy{ MatchingAlgorithm::ProRata, 1 };
+    {
+        Orderbook orderbook{ config };
+        for (OrderId id = 1; id <= 40; id++)
+            orderbook.AddLimit(OrderCommand{ id, Side::Sell, 100, 10 });
+
+        // 9.75 each rounds down to 9, the 30 left complete the first 30 orders
+        ASSERT_EQ(orderbook.AddIOC(OrderCommand{ 100, Side::Buy, 100, 390 }).filled_, 390);
+        ASSERT_EQ(orderbook.Size(), 10);
+        for (OrderId id = 31; id <= 40; id++)
         {
-            return OrderModify
+            ASSERT_EQ(remaining(orderbook, id), 1);
+            ASSERT_EQ(orderbook.GetOrderStatus(id)->ordersAhead_, id - 31);
+        }
+        ASSERT_EQ(orderbook.Checksum(), orderbook.RecomputeChecksum());
+        ASSERT_EQ(orderbook.Cancel(35), CommandStatus::Accepted);
+        ASSERT_EQ(orderbook.GetOrderStatus(40)->ordersAhead_, 8);
+    }
+}
+
+// A thousand clients awaiting their commands on two executor threads, each sees its own commands in order
+TEST(AsyncOrderbookTests, ClientsAwaitTheirCommands)
+{
+    Orderbook orderbook{ TestConfig() };
+    ThreadPool executor{ 2 };
+    std::atomic<int> failures{ 0 };
+    {
+        AsyncOrderbook book{ orderbook, executor };
+
+        // Every other client takes its order back, the second cancel finds nothing
+        auto client = [](AsyncOrderbook& book, OrderId orderId, std::atomic<int>& failures) -> AsyncTask
             {
-                action.orderId_,
-                action.side_,
-                action.price_,
-                action.quantity_,
+                const auto price = static_cast<Price>(100 + orderId % 5);
+                const auto added = co_await book.Submit(EntryRequest{ orderId, orderId, price, 10, Side::Sell, EntryRequestType::Limit });
+                if (added.response_.status_ != CommandStatus::Accepted || added.response_.resting_ != 10 || added.response_.clientSequence_ != orderId)
+                    failures++;
+
+                if (orderId % 2 == 0)
+                {
+                    const auto cancelled = co_await book.Cancel(orderId);
+                    const auto again = co_await book.Cancel(orderId);
+                    if (cancelled.response_.status_ != CommandStatus::Accepted || again.response_.status_ != CommandStatus::UnknownOrderId)
+                        failures++;
+                }
+            };
+
+        for (OrderId orderId = 1; orderId <= 1'000; orderId++)
+            book.Spawn(client(book, orderId, failures));
+        book.Wait();
+        ASSERT_EQ(failures, 0);
+        ASSERT_EQ(book.Executed(), 2'000);
+        ASSERT_EQ(orderbook.Size(), 500);
+
+        // An IOC through the first three orders at 100 gets its fills back with the ack
+        AsyncResult result;
+        auto taker = [](AsyncOrderbook& book, AsyncResult& result) -> AsyncTask
+            {
+                result = co_await book.Submit(EntryRequest{ 0, 5'000, 100, 25, Side::Buy, EntryRequestType::ImmediateOrCancel });
             };
+        book.Spawn(taker(book, result));
+        book.Wait();
+
+        ASSERT_EQ(result.response_.filled_, 25);
+        ASSERT_EQ(result.fills_.size(), 3);
+        ASSERT_EQ(result.fills_[0].contraPrice_, 100);
+        ASSERT_EQ(result.fills_[2].quantity_, 5);
+        ASSERT_EQ(result.fills_[2].remaining_, 0);
+    }
+    ASSERT_EQ(orderbook.Size(), 498);
+}
+
+// Every scenario converted to a feed, raw and in small compressed blocks, reads back as the same text
+TEST(RecordedFeedTests, ScenariosRoundTripThroughBothFormats)
+{
+    auto text = [](const Informations& actions)
+        {
+            std::ostringstream out;
+            for (const auto& action : actions)
+                ScenarioWriter::Write(out, action);
+            return out.str();
         };
 
-    // Act
-    Orderbook orderbook;
-    for (const auto& action : actions)
+    // Spelled as on disk, a name that doesn't match on a case sensitive filesystem would parse to nothing
+    std::vector<std::filesystem::path> scenarios;
+    for (const auto* name : { "Match_GoodTillCancel.txt", "Match_FillAndKill.txt", "Match_FillorKill_Hit.txt", "Match_FillorKill_Miss.txt",
+        "CanceL_Success.txt", "Modify_Side.txt", "Match_Market.txt" })
+        scenarios.push_back(OrderbookTestsFixture::TestFolderPath / name);
+
+    const auto generated = std::filesystem::temp_directory_path() / "RecordedFeedTests.txt";
     {
-        switch (action.type_)
+        std::ofstream file{ generated };
+        FlowGenerator{ FlowOptions{ .seed_ = 11 } }.WriteScenario(file, 10'000);
+    }
+    scenarios.push_back(generated);
+
+    const auto feed = std::filesystem::temp_directory_path() / "RecordedFeedTests.feed";
+    for (const auto& scenario : scenarios)
+    {
+        ASSERT_TRUE(std::filesystem::is_regular_file(scenario)) << scenario;
+        const auto [actions, expected] = InputHandler{ }.GetRecording(scenario);
+        ASSERT_FALSE(actions.empty()) << scenario;
+        for (const auto& options : { FeedOptions{ }, FeedOptions{ .compress_ = true, .blockRecords_ = 3 } })
         {
-            case ActionType::Add:
-            {
-                const Trades& trades = orderbook.AddOrder(GetOrder(action));
-            }
-            break;
-            case ActionType::Modify:
-            {
-                const Trades& trades = orderbook.ModifyOrder(GetOrderModify(action));
-            }
-            break;
-            case ActionType::Cancel:
+            ASSERT_EQ(FeedWriter::Convert(scenario, feed, options), actions.size());
+
+            const FeedReader reader{ feed };
+            ASSERT_EQ(reader.Compressed(), options.compress_);
+            ASSERT_EQ(reader.Records(), actions.size());
+            ASSERT_EQ(text(reader.ReadAll()), text(actions)) << scenario;
+
+            ASSERT_EQ(reader.Expected().has_value(), expected.has_value());
+            if (expected)
             {
-                orderbook.CancelOrder(action.orderId_);
+                ASSERT_EQ(reader.Expected()->allCount_, expected->allCount_);
+                ASSERT_EQ(reader.Expected()->bidCount_, expected->bidCount_);
+                ASSERT_EQ(reader.Expected()->askCount_, expected->askCount_);
             }
-            break;
-            default:
-                throw std::logic_error("Unsupported Action.");
         }
     }
 
-    // Assert
-    const auto& orderbookInfos = orderbook.GetOrderInfos();
-    ASSERT_EQ(orderbook.Size(), result.allCount_);
-    ASSERT_EQ(orderbookInfos.GetBids().size(), result.bidCount_);
-    ASSERT_EQ(orderbookInfos.GetAsks().size(), result.askCount_);
+    // A truncated feed is refused rather than replayed short
+    std::filesystem::resize_file(feed, std::filesystem::file_size(feed) - 1);
+    ASSERT_THROW(FeedReader{ feed }.ReadAll(), std::runtime_error);
+    std::filesystem::remove(feed);
+    std::filesystem::remove(generated);
 }
 
-// Argument: TestName, Test Fixture, Paramter
-INSTANTIATE_TEST_CASE_P(Tests, OrderbookTestsFixture, googletest::ValuesIn({
-    "Match_GoodTillCancel.txt",
-    "Match_FillAndKill.txt",
-    "Match_FillOrKill_Hit.txt",
-    "Match_FillOrKill_Miss.txt",
-    "Cancel_Success.txt",
-    "Modify_Side.txt",
-    "Match_Market.txt"
-    }));
+// Once its pool has grown to the flow, a book driven through the entry API never touches the heap
+TEST(AllocationTrackerTests, WarmEntryApiDoesNotAllocate)
+{
+    auto config = TestConfig();
+    config.recycleMemory_ = true;
+    Orderbook orderbook{ config };
+
+    // Generated up front, only the book runs while counting
+    FlowGenerator flow{ FlowOptions{ .seed_ = 5 } };
+    Informations warmup, measured;
+    for (int i = 0; i < 10'000; i++)
+        warmup.push_back(flow.NextResting(i % 2 ? Side::Sell : Side::Buy));
+    flow.Generate(1'000'000, [&warmup](const FlowMessage& message) { warmup.push_back(message.action_); });
+    flow.Generate(200'000, [&measured](const FlowMessage& message) { measured.push_back(message.action_); });
+
+    auto apply = [&orderbook](const Information& action)
+        {
+            const OrderCommand command{ action.orderId_, action.side_, action.price_, action.quantity_ };
+            if (action.type_ == ActionType::Cancel)
+                orderbook.Cancel(action.orderId_);
+            else if (action.type_ == ActionType::Modify)
+                orderbook.Modify(command);
+            else if (action.orderType_ == OrderType::Market)
+                orderbook.AddMarket(MarketCommand{ action.orderId_, action.side_, action.quantity_ });
+            else if (action.orderType_ == OrderType::FillAndKill)
+                orderbook.AddIOC(command);
+            else if (action.orderType_ == OrderType::FillOrKill)
+                orderbook.AddFOK(command);
+            else
+                orderbook.AddLimit(command);
+        };
+
+    AllocationTracker::Enable(true);
+    auto before = AllocationTracker::Snapshot();
+    for (const auto& action : warmup)
+        apply(action);
+    const auto warming = AllocationTracker::Snapshot() - before;
+
+    before = AllocationTracker::Snapshot();
+    for (const auto& action : measured)
+        apply(action);
+    const auto steady = AllocationTracker::Snapshot() - before;
+
+    // The tracker counts what it should: one allocation of at least the requested size
+    before = AllocationTracker::Snapshot();
+    ::operator delete(::operator new(100));
+    const auto probe = AllocationTracker::Snapshot() - before;
+    AllocationTracker::Enable(false);
+
+    ASSERT_GT(warming.allocations_, 0);
+    ASSERT_EQ(steady.allocations_, 0);
+    ASSERT_EQ(steady.deallocations_, 0);
+    ASSERT_EQ(probe.allocations_, 1);
+    ASSERT_EQ(probe.deallocations_, 1);
+    ASSERT_EQ(probe.bytes_, 100);
+    ASSERT_EQ(probe.liveBytes_, 0);
+}
+
+#if defined(__linux__)
+// The primary runs in a child process that gets killed mid stream, the backup takes over with exactly
+// the book the primary had after the last request that reached it
+TEST(ReplicationTests, BackupTakesOverWhenThePrimaryIsKilled)
+{
+    const auto path = std::filesystem::temp_directory_path() / ("OrderBookReplicationTest" + std::to_string(getpid()) + ".sock");
+    const auto config = TestConfig();
+    constexpr std::uint64_t Requests = 20'000'000;    // Far more than the primary gets through before it's killed
+    constexpr std::uint64_t KillAfter = 100'000;
+
+    const auto request = [](const Information& action, std::uint64_t sequence)
+        {
+            return ToEntryRequest(action, sequence, static_cast<AccountId>(action.orderId_ % 8));
+        };
+
+    Orderbook orderbook{ config };
+    ReplicationBackup backup{ orderbook, path };
+
+    const auto primaryProcess = fork();
+    ASSERT_GE(primaryProcess, 0);
+    if (primaryProcess == 0)
+    {
+        Orderbook primaryBook{ config };
+        ReplicationPrimary primary{ primaryBook, path };
+        FlowGenerator flow{ FlowOptions{ .seed_ = 9 } };
+        for (std::uint64_t sequence = 1; sequence <= Requests; sequence++)
+            primary.Execute(request(flow.Next().action_, sequence));
+        _exit(0);
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 60 };
+    while (backup.Sequence() < KillAfter && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+    kill(primaryProcess, SIGKILL);
+    waitpid(primaryProcess, nullptr, 0);
+
+    ASSERT_TRUE(backup.WaitForFailover(std::chrono::seconds{ 10 }));
+    ASSERT_FALSE(backup.Diverged());
+    const auto applied = backup.Sequence();
+    ASSERT_GE(applied, KillAfter);
+    ASSERT_LT(applied, Requests);
+
+    // The same requests replayed into a fresh book give the backup's book, level for level
+    Orderbook reference{ config };
+    FlowGenerator flow{ FlowOptions{ .seed_ = 9 } };
+    for (std::uint64_t sequence = 1; sequence <= applied; sequence++)
+        SharedMemoryEntryServer::Execute(reference, request(flow.Next().action_, sequence));
+
+    ASSERT_EQ(orderbook.Checksum(), reference.Checksum());
+    ASSERT_EQ(orderbook.Checksum(), orderbook.RecomputeChecksum());
+    ASSERT_EQ(orderbook.Size(), reference.Size());
+    const auto levels = orderbook.GetOrderInfos();
+    const auto expected = reference.GetOrderInfos();
+    ASSERT_EQ(levels.GetBids().size(), expected.GetBids().size());
+    ASSERT_EQ(levels.GetAsks().size(), expected.GetAsks().size());
+    for (std::size_t i = 0; i < levels.GetBids().size(); i++)
+    {
+        ASSERT_EQ(levels.GetBids()[i].price_, expected.GetBids()[i].price_);
+        ASSERT_EQ(levels.GetBids()[i].quantity_, expected.GetBids()[i].quantity_);
+    }
+
+    // Taking over: the backup's book carries on with the flow where the primary stopped
+    const auto next = request(flow.Next().action_, applied + 1);
+    SharedMemoryEntryServer::Execute(orderbook, next);
+    SharedMemoryEntryServer::Execute(reference, next);
+    ASSERT_EQ(orderbook.Checksum(), reference.Checksum());
+}
+#endif
 
 // Format: 
 // Action Side OrderType Price Quantity OrderId
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Side.h"
+#include "Usings.h"
+
+// Plain value commands of the allocation free entry API (Orderbook::AddLimit & co)
+// The book creates & owns the order, the caller never holds an OrderPointer
+struct OrderCommand
+{
+    OrderId orderId_;
+    Side side_;
+    Price price_;
+    Quantity quantity_;
+    AccountId account_{ };      // Ignored by Modify, a modified order stays with its account
+};
+
+struct MarketCommand
+{
+    OrderId orderId_;
+    Side side_;
+    Quantity quantity_;
+    AccountId account_{ };
+};
+
+// Why a command was or wasn't accepted, the entry API reports these instead of throwing
+enum class CommandStatus : std::uint8_t
+{
+    Accepted,           // Entered the book, whatever traded is in filled_ and what still rests in resting_
+    DuplicateOrderId,
+    UnknownOrderId,     // Cancel / modify of an order that isn't resting
+    InvalidPrice,
+    InvalidQuantity,
+    NoLiquidity,        // Market / IOC with nothing on the other side to trade against
+    CannotFullyFill,    // FOK that the book can't fill completely
+    CrossedQuotes,      // Quote set whose own bids reach its own asks
+
+    // Pre-trade risk rejects (see PreTradeRisk), the book is left exactly as it was
+    RiskOrderSize,      // Above the account's maximum order quantity
+    RiskPriceCollar,    // Too far through the opposite best price
+    RiskOpenQuantity,   // Would take the account's open quantity over its limit
+    RiskNotional,       // Would take the account's open notional over its limit
+    RiskUnknownAccount, // No limits for the account
+};
+
+struct CommandResult
+{
+    CommandStatus status_;
+    Quantity filled_{ };
+    Quantity resting_{ };
+};
+
+// One level of a market maker's quote set (Orderbook::ReplaceQuotes), its side is the list it's in
+// A quote keeps its id from one set to the next, that's how the book knows which levels didn't change
+struct Quote
+{
+    OrderId orderId_;
+    Price price_;
+    Quantity quantity_;
+};
+
+struct QuoteResult
+{
+    CommandStatus status_;
+    std::uint32_t kept_{ };         // Left resting as they were, time priority included
+    std::uint32_t added_{ };        // New & changed quotes that went in, a changed one goes to the back of its level
+    std::uint32_t cancelled_{ };    // Quotes of the previous set that were dropped or changed
+    std::uint32_t rejected_{ };     // Refused by the book after the set was accepted, 0 as validity & risk are checked on the whole set first
+    Quantity filled_{ };            // Traded by new quotes crossing the book
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+#include "OrderType.h"
+#include "Side.h"
+#include "Usings.h"
+
+// Where one resting order stands: its quantities and its place in the queue at its price
+// The queue position counts the live orders (and their remaining quantity) that will trade before it
+struct OrderStatus
+{
+    OrderId orderId_;
+    AccountId account_;
+    Side side_;
+    OrderType orderType_;
+    Price price_;
+    Quantity initialQuantity_;
+    Quantity remainingQuantity_;
+    Quantity filledQuantity_;
+    std::uint64_t ordersAhead_;
+    std::uint64_t quantityAhead_;
+};
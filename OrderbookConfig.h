@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+
+#include "MatchingPolicy.h"
+
+class HousekeepingScheduler;
+
+// Construction options of an Orderbook
+// The default values keep the original behaviour of the interactive demo (a prepopulated random book)
+struct OrderbookConfig
+{
+    // Fill the book with 10 random bids & 10 random asks on construction
+    // Replays and tests turn this off so that every book starts empty and deterministic
+    bool prepopulate_{ true };
+
+    // Cancel GoodForDay orders at the market close
+    // Replays are driven only by their input and don't want a wall clock expiry at all
+    bool expireGoodForDay_{ true };
+
+    // Shared scheduler running the expiry (and other periodic maintenance) for many books
+    // When it's null the book falls back to a prune thread of its own
+    HousekeepingScheduler* housekeeping_{ nullptr };
+
+    // Preallocated storage backing the orders (CreateOrder), the price levels and the id index
+    // 0 keeps everything on the regular heap
+    std::size_t arenaBytes_{ 0 };
+    bool hugePages_{ true };     // Back the arena with 2MB pages when the OS has some, normal pages otherwise
+    bool prefault_{ true };      // Touch the whole arena up front instead of faulting during trading
+
+    // Recycle the memory of orders, levels & the id index through a pool even without an arena
+    // With it the command API (AddLimit & co) doesn't touch the global heap once the book is warmed up
+    bool recycleMemory_{ false };
+
+    // Keep the human readable TransactionLog, every entry is a formatted string so latency sensitive books turn it off
+    bool transactionLog_{ true };
+
+    // Core of the thread driving the matching: the arena is bound to that core's NUMA node
+    // and BindMatchingThread pins its caller to it. -1 leaves scheduling & placement to the OS
+    int matchingCore_{ -1 };
+
+    // How an incoming order is allocated across a level, FIFO by default
+    MatchingPolicy matching_;
+};
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+// Hardware events we profile the engine with
+enum class PerfEvent : std::uint8_t
+{
+    Cycles,
+    Instructions,
+    L1DMisses,
+    LlcMisses,
+    BranchMisses,
+    DtlbMisses,
+};
+
+constexpr std::size_t PerfEventCount = 6;
+
+inline const char* PerfEventName(PerfEvent event)
+{
+    constexpr std::array<const char*, PerfEventCount> names{ "cycles", "instr", "L1D miss", "LLC miss", "br miss", "dTLB miss" };
+    return names[static_cast<std::size_t>(event)];
+}
+
+// What a group of operations cost, summed over all of them
+struct PerfTotals
+{
+    std::uint64_t count_{ };
+    std::uint64_t nanoseconds_{ };
+    std::array<std::uint64_t, PerfEventCount> events_{ };
+};
+
+// Counter totals per operation type (add / cancel / ...), mergeable across threads and files
+class PerfProfile
+{
+public:
+    PerfProfile() = default;
+    PerfProfile(std::vector<std::string> operations, std::array<bool, PerfEventCount> supported)
+        : operations_{ std::move(operations) }
+        , totals_(operations_.size())
+        , supported_{ supported }
+    { }
+
+    bool Empty() const { return operations_.empty(); }
+    PerfTotals& At(std::size_t operation) { return totals_[operation]; }
+
+    bool CountersAvailable() const
+    {
+        for (bool supported : supported_)
+            if (supported)
+                return true;
+        return false;
+    }
+
+    // Operations are matched by name, an event only stays reported if every merged profile could count it
+    void Merge(const PerfProfile& other)
+    {
+        if (other.Empty())
+            return;
+
+        if (Empty())
+        {
+            *this = other;
+            return;
+        }
+
+        for (std::size_t i = 0; i < PerfEventCount; i++)
+            supported_[i] = supported_[i] && other.supported_[i];
+
+        for (std::size_t theirs = 0; theirs < other.operations_.size(); theirs++)
+        {
+            std::size_t ours = 0;
+            while (ours < operations_.size() && operations_[ours] != other.operations_[theirs])
+                ours++;
+            if (ours == operations_.size())
+            {
+                operations_.push_back(other.operations_[theirs]);
+                totals_.emplace_back();
+            }
+
+            auto& total = totals_[ours];
+            const auto& add = other.totals_[theirs];
+            total.count_ += add.count_;
+            total.nanoseconds_ += add.nanoseconds_;
+            for (std::size_t i = 0; i < PerfEventCount; i++)
+                total.events_[i] += add.events_[i];
+        }
+    }
+
+    // One row per operation type with the cost of a single operation, then the whole run per million messages
+    void Print(std::ostream& out) const
+    {
+        if (Empty())
+            return;
+
+        out << (CountersAvailable() ? "\nPer operation:\n" : "\nPer operation (hardware counters unavailable, timing only):\n");
+        PrintHeader(out);
+
+        PerfTotals all;
+        for (std::size_t operation = 0; operation < operations_.size(); operation++)
+        {
+            const auto& total = totals_[operation];
+            PrintRow(out, operations_[operation], total, total.count_ ? 1.0 / total.count_ : 0.0);
+
+            all.count_ += total.count_;
+            all.nanoseconds_ += total.nanoseconds_;
+            for (std::size_t i = 0; i < PerfEventCount; i++)
+                all.events_[i] += total.events_[i];
+        }
+
+        out << "Per million messages:\n";
+        PrintHeader(out);
+        PrintRow(out, "all", all, all.count_ ? 1'000'000.0 / all.count_ : 0.0);
+    }
+
+private:
+    void PrintHeader(std::ostream& out) const
+    {
+        out << std::left << std::setw(10) << "op" << std::right << std::setw(12) << "count" << std::setw(14) << "ns";
+        for (std::size_t i = 0; i < PerfEventCount; i++)
+            if (supported_[i])
+                out << std::setw(14) << PerfEventName(static_cast<PerfEvent>(i));
+        out << '\n';
+    }
+
+    void PrintRow(std::ostream& out, const std::string& name, const PerfTotals& total, double scale) const
+    {
+        out << std::left << std::setw(10) << name << std::right << std::setw(12) << total.count_
+            << std::fixed << std::setprecision(scale < 1.0 ? 1 : 0) << std::setw(14) << total.nanoseconds_ * scale;
+        for (std::size_t i = 0; i < PerfEventCount; i++)
+            if (supported_[i])
+                out << std::setw(14) << total.events_[i] * scale;
+        out << '\n';
+    }
+
+    std::vector<std::string> operations_;
+    std::vector<PerfTotals> totals_;
+    std::array<bool, PerfEventCount> supported_{ };
+};
+
+// Hardware counters for the calling thread, user space only, opened as one group so a single read samples all of them
+// Needs Linux with perf_event_paranoid <= 2 (no special privilege for user space counting of our own thread)
+// Events the CPU / hypervisor doesn't expose are just left out, without any the profile falls back to timing only
+class PerfCounters
+{
+public:
+    PerfCounters()
+    {
+    #if defined(__linux__)
+        const std::array<std::pair<std::uint32_t, std::uint64_t>, PerfEventCount> events
+        { {
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+            { PERF_TYPE_HW_CACHE, CacheEvent(PERF_COUNT_HW_CACHE_L1D) },
+            { PERF_TYPE_HW_CACHE, CacheEvent(PERF_COUNT_HW_CACHE_LL) },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+            { PERF_TYPE_HW_CACHE, CacheEvent(PERF_COUNT_HW_CACHE_DTLB) },
+        } };
+
+        for (std::size_t i = 0; i < PerfEventCount; i++)
+        {
+            perf_event_attr attr{ };
+            attr.size = sizeof(attr);
+            attr.type = events[i].first;
+            attr.config = events[i].second;
+            attr.disabled = leader_ < 0;    // The group starts once everything is attached
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+
+            const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0));
+            if (fd < 0)
+                continue;
+
+            if (leader_ < 0)
+                leader_ = fd;
+            else
+                members_.push_back(fd);
+            slots_[opened_++] = i;
+            supported_[i] = true;
+        }
+
+        if (leader_ >= 0)
+        {
+            ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    #endif
+    }
+
+    ~PerfCounters()
+    {
+    #if defined(__linux__)
+        for (int fd : members_)
+            close(fd);
+        if (leader_ >= 0)
+            close(leader_);
+    #endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    void operator=(const PerfCounters&) = delete;
+
+    bool Available() const { return leader_ >= 0; }
+    const std::array<bool, PerfEventCount>& Supported() const { return supported_; }
+
+    // Runs function once and adds its cost to totals, returns the elapsed nanoseconds
+    // Timing sits inside the counter reads so it doesn't include them
+    template<typename Function>
+    std::uint64_t Measure(PerfTotals& totals, Function&& function)
+    {
+        std::array<std::uint64_t, PerfEventCount> before{ };
+        Read(before);
+        const auto start = std::chrono::steady_clock::now();
+
+        function();
+
+        const auto end = std::chrono::steady_clock::now();
+        std::array<std::uint64_t, PerfEventCount> after{ };
+        Read(after);
+
+        const auto nanoseconds = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        totals.count_++;
+        totals.nanoseconds_ += nanoseconds;
+        for (std::size_t i = 0; i < PerfEventCount; i++)
+            totals.events_[i] += after[i] - before[i];
+        return nanoseconds;
+    }
+
+private:
+#if defined(__linux__)
+    static constexpr std::uint64_t CacheEvent(std::uint64_t cache)
+    {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+#endif
+
+    void Read(std::array<std::uint64_t, PerfEventCount>& values) const
+    {
+    #if defined(__linux__)
+        if (leader_ < 0)
+            return;
+
+        // PERF_FORMAT_GROUP layout: number of events, then one value per event in the order they were opened
+        std::array<std::uint64_t, PerfEventCount + 1> buffer{ };
+        if (read(leader_, buffer.data(), sizeof(buffer)) <= 0)
+            return;
+
+        for (std::size_t i = 0; i < opened_ && i < buffer[0]; i++)
+            values[slots_[i]] = buffer[i + 1];
+    #else
+        (void)values;
+    #endif
+    }
+
+    int leader_{ -1 };
+    std::vector<int> members_;
+    std::array<std::size_t, PerfEventCount> slots_{ };
+    std::size_t opened_{ 0 };
+    std::array<bool, PerfEventCount> supported_{ };
+};
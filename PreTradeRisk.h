@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BookEvent.h"
+#include "OrderCommand.h"
+
+// An order as the risk check sees it, before the book has touched anything
+struct RiskOrder
+{
+    OrderId orderId_;
+    AccountId account_;
+    Side side_;
+    OrderType orderType_;
+    Price price_;                   // For a market order the far end of the other side, its worst case
+    Quantity quantity_;
+    Quantity replacedQuantity_;     // Modify: what the order it replaces still has open, so it isn't counted twice
+    Price replacedPrice_;
+    std::optional<Price> bestBid_;
+    std::optional<Price> bestAsk_;
+};
+
+// Pre-trade stage the book runs before accepting an order: attach it with Orderbook::SetPreTradeCheck
+// Check runs under the book's lock before anything is inserted, anything but Accepted rejects the order
+// with the book untouched. OnExposure gets every add / fill / cancel (quantity is what entered or left the book)
+// straight from the book, without building a BookEvent, to keep exposure current
+// CheckSet takes a market maker's whole quote set at once (Orderbook::ReplaceQuotes): every quote going in
+// and, with a quantity of 0 and only the replaced fields, every resting quote it cancels. The set is judged
+// by the exposure it leaves behind, anything but Accepted turns all of it down
+class PreTradeCheck
+{
+public:
+    virtual ~PreTradeCheck() = default;
+    virtual CommandStatus Check(const RiskOrder& order) noexcept = 0;
+    virtual CommandStatus CheckSet(std::span<const RiskOrder> orders) noexcept = 0;
+    virtual void OnExposure(BookEventType type, AccountId account, Price price, Quantity quantity) noexcept = 0;
+};
+
+struct RiskLimits
+{
+    Quantity maxOrderQuantity_{ std::numeric_limits<Quantity>::max() };
+    Price priceCollar_{ std::numeric_limits<Price>::max() };    // How far a buy may go above the best ask (a sell below the best bid)
+    std::uint64_t maxOpenQuantity_{ std::numeric_limits<std::uint64_t>::max() };  // Resting quantity over every order of the account
+    std::int64_t maxOpenNotional_{ std::numeric_limits<std::int64_t>::max() };    // Resting price * quantity
+};
+
+struct AccountExposure
+{
+    std::uint64_t openQuantity_{ };
+    std::int64_t openNotional_{ };
+};
+
+// Per account limits with exposure counters kept up to date from the book's add / fill / cancel
+// Accounts are dense ids below maxAccounts living in a flat array, a check is one index and four comparisons
+// and never takes a lock: the book already serializes Check and OnExposure under its own lock, so one instance
+// serves one book. Limits and exposure are atomics so other threads can change / read them at any time
+class PreTradeRisk : public PreTradeCheck
+{
+public:
+    explicit PreTradeRisk(const RiskLimits& defaults = { }, AccountId maxAccounts = 1'024)
+        : accounts_(maxAccounts)
+    {
+        for (AccountId account = 0; account < maxAccounts; account++)
+            SetLimits(account, defaults);
+    }
+
+    // Each limit is picked up by the next check on its own
+    void SetLimits(AccountId account, const RiskLimits& limits)
+    {
+        if (account >= accounts_.size())
+            throw std::out_of_range("Account " + std::to_string(account) + " is beyond the risk's account range");
+
+        auto& entry = accounts_[account];
+        entry.maxOrderQuantity_.store(limits.maxOrderQuantity_, std::memory_order_relaxed);
+        entry.priceCollar_.store(limits.priceCollar_, std::memory_order_relaxed);
+        entry.maxOpenQuantity_.store(limits.maxOpenQuantity_, std::memory_order_relaxed);
+        entry.maxOpenNotional_.store(limits.maxOpenNotional_, std::memory_order_relaxed);
+    }
+
+    AccountExposure Exposure(AccountId account) const
+    {
+        if (account >= accounts_.size())
+            return AccountExposure{ };
+
+        const auto& entry = accounts_[account];
+        return AccountExposure{ entry.openQuantity_.load(std::memory_order_relaxed), entry.openNotional_.load(std::memory_order_relaxed) };
+    }
+
+    CommandStatus Check(const RiskOrder& order) noexcept override
+    {
+        if (order.account_ >= accounts_.size())
+            return CommandStatus::RiskUnknownAccount;
+        const auto& account = accounts_[order.account_];
+
+        if (const auto status = CheckOrder(account, order); status != CommandStatus::Accepted)
+            return status;
+        return CheckOpen(account, static_cast<std::int64_t>(order.quantity_) - order.replacedQuantity_,
+            Notional(order.price_, order.quantity_) - Notional(order.replacedPrice_, order.replacedQuantity_));
+    }
+
+    // Every order of a set belongs to the same account (the quoting session)
+    CommandStatus CheckSet(std::span<const RiskOrder> orders) noexcept override
+    {
+        if (orders.empty())
+            return CommandStatus::Accepted;
+        if (orders.front().account_ >= accounts_.size())
+            return CommandStatus::RiskUnknownAccount;
+        const auto& account = accounts_[orders.front().account_];
+
+        std::int64_t quantity{ 0 }, notional{ 0 };
+        for (const auto& order : orders)
+        {
+            // What is only cancelled has nothing to check on its own
+            if (order.quantity_ > 0)
+            {
+                if (const auto status = CheckOrder(account, order); status != CommandStatus::Accepted)
+                    return status;
+            }
+            quantity += static_cast<std::int64_t>(order.quantity_) - order.replacedQuantity_;
+            notional += Notional(order.price_, order.quantity_) - Notional(order.replacedPrice_, order.replacedQuantity_);
+        }
+        return CheckOpen(account, quantity, notional);
+    }
+
+    // Always the price the order rests at, so adds and removals use the same price
+    // Orders that were resting before the risk was attached may be out of range, they're not tracked
+    void OnExposure(BookEventType type, AccountId account, Price price, Quantity quantity) noexcept override
+    {
+        if (account >= accounts_.size())
+            return;
+
+        // Single writer (the book's lock), a load & store is enough
+        auto& entry = accounts_[account];
+        const auto sign = type == BookEventType::Add ? 1 : -1;
+        entry.openQuantity_.store(entry.openQuantity_.load(std::memory_order_relaxed) + sign * static_cast<std::int64_t>(quantity), std::memory_order_relaxed);
+        entry.openNotional_.store(entry.openNotional_.load(std::memory_order_relaxed) + sign * Notional(price, quantity), std::memory_order_relaxed);
+    }
+
+private:
+    // A cache line per account, the readers of one account never disturb another
+    struct alignas(64) Account
+    {
+        std::atomic<Quantity> maxOrderQuantity_;
+        std::atomic<Price> priceCollar_;
+        std::atomic<std::uint64_t> maxOpenQuantity_;
+        std::atomic<std::int64_t> maxOpenNotional_;
+        std::atomic<std::uint64_t> openQuantity_{ 0 };
+        std::atomic<std::int64_t> openNotional_{ 0 };
+    };
+
+    static std::int64_t Notional(Price price, Quantity quantity)
+    {
+        return static_cast<std::int64_t>(price) * quantity;
+    }
+
+    // The limits on the order alone
+    static CommandStatus CheckOrder(const Account& account, const RiskOrder& order) noexcept
+    {
+        if (order.quantity_ > account.maxOrderQuantity_.load(std::memory_order_relaxed))
+            return CommandStatus::RiskOrderSize;
+
+        // Market orders have no price of their own to collar
+        if (order.orderType_ != OrderType::Market)
+        {
+            const std::int64_t collar = account.priceCollar_.load(std::memory_order_relaxed);
+            if (order.side_ == Side::Buy && order.bestAsk_ && static_cast<std::int64_t>(order.price_) - *order.bestAsk_ > collar)
+                return CommandStatus::RiskPriceCollar;
+            if (order.side_ == Side::Sell && order.bestBid_ && static_cast<std::int64_t>(*order.bestBid_) - order.price_ > collar)
+                return CommandStatus::RiskPriceCollar;
+        }
+        return CommandStatus::Accepted;
+    }
+
+    // The account's open totals once the change is in, replaced orders already netted out of it
+    static CommandStatus CheckOpen(const Account& account, std::int64_t quantity, std::int64_t notional) noexcept
+    {
+        const auto openQuantity = account.openQuantity_.load(std::memory_order_relaxed) + static_cast<std::uint64_t>(quantity);
+        if (openQuantity > account.maxOpenQuantity_.load(std::memory_order_relaxed))
+            return CommandStatus::RiskOpenQuantity;
+
+        const auto openNotional = account.openNotional_.load(std::memory_order_relaxed) + notional;
+        if (openNotional > account.maxOpenNotional_.load(std::memory_order_relaxed))
+            return CommandStatus::RiskNotional;
+
+        return CommandStatus::Accepted;
+    }
+
+    std::vector<Account> accounts_;
+};
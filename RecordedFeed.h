@@ -0,0 +1,305 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Scenario.h"
+
+// Binary form of a scenario file / recorded session, replayed without parsing a thing
+//
+//     header | records                       (raw)
+//     header | block | block | ... | block   (compressed)
+//
+// A raw feed is the fixed size records back to back, the reader maps the file and hands them out in place
+// A compressed block is a FeedBlock followed by its records packed one after the other: a byte of type, side
+// & order type, then varints of the order id & price as deltas from the previous record and of the quantity
+// Fields the text format doesn't carry (the price of a cancel, the order type of a modify) are stored as 0,
+// so a scenario converted and written back with ScenarioWriter is the same text
+struct FeedFile
+{
+    static constexpr std::uint64_t Magic = 0x314445464B4F4F42; // "BOOKFED1"
+    static constexpr std::uint32_t Version = 1;                 // Schema of FeedRecord & of the packed records
+    static constexpr std::uint32_t Compressed = 1;              // FeedHeader::flags_
+    static constexpr const char* Extension = ".feed";
+
+    static bool Is(const std::filesystem::path& path) { return path.extension() == Extension; }
+};
+
+struct FeedHeader
+{
+    std::uint64_t magic_;
+    std::uint32_t version_;
+    std::uint32_t flags_;
+    std::uint64_t records_;
+    std::uint32_t blockRecords_;    // Records per compressed block
+    std::uint32_t hasResult_;       // The scenario ended with an R line
+    std::uint64_t allCount_;
+    std::uint64_t bidCount_;
+    std::uint64_t askCount_;
+    std::uint64_t reserved_;
+};
+
+static_assert(sizeof(FeedHeader) == 64);
+
+// One action, little endian like the rest of our binary files
+struct FeedRecord
+{
+    OrderId orderId_;
+    Price price_;
+    Quantity quantity_;
+    std::uint8_t type_;         // ActionType
+    std::uint8_t side_;
+    std::uint8_t orderType_;
+    std::uint8_t reserved_[5];
+
+    static FeedRecord From(const Information& action)
+    {
+        FeedRecord record{ };
+        record.orderId_ = action.orderId_;
+        record.type_ = static_cast<std::uint8_t>(action.type_);
+        if (action.type_ == ActionType::Cancel)
+            return record;
+
+        record.price_ = action.price_;
+        record.quantity_ = action.quantity_;
+        record.side_ = static_cast<std::uint8_t>(action.side_);
+        if (action.type_ == ActionType::Add)
+            record.orderType_ = static_cast<std::uint8_t>(action.orderType_);
+        return record;
+    }
+
+    Information ToInformation() const
+    {
+        return Information{ static_cast<ActionType>(type_), static_cast<OrderType>(orderType_), static_cast<Side>(side_), price_, quantity_, orderId_ };
+    }
+};
+
+static_assert(sizeof(FeedRecord) == 24);
+
+struct FeedBlock
+{
+    std::uint32_t records_;
+    std::uint32_t bytes_;       // Of the packed records that follow
+};
+
+struct FeedOptions
+{
+    bool compress_{ false };
+    std::uint32_t blockRecords_{ 4'096 };
+};
+
+// Converter side: a whole scenario is written at once
+struct FeedWriter
+{
+    // Returns the number of records written
+    static std::uint64_t Convert(const std::filesystem::path& scenario, const std::filesystem::path& feed, const FeedOptions& options = { })
+    {
+        const auto [actions, expected] = InputHandler{ }.GetRecording(scenario);
+        Write(feed, actions, expected, options);
+        return actions.size();
+    }
+
+    static void Write(const std::filesystem::path& path, const Informations& actions, const std::optional<Result>& expected, const FeedOptions& options = { })
+    {
+        std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+        if (!file)
+            throw std::runtime_error("Cannot open feed " + path.string());
+
+        FeedHeader header{ FeedFile::Magic, FeedFile::Version, options.compress_ ? FeedFile::Compressed : 0, actions.size(),
+            options.blockRecords_ == 0 ? 1 : options.blockRecords_, expected.has_value(), 0, 0, 0, 0 };
+        if (expected)
+        {
+            header.allCount_ = expected->allCount_;
+            header.bidCount_ = expected->bidCount_;
+            header.askCount_ = expected->askCount_;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        if (!options.compress_)
+        {
+            std::vector<FeedRecord> records;
+            records.reserve(actions.size());
+            for (const auto& action : actions)
+                records.push_back(FeedRecord::From(action));
+            file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(FeedRecord));
+        }
+        else
+        {
+            std::vector<std::uint8_t> packed;
+            for (std::size_t first = 0; first < actions.size(); first += header.blockRecords_)
+            {
+                const auto count = std::min<std::size_t>(header.blockRecords_, actions.size() - first);
+                Pack(actions.data() + first, count, packed);
+
+                const FeedBlock block{ static_cast<std::uint32_t>(count), static_cast<std::uint32_t>(packed.size()) };
+                file.write(reinterpret_cast<const char*>(&block), sizeof(block));
+                file.write(reinterpret_cast<const char*>(packed.data()), packed.size());
+            }
+        }
+
+        if (!file.flush())
+            throw std::runtime_error("Cannot write feed " + path.string());
+    }
+
+private:
+    // Every block starts from 0 so it can be unpacked on its own
+    static void Pack(const Information* actions, std::size_t count, std::vector<std::uint8_t>& out)
+    {
+        out.clear();
+        FeedRecord previous{ };
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const auto record = FeedRecord::From(actions[i]);
+            out.push_back(static_cast<std::uint8_t>(record.type_ | record.side_ << 2 | record.orderType_ << 3));
+            PutVarint(out, ZigZag(static_cast<std::int64_t>(record.orderId_ - previous.orderId_)));
+            if (record.type_ != static_cast<std::uint8_t>(ActionType::Cancel))
+            {
+                PutVarint(out, ZigZag(static_cast<std::int64_t>(record.price_) - previous.price_));
+                PutVarint(out, record.quantity_);
+                previous.price_ = record.price_;
+            }
+            previous.orderId_ = record.orderId_;
+        }
+    }
+
+    static std::uint64_t ZigZag(std::int64_t value) { return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63); }
+
+    static void PutVarint(std::vector<std::uint8_t>& out, std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<std::uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<std::uint8_t>(value));
+    }
+};
+
+// Reader side: maps the feed, a raw one is read in place and a compressed one a block at a time
+class FeedReader
+{
+public:
+    explicit FeedReader(const std::filesystem::path& path)
+        : file_{ path }
+    {
+        if (file_.Size() < sizeof(header_))
+            throw std::runtime_error("Not a feed " + path.string());
+
+        std::memcpy(&header_, file_.Data(), sizeof(header_));
+        if (header_.magic_ != FeedFile::Magic)
+            throw std::runtime_error("Not a feed " + path.string());
+        if (header_.version_ != FeedFile::Version)
+            throw std::runtime_error("Feed " + path.string() + " has schema version " + std::to_string(header_.version_) + ", expected " + std::to_string(FeedFile::Version));
+        if (!Compressed() && file_.Size() != sizeof(header_) + header_.records_ * sizeof(FeedRecord))
+            throw std::runtime_error("Truncated feed " + path.string());
+    }
+
+    const FeedHeader& Header() const { return header_; }
+    std::uint64_t Records() const { return header_.records_; }
+    bool Compressed() const { return header_.flags_ & FeedFile::Compressed; }
+
+    std::optional<Result> Expected() const
+    {
+        if (!header_.hasResult_)
+            return std::nullopt;
+        return Result{ header_.allCount_, header_.bidCount_, header_.askCount_ };
+    }
+
+    // visit(const FeedRecord&) for every record in order
+    template<typename Visit>
+    void ForEach(Visit&& visit) const
+    {
+        const auto* data = file_.Data() + sizeof(header_);
+        if (!Compressed())
+        {
+            const auto* records = reinterpret_cast<const FeedRecord*>(data);
+            for (std::uint64_t i = 0; i < header_.records_; i++)
+                visit(records[i]);
+            return;
+        }
+
+        const auto* end = file_.Data() + file_.Size();
+        std::uint64_t read{ 0 };
+        while (read < header_.records_)
+        {
+            FeedBlock block;
+            if (end - data < static_cast<std::ptrdiff_t>(sizeof(block)))
+                throw std::runtime_error("Truncated feed block");
+            std::memcpy(&block, data, sizeof(block));
+            data += sizeof(block);
+            if (end - data < static_cast<std::ptrdiff_t>(block.bytes_) || block.records_ > header_.records_ - read)
+                throw std::runtime_error("Truncated feed block");
+
+            Unpack(data, data + block.bytes_, block.records_, visit);
+            data += block.bytes_;
+            read += block.records_;
+        }
+    }
+
+    Informations ReadAll() const
+    {
+        Informations actions;
+        actions.reserve(header_.records_);
+        ForEach([&actions](const FeedRecord& record) { actions.push_back(record.ToInformation()); });
+        return actions;
+    }
+
+private:
+    template<typename Visit>
+    static void Unpack(const std::uint8_t* data, const std::uint8_t* end, std::uint32_t count, Visit& visit)
+    {
+        FeedRecord record{ };
+        for (std::uint32_t i = 0; i < count; i++)
+        {
+            if (data == end)
+                throw std::runtime_error("Truncated feed block");
+            const auto tag = *data++;
+            record.type_ = tag & 0x3;
+            record.side_ = tag >> 2 & 0x1;
+            record.orderType_ = tag >> 3 & 0x7;
+            record.orderId_ += static_cast<OrderId>(UnZigZag(GetVarint(data, end)));
+            if (record.type_ != static_cast<std::uint8_t>(ActionType::Cancel))
+            {
+                record.price_ = static_cast<Price>(record.price_ + UnZigZag(GetVarint(data, end)));
+                record.quantity_ = static_cast<Quantity>(GetVarint(data, end));
+                visit(record);
+            }
+            else
+            {
+                // The price carries on to the next record's delta, a cancel itself has none
+                auto cancel = record;
+                cancel.price_ = 0;
+                cancel.quantity_ = 0;
+                visit(cancel);
+            }
+        }
+    }
+
+    static std::int64_t UnZigZag(std::uint64_t value) { return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1); }
+
+    static std::uint64_t GetVarint(const std::uint8_t*& data, const std::uint8_t* end)
+    {
+        std::uint64_t value{ 0 };
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (data == end)
+                throw std::runtime_error("Truncated feed block");
+            const auto byte = *data++;
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("Corrupt feed block");
+    }
+
+    MappedFile file_;
+    FeedHeader header_{ };
+};
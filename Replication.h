@@ -0,0 +1,461 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "OrderBook.h"
+#include "SharedMemoryEntry.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+// One input request as the primary ran it, in the order it ran them
+struct ReplicationRecord
+{
+    std::uint64_t sequence_;    // 1 for the first request of the primary
+    std::uint64_t checksum_;    // BookChecksum of the primary's book after the request, the backup has to land on the same
+    EntryRequest request_;
+};
+
+// Backup to primary, once per batch it applied
+struct ReplicationAck
+{
+    std::uint64_t sequence_;    // Last record applied
+    std::uint64_t diverged_;    // Non zero once a record left the backup's book on another checksum than the primary's
+};
+
+// Connected Unix domain stream socket (or a listening one), closed when it goes away
+// POSIX only for now, opening one throws on Windows
+class ReplicationSocket
+{
+public:
+    ReplicationSocket() = default;
+
+    ReplicationSocket(ReplicationSocket&& other) noexcept
+        : fd_{ other.fd_ }
+    {
+        other.fd_ = -1;
+    }
+
+    ReplicationSocket& operator=(ReplicationSocket&& other) noexcept
+    {
+        std::swap(fd_, other.fd_);
+        return *this;
+    }
+
+    ~ReplicationSocket()
+    {
+    #if !defined(_WIN32) && !defined(_WIN64)
+        if (fd_ >= 0)
+            close(fd_);
+    #endif
+    }
+
+    ReplicationSocket(const ReplicationSocket&) = delete;
+    void operator=(const ReplicationSocket&) = delete;
+
+    bool Valid() const { return fd_ >= 0; }
+
+    // Replaces a socket file a dead process may have left behind
+    static ReplicationSocket Listen(const std::filesystem::path& path)
+    {
+    #if defined(_WIN32) || defined(_WIN64)
+        throw std::runtime_error("Replication needs Unix domain sockets, not available on this platform");
+    #else
+        std::filesystem::remove(path);
+        const auto address = Address(path);
+
+        ReplicationSocket socket{ ::socket(AF_UNIX, SOCK_STREAM, 0) };
+        if (!socket.Valid()
+            || bind(socket.fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+            || listen(socket.fd_, 1) != 0)
+            throw std::runtime_error("Cannot listen on " + path.string());
+        return socket;
+    #endif
+    }
+
+    // Retries until the other side listens or timeout runs out
+    static ReplicationSocket Connect(const std::filesystem::path& path, std::chrono::milliseconds timeout)
+    {
+    #if defined(_WIN32) || defined(_WIN64)
+        throw std::runtime_error("Replication needs Unix domain sockets, not available on this platform");
+    #else
+        const auto address = Address(path);
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true)
+        {
+            ReplicationSocket socket{ ::socket(AF_UNIX, SOCK_STREAM, 0) };
+            if (socket.Valid() && connect(socket.fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0)
+                return socket;
+            if (std::chrono::steady_clock::now() >= deadline)
+                throw std::runtime_error("Cannot connect to " + path.string());
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+        }
+    #endif
+    }
+
+    // Invalid once the listening socket was shut down
+    ReplicationSocket Accept() const
+    {
+    #if defined(_WIN32) || defined(_WIN64)
+        return ReplicationSocket{ };
+    #else
+        int fd;
+        do
+            fd = accept(fd_, nullptr, nullptr);
+        while (fd < 0 && errno == EINTR);
+        return ReplicationSocket{ fd };
+    #endif
+    }
+
+    // All of it or false, a peer that went away doesn't raise SIGPIPE
+    bool Send(const void* data, std::size_t size) const
+    {
+    #if !defined(_WIN32) && !defined(_WIN64)
+        const auto* bytes = static_cast<const char*>(data);
+        while (size > 0)
+        {
+            const auto sent = send(fd_, bytes, size, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+                return false;
+            bytes += sent;
+            size -= static_cast<std::size_t>(sent);
+        }
+        return true;
+    #else
+        return false;
+    #endif
+    }
+
+    // Whatever arrived, up to size bytes. 0 when the peer closed, negative on error
+    std::ptrdiff_t Receive(void* data, std::size_t size) const
+    {
+    #if !defined(_WIN32) && !defined(_WIN64)
+        while (true)
+        {
+            const auto received = recv(fd_, data, size, 0);
+            if (received >= 0 || errno != EINTR)
+                return received;
+        }
+    #else
+        return -1;
+    #endif
+    }
+
+    // Wakes a thread blocked in Accept or Receive on this socket, the peer sees the end of the stream
+    void Shutdown() const
+    {
+    #if !defined(_WIN32) && !defined(_WIN64)
+        if (fd_ >= 0)
+            shutdown(fd_, SHUT_RDWR);
+    #endif
+    }
+
+private:
+    explicit ReplicationSocket(int fd)
+        : fd_{ fd }
+    { }
+
+#if !defined(_WIN32) && !defined(_WIN64)
+    static sockaddr_un Address(const std::filesystem::path& path)
+    {
+        sockaddr_un address{ };
+        address.sun_family = AF_UNIX;
+        const auto name = path.string();
+        if (name.size() >= sizeof(address.sun_path))
+            throw std::runtime_error("Socket path too long " + name);
+        std::memcpy(address.sun_path, name.c_str(), name.size() + 1);
+        return address;
+    }
+#endif
+
+    int fd_{ -1 };
+};
+
+// Primary side of a hot standby: runs every request on its own book and streams it to a ReplicationBackup
+// Execute never waits on the backup and never makes a system call, it only appends the request to the open batch.
+// A sender thread wakes every flushInterval and ships whatever piled up in one write while the next batch fills,
+// so matching latency only pays for the append and the backup trails by about one interval
+// Replication is asynchronous: a primary dying loses the requests the backup hadn't received yet,
+// ReplicatedSequence / WaitReplicated tell how far the backup is before acknowledging something outside
+// One thread executes, the book must not be changed by anything else while the primary runs
+class ReplicationPrimary
+{
+public:
+    ReplicationPrimary(Orderbook& orderbook, const std::filesystem::path& path,
+        std::chrono::microseconds flushInterval = std::chrono::microseconds{ 50 }, std::chrono::milliseconds connectTimeout = std::chrono::seconds{ 5 })
+        : orderbook_{ orderbook }
+        , socket_{ ReplicationSocket::Connect(path, connectTimeout) }
+        , flushInterval_{ flushInterval }
+    {
+        open_.reserve(4'096);
+        sender_ = std::thread{ [this] { SendLoop(); } };
+        receiver_ = std::thread{ [this] { ReceiveLoop(); } };
+    }
+
+    // Ships what's still open, the backup then sees the end of the stream (a clean failover point)
+    ~ReplicationPrimary()
+    {
+        {
+            std::scoped_lock lock{ mutex_ };
+            shutdown_ = true;
+        }
+        sender_.join();
+
+        socket_.Shutdown();
+        receiver_.join();
+    }
+
+    ReplicationPrimary(const ReplicationPrimary&) = delete;
+    void operator=(const ReplicationPrimary&) = delete;
+
+    EntryResponse Execute(const EntryRequest& request)
+    {
+        const auto response = SharedMemoryEntryServer::Execute(orderbook_, request);
+        const ReplicationRecord record{ sequence_.load(std::memory_order_relaxed) + 1, orderbook_.Checksum(), request };
+        sequence_.store(record.sequence_, std::memory_order_release);
+
+        {
+            // Waking the sender here would cost a futex call for nearly every request, it polls instead
+            std::scoped_lock lock{ mutex_ };
+            open_.push_back(record);
+        }
+        return response;
+    }
+
+    // Last request executed
+    std::uint64_t Sequence() const { return sequence_.load(std::memory_order_acquire); }
+
+    // Last request the backup confirmed it applied
+    std::uint64_t ReplicatedSequence() const { return replicated_.load(std::memory_order_acquire); }
+
+    // False once the backup lost sequence, the standby is no good then
+    bool Diverged() const { return diverged_.load(std::memory_order_acquire); }
+    bool Connected() const { return connected_.load(std::memory_order_acquire); }
+
+    // Waits until the backup applied sequence, false on timeout or when the backup went away
+    bool WaitReplicated(std::uint64_t sequence, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock lock{ ackMutex_ };
+        return acked_.wait_for(lock, timeout, [&] { return ReplicatedSequence() >= sequence || !Connected(); })
+            && ReplicatedSequence() >= sequence;
+    }
+
+private:
+    void SendLoop()
+    {
+        std::vector<ReplicationRecord> batch;
+        batch.reserve(open_.capacity());
+
+        while (true)
+        {
+            bool shutdown;
+            {
+                std::scoped_lock lock{ mutex_ };
+                shutdown = shutdown_;
+                batch.swap(open_);
+            }
+
+            if (batch.empty())
+            {
+                if (shutdown)
+                    return;
+                std::this_thread::sleep_for(flushInterval_);
+                continue;
+            }
+
+            // A backup that went away only stops the replication, the primary keeps matching
+            if (Connected() && !socket_.Send(batch.data(), batch.size() * sizeof(ReplicationRecord)))
+                Disconnected();
+            batch.clear();
+        }
+    }
+
+    void ReceiveLoop()
+    {
+        ReplicationAck ack;
+        std::size_t filled = 0;
+        while (true)
+        {
+            const auto received = socket_.Receive(reinterpret_cast<char*>(&ack) + filled, sizeof(ack) - filled);
+            if (received <= 0)
+                break;
+
+            filled += static_cast<std::size_t>(received);
+            if (filled < sizeof(ack))
+                continue;
+            filled = 0;
+
+            {
+                std::scoped_lock lock{ ackMutex_ };
+                replicated_.store(ack.sequence_, std::memory_order_release);
+                if (ack.diverged_)
+                    diverged_.store(true, std::memory_order_release);
+            }
+            acked_.notify_all();
+        }
+        Disconnected();
+    }
+
+    void Disconnected()
+    {
+        {
+            std::scoped_lock lock{ ackMutex_ };
+            connected_.store(false, std::memory_order_release);
+        }
+        acked_.notify_all();
+    }
+
+    Orderbook& orderbook_;
+    ReplicationSocket socket_;
+    const std::chrono::microseconds flushInterval_;
+    std::atomic<std::uint64_t> sequence_{ 0 };
+
+    // Batch being filled by Execute, swapped out whole by the sender
+    std::mutex mutex_;
+    std::vector<ReplicationRecord> open_;
+    bool shutdown_{ false };
+
+    std::mutex ackMutex_;
+    std::condition_variable acked_;
+    std::atomic<std::uint64_t> replicated_{ 0 };
+    std::atomic<bool> diverged_{ false };
+    std::atomic<bool> connected_{ true };
+
+    std::thread sender_;
+    std::thread receiver_;
+};
+
+// Backup side: listens on path for one primary and applies its requests, in order, to its own book
+// The book is deterministic, the same requests in the same order give the same book, and every record carries the
+// primary's checksum to prove it. Acks go back once per received batch. When the connection ends (the primary
+// died or shut down) everything received has been applied, WaitForFailover returns and the book is the caller's
+class ReplicationBackup
+{
+public:
+    ReplicationBackup(Orderbook& orderbook, const std::filesystem::path& path)
+        : orderbook_{ orderbook }
+        , path_{ path }
+        , listener_{ ReplicationSocket::Listen(path) }
+    {
+        receiver_ = std::thread{ [this] { ReceiveLoop(); } };
+    }
+
+    ~ReplicationBackup()
+    {
+        listener_.Shutdown();
+        {
+            std::scoped_lock lock{ mutex_ };
+            stopping_ = true;
+            connection_.Shutdown();
+        }
+        receiver_.join();
+        std::filesystem::remove(path_);
+    }
+
+    ReplicationBackup(const ReplicationBackup&) = delete;
+    void operator=(const ReplicationBackup&) = delete;
+
+    // Last record applied
+    std::uint64_t Sequence() const { return sequence_.load(std::memory_order_acquire); }
+    bool Diverged() const { return diverged_.load(std::memory_order_acquire); }
+
+    // True once the primary is gone and the backup stopped applying, false on timeout
+    bool WaitForFailover(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock lock{ mutex_ };
+        return primaryLost_.wait_for(lock, timeout, [this] { return lost_; });
+    }
+
+private:
+    void ReceiveLoop()
+    {
+        auto connection = listener_.Accept();
+        {
+            // A primary accepted just as the backup is being destroyed must not keep the loop waiting
+            std::scoped_lock lock{ mutex_ };
+            connection_ = std::move(connection);
+            if (stopping_)
+                connection_.Shutdown();
+        }
+
+        // Records can straddle two reads, a partial one waits at the front of the buffer for the rest
+        std::vector<char> buffer(1'024 * sizeof(ReplicationRecord));
+        std::size_t filled = 0;
+        while (connection_.Valid())
+        {
+            const auto received = connection_.Receive(buffer.data() + filled, buffer.size() - filled);
+            if (received <= 0)
+                break;
+            filled += static_cast<std::size_t>(received);
+
+            const auto complete = filled / sizeof(ReplicationRecord);
+            for (std::size_t i = 0; i < complete; i++)
+            {
+                ReplicationRecord record;
+                std::memcpy(&record, buffer.data() + i * sizeof(ReplicationRecord), sizeof(ReplicationRecord));
+                Apply(record);
+            }
+
+            const auto consumed = complete * sizeof(ReplicationRecord);
+            std::memmove(buffer.data(), buffer.data() + consumed, filled - consumed);
+            filled -= consumed;
+
+            if (complete > 0)
+            {
+                const ReplicationAck ack{ Sequence(), Diverged() ? 1u : 0u };
+                connection_.Send(&ack, sizeof(ack));
+            }
+        }
+
+        {
+            std::scoped_lock lock{ mutex_ };
+            lost_ = true;
+        }
+        primaryLost_.notify_all();
+    }
+
+    void Apply(const ReplicationRecord& record)
+    {
+        // A gap or a different book means this standby can't take over as an identical copy any more
+        if (record.sequence_ != Sequence() + 1)
+            diverged_.store(true, std::memory_order_release);
+
+        SharedMemoryEntryServer::Execute(orderbook_, record.request_);
+        if (orderbook_.Checksum() != record.checksum_)
+            diverged_.store(true, std::memory_order_release);
+
+        sequence_.store(record.sequence_, std::memory_order_release);
+    }
+
+    Orderbook& orderbook_;
+    const std::filesystem::path path_;
+    ReplicationSocket listener_;
+    ReplicationSocket connection_;
+
+    std::atomic<std::uint64_t> sequence_{ 0 };
+    std::atomic<bool> diverged_{ false };
+
+    std::mutex mutex_;
+    std::condition_variable primaryLost_;
+    bool lost_{ false };
+    bool stopping_{ false };
+
+    std::thread receiver_;
+};
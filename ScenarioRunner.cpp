@@ -0,0 +1,270 @@
+#include "ScenarioRunner.h"
+#include "OrderBook.h"
+#include "EventJournal.h"
+#include "RecordedFeed.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <optional>
+#include <tuple>
+
+namespace
+{
+	// FNV-1a, good enough to tell two replays apart and cheap to fold every trade into
+	constexpr std::uint64_t FnvOffset = 14695981039346656037ull;
+	constexpr std::uint64_t FnvPrime = 1099511628211ull;
+
+	void HashCombine(std::uint64_t& hash, std::uint64_t value)
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			hash ^= (value >> (i * 8)) & 0xff;
+			hash *= FnvPrime;
+		}
+	}
+
+	Trades Apply(Orderbook& orderbook, const Information& action)
+	{
+		switch (action.type_)
+		{
+			case ActionType::Add:
+				return orderbook.AddOrder(std::make_shared<Order>(action.orderType_, action.orderId_, action.side_, action.price_, action.quantity_));
+			case ActionType::Modify:
+				return orderbook.ModifyOrder(OrderModify{ action.orderId_, action.side_, action.price_, action.quantity_ });
+			case ActionType::Cancel:
+				orderbook.CancelOrder(action.orderId_);
+				return { };
+			default:
+				throw std::logic_error("Unsupported Action.");
+		}
+	}
+
+	// The actions of a scenario file, parsed up front, or of a binary feed, read in place while replaying
+	struct Recording
+	{
+		explicit Recording(const std::filesystem::path& file)
+		{
+			if (FeedFile::Is(file))
+			{
+				feed_.emplace(file);
+				expected_ = feed_->Expected();
+			}
+			else
+				std::tie(actions_, expected_) = InputHandler{ }.GetRecording(file);
+		}
+
+		std::size_t Size() const { return feed_ ? feed_->Records() : actions_.size(); }
+
+		template<typename Visit>
+		void ForEach(Visit&& visit) const
+		{
+			if (feed_)
+				feed_->ForEach([&visit](const FeedRecord& record) { visit(record.ToInformation()); });
+			else
+				for (const auto& action : actions_)
+					visit(action);
+		}
+
+		std::optional<FeedReader> feed_;
+		Informations actions_;
+		std::optional<Result> expected_;
+	};
+}
+
+ScenarioRunner::ScenarioRunner(std::size_t threadCount, bool profile)
+	: threadCount_{ threadCount == 0 ? 1 : threadCount }
+	, profile_{ profile }
+{ }
+
+ScenarioReport ScenarioRunner::Replay(const std::filesystem::path& file, bool profile)
+{
+	ScenarioReport report;
+	report.file_ = file;
+	report.checksum_ = FnvOffset;
+
+	try
+	{
+		const Recording recording{ file };
+		const auto& expected = recording.expected_;
+		report.expected_ = expected;
+
+		// Counters follow the thread that opened them, so every replay opens its own
+		std::optional<PerfCounters> counters;
+		if (profile)
+		{
+			counters.emplace();
+			report.profile_ = PerfProfile{ { "add", "cancel", "modify" }, counters->Supported() };
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+
+		// Nothing shared with the other replays: no prepopulation & no global id counter
+		Orderbook orderbook{ OrderbookConfig{ .prepopulate_ = false, .expireGoodForDay_ = false, .transactionLog_ = false } };
+		recording.ForEach([&](const Information& action)
+			{
+				Trades trades;
+				if (counters)
+					counters->Measure(report.profile_.At(static_cast<std::size_t>(action.type_)), [&] { trades = Apply(orderbook, action); });
+				else
+					trades = Apply(orderbook, action);
+				report.trades_ += trades.size();
+
+				for (const auto& trade : trades)
+				{
+					HashCombine(report.checksum_, trade.GetBidTrade().orderdId_);
+					HashCombine(report.checksum_, trade.GetAskTrade().orderdId_);
+					HashCombine(report.checksum_, static_cast<std::uint64_t>(trade.GetBidTrade().price_));
+					HashCombine(report.checksum_, trade.GetBidTrade().quantity_);
+				}
+			});
+
+		const auto infos = orderbook.GetOrderInfos();
+		report.seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		report.messages_ = recording.Size();
+		report.actual_ = Result{ orderbook.Size(), infos.GetBids().size(), infos.GetAsks().size() };
+		report.bookChecksum_ = orderbook.Checksum();
+
+		for (const auto& level : infos.GetBids())
+		{
+			HashCombine(report.checksum_, static_cast<std::uint64_t>(level.price_));
+			HashCombine(report.checksum_, level.quantity_);
+		}
+		for (const auto& level : infos.GetAsks())
+		{
+			HashCombine(report.checksum_, static_cast<std::uint64_t>(level.price_));
+			HashCombine(report.checksum_, level.quantity_);
+		}
+
+		// A recording without an R line has nothing to compare against, it only contributes a checksum
+		report.passed_ = !expected.has_value() ||
+			(expected->allCount_ == report.actual_.allCount_ &&
+			 expected->bidCount_ == report.actual_.bidCount_ &&
+			 expected->askCount_ == report.actual_.askCount_);
+	}
+	catch (const std::exception& exception)
+	{
+		report.passed_ = false;
+		report.error_ = exception.what();
+	}
+
+	return report;
+}
+
+ScenarioReport ScenarioRunner::Record(const std::filesystem::path& file, const std::filesystem::path& journal, std::uint64_t checkpointInterval)
+{
+	try
+	{
+		EventJournal events{ journal, checkpointInterval };
+		return Record(file, events);
+	}
+	catch (const std::exception& exception)
+	{
+		ScenarioReport report;
+		report.file_ = file;
+		report.error_ = exception.what();
+		return report;
+	}
+}
+
+ScenarioReport ScenarioRunner::Record(const std::filesystem::path& file, BookEventListener& listener)
+{
+	ScenarioReport report;
+	report.file_ = file;
+
+	try
+	{
+		const Recording recording{ file };
+		report.expected_ = recording.expected_;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		Orderbook orderbook{ OrderbookConfig{ .prepopulate_ = false, .expireGoodForDay_ = false, .transactionLog_ = false } };
+		orderbook.AddListener(&listener);
+
+		recording.ForEach([&](const Information& action) { report.trades_ += Apply(orderbook, action).size(); });
+
+		orderbook.RemoveListener(&listener);
+		report.seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		report.messages_ = recording.Size();
+		report.bookChecksum_ = orderbook.Checksum();
+		report.passed_ = true;
+	}
+	catch (const std::exception& exception)
+	{
+		report.passed_ = false;
+		report.error_ = exception.what();
+	}
+
+	return report;
+}
+
+ScenarioSummary ScenarioRunner::Run(const std::filesystem::path& directory) const
+{
+	ScenarioSummary summary;
+
+	std::vector<std::filesystem::path> files;
+	for (const auto& entry : std::filesystem::directory_iterator{ directory })
+	{
+		if (entry.is_regular_file())
+			files.push_back(entry.path());
+	}
+	std::sort(files.begin(), files.end());
+
+	// Every task writes only its own slot so the results need no locking
+	summary.reports_.resize(files.size());
+
+	const auto start = std::chrono::steady_clock::now();
+	{
+		ThreadPool pool{ std::min(threadCount_, std::max<std::size_t>(files.size(), 1)) };
+		for (std::size_t i = 0; i < files.size(); i++)
+			pool.Submit([this, &summary, &files, i] { summary.reports_[i] = Replay(files[i], profile_); });
+		pool.Wait();
+	}
+	summary.wallSeconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	summary.checksum_ = FnvOffset;
+	for (const auto& report : summary.reports_)
+	{
+		report.passed_ ? summary.passed_++ : summary.failed_++;
+		summary.messages_ += report.messages_;
+		summary.trades_ += report.trades_;
+		HashCombine(summary.checksum_, report.checksum_);
+		summary.profile_.Merge(report.profile_);
+	}
+
+	return summary;
+}
+
+void ScenarioRunner::Print(const ScenarioSummary& summary, std::ostream& out)
+{
+	out << std::left;
+	for (const auto& report : summary.reports_)
+	{
+		out << (report.passed_ ? "[PASS] " : "[FAIL] ") << std::setw(32) << report.file_.filename().string()
+			<< " msgs " << std::setw(10) << report.messages_
+			<< " trades " << std::setw(10) << report.trades_
+			<< " orders " << std::setw(8) << report.actual_.allCount_
+			<< " checksum " << std::hex << std::setw(16) << std::setfill('0') << std::right << report.checksum_
+			<< " book " << std::setw(16) << report.bookChecksum_
+			<< std::dec << std::setfill(' ') << std::left;
+
+		if (report.expected_.has_value() && !report.passed_ && report.error_.empty())
+			out << " expected R " << report.expected_->allCount_ << ' ' << report.expected_->bidCount_ << ' ' << report.expected_->askCount_
+				<< " got R " << report.actual_.allCount_ << ' ' << report.actual_.bidCount_ << ' ' << report.actual_.askCount_;
+		if (!report.error_.empty())
+			out << " error: " << report.error_;
+
+		out << '\n';
+	}
+
+	const auto throughput = summary.wallSeconds_ > 0 ? summary.messages_ / summary.wallSeconds_ : 0.0;
+	out << "\nFiles: " << summary.reports_.size() << " passed " << summary.passed_ << " failed " << summary.failed_ << '\n'
+		<< "Messages: " << summary.messages_ << " Trades: " << summary.trades_ << '\n'
+		<< "Wall time: " << std::fixed << std::setprecision(3) << summary.wallSeconds_ << "s Throughput: "
+		<< std::setprecision(0) << throughput << " msgs/s\n"
+		<< "Checksum: " << std::hex << std::setw(16) << std::setfill('0') << std::right << summary.checksum_ << std::dec << std::setfill(' ') << '\n';
+
+	summary.profile_.Print(out);
+}
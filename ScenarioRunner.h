@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "BookEvent.h"
+#include "PerfCounters.h"
+#include "Scenario.h"
+
+// Outcome of replaying one scenario / recorded-day file on its own isolated book
+struct ScenarioReport
+{
+    std::filesystem::path file_;
+    bool passed_{ false };
+    std::string error_;
+    std::optional<Result> expected_;
+    Result actual_{ };
+    std::size_t messages_{ };
+    std::size_t trades_{ };
+    double seconds_{ };
+    std::uint64_t checksum_{ }; // Covers every trade and the final book, equal across runs for the same input
+    std::uint64_t bookChecksum_{ }; // Orderbook::Checksum of the final resting book
+    PerfProfile profile_;       // Only filled when profiling
+};
+
+using ScenarioReports = std::vector<ScenarioReport>;
+
+struct ScenarioSummary
+{
+    ScenarioReports reports_;
+    std::size_t passed_{ };
+    std::size_t failed_{ };
+    std::size_t messages_{ };
+    std::size_t trades_{ };
+    double wallSeconds_{ };
+    std::uint64_t checksum_{ }; // Combined in file name order so it doesn't depend on scheduling
+    PerfProfile profile_;
+};
+
+// Replays a directory of scenario files in parallel, one deterministic Orderbook per file
+// Binary feeds (RecordedFeed.h, by their .feed extension) replay the same as the text they were converted from
+// Files are independent so they are handed to a work stealing pool sized to the machine
+// With profiling on every message is wrapped in hardware counters, reported per action type
+class ScenarioRunner
+{
+public:
+    explicit ScenarioRunner(std::size_t threadCount, bool profile = false);
+
+    ScenarioSummary Run(const std::filesystem::path& directory) const;
+
+    static ScenarioReport Replay(const std::filesystem::path& file, bool profile = false);
+
+    // Replays one file with an EventJournal attached, for time travel queries with JournalReader
+    static ScenarioReport Record(const std::filesystem::path& file, const std::filesystem::path& journal, std::uint64_t checkpointInterval);
+
+    // Replays one file with any listener attached (a ColumnarExporter for instance)
+    static ScenarioReport Record(const std::filesystem::path& file, BookEventListener& listener);
+    static void Print(const ScenarioSummary& summary, std::ostream& out);
+
+private:
+    std::size_t threadCount_;
+    bool profile_;
+};
@@ -0,0 +1,451 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "OrderBook.h"
+#include "OrderCommand.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <cerrno>
+    #include <csignal>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+enum class EntryRequestType : std::uint8_t
+{
+    Limit,
+    Market,
+    ImmediateOrCancel,
+    FillOrKill,
+    Modify,
+    Cancel,
+};
+
+// One command from a client, a full cache line so neighbouring slots never share one
+struct alignas(64) EntryRequest
+{
+    std::uint64_t clientSequence_;  // Echoed back in the response
+    OrderId orderId_;
+    Price price_;
+    Quantity quantity_;
+    Side side_;
+    EntryRequestType type_;
+    AccountId account_{ };
+};
+
+struct alignas(64) EntryResponse
+{
+    std::uint64_t clientSequence_;
+    OrderId orderId_;
+    Quantity filled_;
+    Quantity resting_;
+    CommandStatus status_;
+};
+
+static_assert(sizeof(EntryRequest) == 64 && sizeof(EntryResponse) == 64);
+
+// Single producer single consumer ring living inside the shared mapping
+// Each side owns a cache line with its index and a cached copy of the other side's, so the shared line
+// is only read when the cached copy says the ring looks full / empty
+template<typename Message, std::uint32_t Capacity>
+class SharedRing
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "The ring's indices must be lock free to be shared between processes");
+
+public:
+    bool TryPush(const Message& message) noexcept
+    {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ == Capacity)
+        {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ == Capacity)
+                return false;
+        }
+
+        slots_[tail & (Capacity - 1)] = message;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(Message& message) noexcept
+    {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_)
+                return false;
+        }
+
+        message = slots_[head & (Capacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const noexcept { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+
+    // Room for at least one more message, only meaningful to the producer
+    bool CanPush() noexcept
+    {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ == Capacity)
+            cachedHead_ = head_.load(std::memory_order_acquire);
+        return tail - cachedHead_ != Capacity;
+    }
+
+    // Only while neither side is using the ring
+    void Reset() noexcept
+    {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        cachedHead_ = cachedTail_ = 0;
+    }
+
+private:
+    alignas(64) std::atomic<std::uint64_t> head_{ 0 };  // Consumer's line
+    std::uint64_t cachedTail_{ 0 };
+    alignas(64) std::atomic<std::uint64_t> tail_{ 0 };  // Producer's line
+    std::uint64_t cachedHead_{ 0 };
+    alignas(64) Message slots_[Capacity];
+};
+
+// A named block of memory every process on the host can map, POSIX shm or a Windows file mapping
+class SharedMemoryRegion
+{
+public:
+    // Creates (or recreates) the region, the creator removes the name again when it goes away
+    static SharedMemoryRegion Create(const std::string& name, std::size_t size) { return SharedMemoryRegion{ name, size, true }; }
+    static SharedMemoryRegion Open(const std::string& name, std::size_t size) { return SharedMemoryRegion{ name, size, false }; }
+
+    SharedMemoryRegion(SharedMemoryRegion&& other) noexcept
+        : name_{ std::move(other.name_) }, size_{ other.size_ }, memory_{ other.memory_ }, owner_{ other.owner_ }
+    #if defined(_WIN32) || defined(_WIN64)
+        , mapping_{ other.mapping_ }
+    #endif
+    {
+        other.memory_ = nullptr;
+    #if defined(_WIN32) || defined(_WIN64)
+        other.mapping_ = nullptr;
+    #endif
+    }
+
+    ~SharedMemoryRegion()
+    {
+        if (!memory_)
+            return;
+
+    #if defined(_WIN32) || defined(_WIN64)
+        UnmapViewOfFile(memory_);
+        CloseHandle(mapping_);
+    #else
+        munmap(memory_, size_);
+        if (owner_)
+            shm_unlink(name_.c_str());
+    #endif
+    }
+
+    SharedMemoryRegion(const SharedMemoryRegion&) = delete;
+    void operator=(const SharedMemoryRegion&) = delete;
+
+    void* Data() const { return memory_; }
+    std::size_t Size() const { return size_; }
+
+private:
+    SharedMemoryRegion(const std::string& name, std::size_t size, bool create)
+        : name_{ name.empty() || name.front() != '/' ? "/" + name : name }, size_{ size }, owner_{ create }
+    {
+    #if defined(_WIN32) || defined(_WIN64)
+        const auto objectName = "Local\\" + name_.substr(1);
+        mapping_ = create
+            ? CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), objectName.c_str())
+            : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, objectName.c_str());
+        if (mapping_)
+            memory_ = MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    #else
+        if (create)
+            shm_unlink(name_.c_str());
+
+        const int fd = shm_open(name_.c_str(), create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+        if (fd >= 0)
+        {
+            if (!create || ftruncate(fd, static_cast<off_t>(size)) == 0)
+            {
+            #if defined(MAP_POPULATE)
+                void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+            #else
+                void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            #endif
+                memory_ = memory == MAP_FAILED ? nullptr : memory;
+            }
+            close(fd);
+        }
+    #endif
+
+        if (!memory_)
+            throw std::runtime_error("Cannot map shared memory " + name_);
+    }
+
+    std::string name_;
+    std::size_t size_;
+    void* memory_{ nullptr };
+    bool owner_;
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE mapping_{ nullptr };
+#endif
+};
+
+// Layout of the shared segment: a header then one pair of rings per client slot
+struct SharedEntryLayout
+{
+    static constexpr std::uint64_t Magic = 0x4f42454e54525932ull;   // "OBENTRY2"
+    static constexpr std::uint32_t RingCapacity = 1'024;
+    static constexpr std::uint32_t LivenessRounds = 65'536;         // Poll rounds between two checks that the clients' processes still exist
+
+    enum SlotState : std::uint32_t
+    {
+        Free,
+        Attached,
+        Detaching,  // The client left, the engine resets the rings before the slot can be claimed again
+    };
+
+    struct alignas(64) Header
+    {
+        std::uint64_t magic_;
+        std::uint32_t clients_;
+    };
+
+    struct alignas(64) Slot
+    {
+        std::atomic<std::uint32_t> state_{ Free };
+        std::atomic<std::uint32_t> owner_{ 0 };    // Process id of the client, 0 until it's stored after the claim
+        SharedRing<EntryRequest, RingCapacity> requests_;
+        SharedRing<EntryResponse, RingCapacity> responses_;
+    };
+
+    static std::size_t Size(std::uint32_t clients) { return sizeof(Header) + clients * sizeof(Slot); }
+
+    static Header& HeaderOf(void* memory) { return *static_cast<Header*>(memory); }
+    static Slot& SlotOf(void* memory, std::uint32_t client) { return reinterpret_cast<Slot*>(static_cast<std::byte*>(memory) + sizeof(Header))[client]; }
+
+    static std::uint32_t CurrentProcess()
+    {
+    #if defined(_WIN32) || defined(_WIN64)
+        return static_cast<std::uint32_t>(GetCurrentProcessId());
+    #else
+        return static_cast<std::uint32_t>(getpid());
+    #endif
+    }
+
+    // False only once the process is known to be gone, anything the OS won't tell counts as alive
+    static bool ProcessAlive(std::uint32_t process)
+    {
+    #if defined(_WIN32) || defined(_WIN64)
+        const HANDLE handle = OpenProcess(SYNCHRONIZE, FALSE, process);
+        if (!handle)
+            return GetLastError() != ERROR_INVALID_PARAMETER;
+        const bool alive = WaitForSingleObject(handle, 0) == WAIT_TIMEOUT;
+        CloseHandle(handle);
+        return alive;
+    #else
+        return kill(static_cast<pid_t>(process), 0) == 0 || errno != ESRCH;
+    #endif
+    }
+};
+
+// Engine side of the shared memory order entry: owns the segment and executes what local clients put in their rings
+// Call Poll from the matching thread; neither Poll nor a client's Submit makes a syscall
+class SharedMemoryEntryServer
+{
+public:
+    // burst is how many requests one client gets per round before the next client's turn
+    SharedMemoryEntryServer(const std::string& name, std::uint32_t clients = 8, std::uint32_t burst = 16)
+        : region_{ SharedMemoryRegion::Create(name, SharedEntryLayout::Size(clients)) }
+        , clients_{ clients }
+        , burst_{ burst == 0 ? 1 : burst }
+    {
+        void* memory = region_.Data();
+        for (std::uint32_t client = 0; client < clients_; client++)
+            new (&SharedEntryLayout::SlotOf(memory, client)) SharedEntryLayout::Slot{ };
+
+        // The magic goes last, a client that sees it sees initialized slots
+        auto& header = SharedEntryLayout::HeaderOf(memory);
+        header.clients_ = clients_;
+        std::atomic_thread_fence(std::memory_order_release);
+        header.magic_ = SharedEntryLayout::Magic;
+    }
+
+    SharedMemoryEntryServer(const SharedMemoryEntryServer&) = delete;
+    void operator=(const SharedMemoryEntryServer&) = delete;
+
+    // One round over every client, starting one further than the last round so no client is always served first
+    // Every LivenessRounds rounds it also checks the attached clients' processes (a syscall each), the slot of
+    // a client that died without detaching is reclaimed like a detached one
+    // Returns the number of requests executed
+    std::size_t Poll(Orderbook& orderbook) noexcept
+    {
+        std::size_t executed{ 0 };
+        void* memory = region_.Data();
+        const bool checkOwners = ++rounds_ % SharedEntryLayout::LivenessRounds == 0;
+
+        for (std::uint32_t i = 0; i < clients_; i++)
+        {
+            auto& slot = SharedEntryLayout::SlotOf(memory, (start_ + i) % clients_);
+            const auto state = slot.state_.load(std::memory_order_acquire);
+            if (state == SharedEntryLayout::Detaching || (state == SharedEntryLayout::Attached && checkOwners && !OwnerAlive(slot)))
+            {
+                slot.requests_.Reset();
+                slot.responses_.Reset();
+                slot.owner_.store(0, std::memory_order_relaxed);
+                slot.state_.store(SharedEntryLayout::Free, std::memory_order_release);
+                continue;
+            }
+            if (state != SharedEntryLayout::Attached)
+                continue;
+
+            // A client that doesn't read its responses only stalls itself
+            EntryRequest request;
+            for (std::uint32_t served = 0; served < burst_ && slot.responses_.CanPush() && slot.requests_.TryPop(request); served++)
+            {
+                slot.responses_.TryPush(Execute(orderbook, request));
+                executed++;
+            }
+        }
+
+        start_ = (start_ + 1) % clients_;
+        return executed;
+    }
+
+    // Polls until stop is set, for a dedicated matching thread
+    // Only after idleSpins empty rounds in a row does it give the core away, a busy engine never leaves user space
+    void Serve(Orderbook& orderbook, const std::atomic<bool>& stop, std::uint32_t idleSpins = 4'096) noexcept
+    {
+        std::uint32_t idle{ 0 };
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            if (Poll(orderbook) != 0)
+                idle = 0;
+            else if (++idle >= idleSpins)
+            {
+                std::this_thread::yield();
+                idle = 0;
+            }
+        }
+    }
+
+    static EntryResponse Execute(Orderbook& orderbook, const EntryRequest& request) noexcept
+    {
+        const OrderCommand command{ request.orderId_, request.side_, request.price_, request.quantity_, request.account_ };
+
+        CommandResult result{ CommandStatus::Accepted };
+        switch (request.type_)
+        {
+            case EntryRequestType::Limit:
+                result = orderbook.AddLimit(command);
+                break;
+            case EntryRequestType::Market:
+                result = orderbook.AddMarket(MarketCommand{ request.orderId_, request.side_, request.quantity_, request.account_ });
+                break;
+            case EntryRequestType::ImmediateOrCancel:
+                result = orderbook.AddIOC(command);
+                break;
+            case EntryRequestType::FillOrKill:
+                result = orderbook.AddFOK(command);
+                break;
+            case EntryRequestType::Modify:
+                result = orderbook.Modify(command);
+                break;
+            case EntryRequestType::Cancel:
+                result.status_ = orderbook.Cancel(request.orderId_);
+                break;
+        }
+
+        return EntryResponse{ request.clientSequence_, request.orderId_, result.filled_, result.resting_, result.status_ };
+    }
+
+private:
+    static bool OwnerAlive(const SharedEntryLayout::Slot& slot)
+    {
+        const auto owner = slot.owner_.load(std::memory_order_acquire);
+        return owner == 0 || SharedEntryLayout::ProcessAlive(owner);
+    }
+
+    SharedMemoryRegion region_;
+    const std::uint32_t clients_;
+    const std::uint32_t burst_;
+    std::uint32_t start_{ 0 };
+    std::uint64_t rounds_{ 0 };
+};
+
+// Client side, usable from any process on the host: claims a free slot of the segment on construction
+// and frees it on destruction. The slot of a client process that dies first is reclaimed by the engine's Poll
+// Submit and Poll are plain loads & stores into the shared rings
+class SharedMemoryEntryClient
+{
+public:
+    explicit SharedMemoryEntryClient(const std::string& name)
+        : region_{ OpenSegment(name) }
+    {
+        void* memory = region_.Data();
+        const auto clients = SharedEntryLayout::HeaderOf(memory).clients_;
+        for (std::uint32_t client = 0; client < clients && !slot_; client++)
+        {
+            auto& slot = SharedEntryLayout::SlotOf(memory, client);
+            auto expected = static_cast<std::uint32_t>(SharedEntryLayout::Free);
+            if (slot.state_.compare_exchange_strong(expected, SharedEntryLayout::Attached, std::memory_order_acq_rel))
+            {
+                slot.owner_.store(SharedEntryLayout::CurrentProcess(), std::memory_order_release);
+                slot_ = &slot;
+            }
+        }
+
+        if (!slot_)
+            throw std::runtime_error("No free order entry slot in " + name);
+    }
+
+    ~SharedMemoryEntryClient()
+    {
+        slot_->state_.store(SharedEntryLayout::Detaching, std::memory_order_release);
+    }
+
+    SharedMemoryEntryClient(const SharedMemoryEntryClient&) = delete;
+    void operator=(const SharedMemoryEntryClient&) = delete;
+
+    // False when the request ring is full, the engine is behind
+    bool Submit(const EntryRequest& request) noexcept { return slot_->requests_.TryPush(request); }
+
+    // False when no response is waiting
+    bool Poll(EntryResponse& response) noexcept { return slot_->responses_.TryPop(response); }
+
+private:
+    static SharedMemoryRegion OpenSegment(const std::string& name)
+    {
+        // Map the header first to learn how many slots there are
+        std::uint32_t clients;
+        {
+            auto header = SharedMemoryRegion::Open(name, sizeof(SharedEntryLayout::Header));
+            const auto& fields = SharedEntryLayout::HeaderOf(header.Data());
+            if (fields.magic_ != SharedEntryLayout::Magic)
+                throw std::runtime_error("Order entry segment " + name + " isn't ready");
+            std::atomic_thread_fence(std::memory_order_acquire);
+            clients = fields.clients_;
+        }
+        return SharedMemoryRegion::Open(name, SharedEntryLayout::Size(clients));
+    }
+
+    SharedMemoryRegion region_;
+    SharedEntryLayout::Slot* slot_{ nullptr };
+};
@@ -0,0 +1,175 @@
+#include "SoakRunner.h"
+#include "OrderBook.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+namespace
+{
+	void Apply(Orderbook& orderbook, const Information& action, SoakApi api)
+	{
+		if (api == SoakApi::Orders)
+		{
+			switch (action.type_)
+			{
+				case ActionType::Add:
+					orderbook.AddOrder(orderbook.CreateOrder(action.orderType_, action.orderId_, action.side_, action.price_, action.quantity_));
+					break;
+				case ActionType::Modify:
+					orderbook.ModifyOrder(OrderModify{ action.orderId_, action.side_, action.price_, action.quantity_ });
+					break;
+				case ActionType::Cancel:
+					orderbook.CancelOrder(action.orderId_);
+					break;
+			}
+			return;
+		}
+
+		const OrderCommand command{ action.orderId_, action.side_, action.price_, action.quantity_ };
+		switch (action.type_)
+		{
+			case ActionType::Add:
+				if (action.orderType_ == OrderType::Market)
+					orderbook.AddMarket(MarketCommand{ action.orderId_, action.side_, action.quantity_ });
+				else if (action.orderType_ == OrderType::FillAndKill)
+					orderbook.AddIOC(command);
+				else if (action.orderType_ == OrderType::FillOrKill)
+					orderbook.AddFOK(command);
+				else
+					orderbook.AddLimit(command);
+				break;
+			case ActionType::Modify:
+				orderbook.Modify(command);
+				break;
+			case ActionType::Cancel:
+				orderbook.Cancel(action.orderId_);
+				break;
+		}
+	}
+
+	double Megabytes(double bytes) { return bytes / (1024.0 * 1024.0); }
+}
+
+SoakRunner::SoakRunner(const SoakOptions& options)
+	: options_{ options }
+{
+	if (options_.batch_ == 0)
+		options_.batch_ = 1;
+}
+
+SoakResult SoakRunner::Run(const std::string& name, const OrderbookConfig& config, SoakApi api) const
+{
+	using Clock = std::chrono::steady_clock;
+
+	SoakResult result;
+	result.name_ = name;
+	result.budget_ = options_.budget_;
+
+	AllocationTracker::Enable(true);
+
+	Orderbook orderbook{ config };
+	FlowGenerator flow{ options_.flow_ };
+	std::vector<Information> batch;
+	batch.reserve(options_.batch_);
+
+	// next(action) hands out the phase's messages until it returns false
+	// Only the book's share of the work sits between the two snapshots
+	auto run = [&](const char* phaseName, auto&& next)
+		{
+			SoakPhase phase;
+			phase.name_ = phaseName;
+			result.peakPerPhase_ = AllocationTracker::ResetPeak();
+
+			bool more = true;
+			while (more)
+			{
+				Information action;
+				while (batch.size() < options_.batch_ && (more = next(action)))
+					batch.push_back(action);
+
+				const auto before = AllocationTracker::Snapshot();
+				const auto start = Clock::now();
+				for (const auto& message : batch)
+					Apply(orderbook, message, api);
+				phase.seconds_ += std::chrono::duration<double>(Clock::now() - start).count();
+				phase.heap_ += AllocationTracker::Snapshot() - before;
+
+				phase.messages_ += batch.size();
+				batch.clear();
+			}
+
+			phase.residentBytes_ = AllocationTracker::ResidentBytes();
+			phase.peakBytes_ = AllocationTracker::PeakResidentBytes();
+			result.phases_.push_back(phase);
+		};
+
+	const auto residentBefore = AllocationTracker::ResidentBytes();
+	std::size_t placed{ 0 };
+	run("setup", [&](Information& action)
+		{
+			if (placed == options_.restingOrders_)
+				return false;
+			action = flow.NextResting(placed++ % 2 ? Side::Sell : Side::Buy);
+			return true;
+		});
+
+	result.restingOrders_ = orderbook.Size();
+	if (result.restingOrders_ > 0)
+	{
+		const auto& setup = result.phases_.back();
+		result.heapPerOrder_ = static_cast<double>(setup.heap_.liveBytes_) / result.restingOrders_;
+		result.residentPerOrder_ = (static_cast<double>(setup.residentBytes_) - residentBefore) / result.restingOrders_;
+	}
+
+	auto until = [&flow](double seconds)
+		{
+			const auto end = static_cast<std::uint64_t>(seconds * 1e9);
+			return [&flow, end](Information& action)
+				{
+					if (flow.Time() >= end)
+						return false;
+					action = flow.Next().action_;
+					return true;
+				};
+		};
+	run("warmup", until(options_.warmupSeconds_));
+	run("steady", until(options_.warmupSeconds_ + options_.seconds_));
+
+	AllocationTracker::Enable(false);
+
+	const auto& steady = result.phases_.back();
+	result.allocationsPerMessage_ = steady.messages_ > 0 ? static_cast<double>(steady.heap_.allocations_) / steady.messages_ : 0.0;
+	result.passed_ = result.allocationsPerMessage_ <= options_.budget_;
+	return result;
+}
+
+void SoakRunner::Print(const SoakResults& results, std::ostream& out)
+{
+	for (const auto& result : results)
+	{
+		out << result.name_ << '\n'
+			<< std::left << "  " << std::setw(8) << "phase" << std::right << std::setw(12) << "messages" << std::setw(10) << "seconds"
+			<< std::setw(12) << "msgs/s" << std::setw(14) << "allocations" << std::setw(16) << "per 1M msgs" << std::setw(12) << "bytes/msg"
+			<< std::setw(14) << "live heap MB" << std::setw(10) << "RSS MB" << std::setw(10) << "peak MB" << '\n';
+
+		for (const auto& phase : result.phases_)
+		{
+			const auto messages = static_cast<double>(std::max<std::uint64_t>(phase.messages_, 1));
+			out << std::left << "  " << std::setw(8) << phase.name_ << std::right << std::setw(12) << phase.messages_
+				<< std::fixed << std::setprecision(2) << std::setw(10) << phase.seconds_
+				<< std::setprecision(0) << std::setw(12) << (phase.seconds_ > 0 ? phase.messages_ / phase.seconds_ : 0.0)
+				<< std::setw(14) << phase.heap_.allocations_
+				<< std::setprecision(2) << std::setw(16) << phase.heap_.allocations_ * 1e6 / messages
+				<< std::setprecision(1) << std::setw(12) << phase.heap_.bytes_ / messages
+				<< std::setw(14) << Megabytes(static_cast<double>(phase.heap_.liveBytes_))
+				<< std::setw(10) << Megabytes(static_cast<double>(phase.residentBytes_))
+				<< std::setw(10) << Megabytes(static_cast<double>(phase.peakBytes_)) << '\n';
+		}
+
+		out << "  " << result.restingOrders_ << " resting orders: " << std::setprecision(1) << result.heapPerOrder_ << " B heap, "
+			<< result.residentPerOrder_ << " B resident per order\n"
+			<< "  steady state " << std::setprecision(4) << result.allocationsPerMessage_ * 1e6 << " allocations per 1M messages, budget " << result.budget_ * 1e6
+			<< (result.passed_ ? " PASS" : " FAIL") << (result.peakPerPhase_ ? "" : " (peak RSS is the process's, it couldn't be reset)") << "\n" << std::endl;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "AllocationTracker.h"
+#include "FlowGenerator.h"
+#include "OrderbookConfig.h"
+
+struct SoakOptions
+{
+    FlowOptions flow_;
+    std::size_t restingOrders_{ 100'000 };  // Book built before the flow starts
+    double warmupSeconds_{ 60.0 };          // Simulated flow that may still allocate: pools & containers growing to size
+    double seconds_{ 3'600.0 };             // Simulated steady state flow, held to the budget
+    double budget_{ 1e-6 };                 // Steady state allocations allowed per message. Not 0: a pool still takes a new
+                                            // chunk (twice the last) whenever the book reaches a size it never had before
+    std::size_t batch_{ 4'096 };            // Messages generated between two runs of the book
+};
+
+// How the flow enters the book
+enum class SoakApi
+{
+    Orders,     // AddOrder / ModifyOrder / CancelOrder with an OrderPointer & Trades back
+    Commands,   // The entry API (AddLimit & co), GoodForDay orders go in as limits
+};
+
+struct SoakPhase
+{
+    std::string name_;
+    std::uint64_t messages_{ };
+    AllocationStats heap_;          // Of the book alone, the flow generator isn't counted
+    double seconds_{ };
+    std::size_t residentBytes_{ };  // At the end of the phase
+    std::size_t peakBytes_{ };      // Highest resident set during the phase
+};
+
+struct SoakResult
+{
+    std::string name_;
+    std::vector<SoakPhase> phases_;     // setup, warmup, steady
+    std::size_t restingOrders_{ };      // After the setup
+    double heapPerOrder_{ };            // Live heap the setup left per resting order
+    double residentPerOrder_{ };        // Resident set growth of the setup per resting order
+    double allocationsPerMessage_{ };   // Steady state
+    double budget_{ };
+    bool passed_{ false };
+    bool peakPerPhase_{ false };        // The OS let the peak be reset between phases
+};
+
+using SoakResults = std::vector<SoakResult>;
+
+// Long running synthetic flow through one book with every heap allocation of the process counted
+// (AllocationTracker), to prove the steady state doesn't allocate and to see what a resting order costs
+// The flow is generated a batch at a time outside of the counted part, so only the book's own allocations count
+class SoakRunner
+{
+public:
+    explicit SoakRunner(const SoakOptions& options);
+
+    SoakResult Run(const std::string& name, const OrderbookConfig& config, SoakApi api) const;
+    static void Print(const SoakResults& results, std::ostream& out);
+
+private:
+    SoakOptions options_;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+
+#if defined(_WIN32) || defined(_WIN64)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+    #include <filesystem>
+#endif
+
+// Pinning threads to cores and finding the NUMA node a core belongs to
+// Everything degrades to a no-op (returning false / -1) where the platform doesn't support it
+struct ThreadAffinity
+{
+    // Pin the calling thread to one core, the matching thread should never migrate away from its caches
+    static bool PinCurrentThread(int core)
+    {
+        if (core < 0)
+            return false;
+
+    #if defined(_WIN32) || defined(_WIN64)
+        return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{ 1 } << core) != 0;
+    #elif defined(__linux__)
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(core, &cpus);
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+    #else
+        return false;
+    #endif
+    }
+
+    // NUMA node the core sits on, -1 when unknown
+    static int NumaNodeOfCore(int core)
+    {
+        if (core < 0)
+            return -1;
+
+    #if defined(_WIN32) || defined(_WIN64)
+        UCHAR node;
+        if (!GetNumaProcessorNode(static_cast<UCHAR>(core), &node))
+            return -1;
+        return node;
+    #elif defined(__linux__)
+        // The kernel exposes the node as a nodeN link in the cpu's sysfs directory
+        std::error_code error;
+        const std::filesystem::path cpu{ "/sys/devices/system/cpu/cpu" + std::to_string(core) };
+        for (const auto& entry : std::filesystem::directory_iterator{ cpu, error })
+        {
+            const auto name = entry.path().filename().string();
+            if (name.rfind("node", 0) == 0 && name.size() > 4)
+                return std::stoi(name.substr(4));
+        }
+        return -1;
+    #else
+        return -1;
+    #endif
+    }
+};
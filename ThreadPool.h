@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work stealing thread pool
+// Every worker owns a deque of tasks: it pops the newest task from the back of its own deque
+// and when it runs dry it steals the oldest task from the front of another worker's deque,
+// so a handful of long tasks (big replay files) can't leave the other cores idle
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(std::size_t threadCount = std::thread::hardware_concurrency())
+    {
+        if (threadCount == 0)
+            threadCount = 1;
+
+        queues_.reserve(threadCount);
+        for (std::size_t i = 0; i < threadCount; i++)
+            queues_.push_back(std::make_unique<WorkQueue>());
+
+        workers_.reserve(threadCount);
+        for (std::size_t i = 0; i < threadCount; i++)
+            workers_.emplace_back([this, i] { WorkerLoop(i); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::scoped_lock lock{ signalMutex_ };
+            shutdown_ = true;
+        }
+        workAvailable_.notify_all();
+
+        for (auto& worker : workers_)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    void operator=(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    void operator=(ThreadPool&&) = delete;
+
+    std::size_t Size() const { return workers_.size(); }
+
+    void Submit(Task task)
+    {
+        // A task submitted from inside a worker stays on that worker (better locality),
+        // anything submitted from outside is spread round robin
+        const auto index = workerIndex_ != NoWorker && workerOwner_ == this
+            ? workerIndex_
+            : nextQueue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+
+        // Counted before it becomes visible in the deque so a thief can never decrement first
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::scoped_lock lock{ signalMutex_ };
+            queued_++;
+        }
+
+        {
+            std::scoped_lock lock{ queues_[index]->mutex_ };
+            queues_[index]->tasks_.push_back(std::move(task));
+        }
+        workAvailable_.notify_one();
+    }
+
+    // Block until every task submitted so far (and every task they submitted) has finished
+    void Wait()
+    {
+        std::unique_lock lock{ signalMutex_ };
+        allDone_.wait(lock, [this] { return pending_.load(std::memory_order_acquire) == 0; });
+    }
+
+private:
+    struct WorkQueue
+    {
+        std::mutex mutex_;
+        std::deque<Task> tasks_;
+    };
+
+    static constexpr std::size_t NoWorker = static_cast<std::size_t>(-1);
+    static inline thread_local std::size_t workerIndex_{ NoWorker };
+    static inline thread_local const ThreadPool* workerOwner_{ nullptr };
+
+    bool TryPop(std::size_t index, Task& task)
+    {
+        auto& queue = *queues_[index];
+        std::scoped_lock lock{ queue.mutex_ };
+        if (queue.tasks_.empty())
+            return false;
+
+        task = std::move(queue.tasks_.back());
+        queue.tasks_.pop_back();
+        return true;
+    }
+
+    bool TrySteal(std::size_t thief, Task& task)
+    {
+        for (std::size_t offset = 1; offset < queues_.size(); offset++)
+        {
+            auto& queue = *queues_[(thief + offset) % queues_.size()];
+            std::scoped_lock lock{ queue.mutex_ };
+            if (queue.tasks_.empty())
+                continue;
+
+            task = std::move(queue.tasks_.front());
+            queue.tasks_.pop_front();
+            return true;
+        }
+
+        return false;
+    }
+
+    void WorkerLoop(std::size_t index)
+    {
+        workerIndex_ = index;
+        workerOwner_ = this;
+
+        while (true)
+        {
+            Task task;
+            if (TryPop(index, task) || TrySteal(index, task))
+            {
+                {
+                    std::scoped_lock lock{ signalMutex_ };
+                    queued_--;
+                }
+
+                task();
+
+                if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    std::scoped_lock lock{ signalMutex_ };
+                    allDone_.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock lock{ signalMutex_ };
+            workAvailable_.wait(lock, [this] { return shutdown_ || queued_ > 0; });
+            if (shutdown_ && queued_ == 0)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<std::size_t> nextQueue_{ 0 };
+    std::atomic<std::size_t> pending_{ 0 };
+
+    // queued_ counts tasks sitting in a deque, it's what idle workers sleep on
+    std::mutex signalMutex_;
+    std::condition_variable workAvailable_;
+    std::condition_variable allDone_;
+    std::size_t queued_{ 0 };
+    bool shutdown_{ false };
+};
@@ -18,9 +18,21 @@ iii. Cancel Order
 */
 #include "OrderBook.h"
 #include "Constants.h"
+#include "ScenarioRunner.h"
+#include "Benchmark.h"
+#include "FlowGenerator.h"
+#include "EventJournal.h"
+#include "ColumnarExport.h"
+#include "RecordedFeed.h"
+#include "SoakRunner.h"
 
+#include <cstdio>
+#include <ctime>
+#include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <string_view>
+#include <thread>
 
 OrderId Orderbook::id_cnt = 0;
 
@@ -133,8 +145,471 @@ void Print_TransactionLog(std::shared_ptr<Orderbook> orderbook)
     system("pause");
 }
 
-int main() 
+// A trailing --profile switches the batch modes to hardware counter profiling
+bool Take_ProfileFlag(int& argc, char* argv[])
 {
+    if (argc > 2 && std::string_view{ argv[argc - 1] } == "--profile")
+    {
+        argc--;
+        return true;
+    }
+    return false;
+}
+
+// Batch mode: OrderBook --replay <directory> [threads] [--profile]
+// Replays every scenario file in the directory on its own book, spread across all cores
+int Run_Replay(int argc, char* argv[])
+{
+    const bool profile = Take_ProfileFlag(argc, argv);
+    if (argc < 3)
+    {
+        std::cout << "Usage: " << argv[0] << " --replay <directory> [threads] [--profile]\n";
+        return 1;
+    }
+
+    const std::size_t threads = argc > 3 ? std::stoul(argv[3]) : std::thread::hardware_concurrency();
+    ScenarioRunner runner{ threads, profile };
+    const auto summary = runner.Run(argv[2]);
+    ScenarioRunner::Print(summary, std::cout);
+
+    return summary.failed_ == 0 ? 0 : 1;
+}
+
+// Batch mode: OrderBook --bench [operations] [core] [--profile]
+// Same seeded workload on a heap book, an arena book and a huge page arena book pinned to the core
+int Run_Benchmark(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    options.profile_ = Take_ProfileFlag(argc, argv);
+    if (argc > 2)
+        options.operations_ = std::stoul(argv[2]);
+    if (argc > 3)
+        options.core_ = std::stoi(argv[3]);
+
+    Benchmark benchmark{ options };
+    Benchmark::Print(benchmark.RunMemoryConfigurations(), std::cout);
+    return 0;
+}
+
+// Batch mode: OrderBook --bench-journal [orders] [directory] [orders per second]
+// Ack latency against throughput of the durable group commit journal for a few batch settings
+int Run_JournalBenchmark(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    options.operations_ = argc > 2 ? std::stoul(argv[2]) : 50'000;
+    const std::filesystem::path directory = argc > 3 ? argv[3] : ".";
+    const double rate = argc > 4 ? std::stod(argv[4]) : 50'000.0;
+
+    using namespace std::chrono_literals;
+    const std::vector<DurabilitySetting> settings{ { 1, 0us }, { 16, 100us }, { 64, 250us }, { 256, 1000us }, { 1024, 5000us } };
+
+    Benchmark benchmark{ options };
+    Benchmark::Print(benchmark.RunDurability(directory, settings, options.operations_, rate), std::cout);
+    return 0;
+}
+
+// Batch mode: OrderBook --bench-entry [operations] [core]
+// Round trip of orders through the shared memory entry rings to a matching thread polling them on core
+int Run_EntryBenchmark(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    if (argc > 2)
+        options.operations_ = std::stoul(argv[2]);
+    if (argc > 3)
+        options.core_ = std::stoi(argv[3]);
+
+    Benchmark benchmark{ options };
+    Benchmark::Print(BenchmarkResults{ benchmark.RunSharedMemoryEntry("OrderBookEntryBenchmark") }, std::cout);
+    return 0;
+}
+
+// Batch mode: OrderBook --bench-pipeline [operations] [core]
+// Matching with market data & journaling on one thread against the staged pipeline, matching stage on core
+int Run_PipelineBenchmark(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    if (argc > 2)
+        options.operations_ = std::stoul(argv[2]);
+    if (argc > 3)
+        options.core_ = std::stoi(argv[3]);
+
+    Benchmark benchmark{ options };
+    Benchmark::Print(benchmark.RunPipeline(), std::cout);
+    return 0;
+}
+
+// Batch mode: OrderBook --bench-replication [operations]
+// The flow with and without a hot standby backup taking every request over a local socket
+int Run_ReplicationBenchmark(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    if (argc > 2)
+        options.operations_ = std::stoul(argv[2]);
+
+    Benchmark benchmark{ options };
+    Benchmark::Print(benchmark.RunReplication(), std::cout);
+    return 0;
+}
+
+// Batch mode: OrderBook --bench-quotes [quotes] [makers] [levels]
+// Market makers refreshing their quote sets quote by quote against one ReplaceQuotes per refresh
+int Run_QuotingBenchmark(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    if (argc > 2)
+        options.operations_ = std::stoul(argv[2]);
+    const std::size_t makers = argc > 3 ? std::stoul(argv[3]) : 8;
+    const std::size_t levels = argc > 4 ? std::stoul(argv[4]) : 10;
+
+    Benchmark benchmark{ options };
+    Benchmark::Print(benchmark.RunQuoting(makers, levels), std::cout);
+    return 0;
+}
+
+// Batch mode: OrderBook --bench-depth [depth...]
+// Scalar against dispatched (AVX2 when the CPU has it) depth kernels at various book depths
+int Run_DepthBenchmark(int argc, char* argv[])
+{
+    std::vector<std::size_t> depths;
+    for (int i = 2; i < argc; i++)
+        depths.push_back(std::stoul(argv[i]));
+
+    Benchmark benchmark{ BenchmarkOptions{ } };
+    Benchmark::Print(depths.empty() ? benchmark.RunDepthKernels() : benchmark.RunDepthKernels(depths), std::cout);
+    return 0;
+}
+
+// Batch mode: OrderBook --bench-matching [depth...]
+// FIFO against pro-rata allocation of aggressors hitting one deep level
+int Run_MatchingBenchmark(int argc, char* argv[])
+{
+    std::vector<std::size_t> depths;
+    for (int i = 2; i < argc; i++)
+        depths.push_back(std::stoul(argv[i]));
+
+    Benchmark benchmark{ BenchmarkOptions{ } };
+    Benchmark::Print(depths.empty() ? benchmark.RunMatching() : benchmark.RunMatching(depths), std::cout);
+    return 0;
+}
+
+// Batch mode: OrderBook --bench-async [clients] [threads] [operations]
+// Many clients waiting on their commands: an OS thread each against coroutines on a small executor
+int Run_AsyncBenchmark(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    options.operations_ = 200'000;
+    const std::size_t clients = argc > 2 ? std::stoul(argv[2]) : 1'000;
+    const std::size_t threads = argc > 3 ? std::stoul(argv[3]) : 2;
+    if (argc > 4)
+        options.operations_ = std::stoul(argv[4]);
+
+    Benchmark benchmark{ options };
+    Benchmark::Print(benchmark.RunAsyncClients(clients, threads), std::cout);
+    return 0;
+}
+
+// Batch mode: OrderBook --bench-feed [operations] [directory]
+// Loading & replaying one recorded session as scenario text, as a raw feed and as a compressed feed
+int Run_FeedBenchmark(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    if (argc > 2)
+        options.operations_ = std::stoul(argv[2]);
+    const std::filesystem::path directory = argc > 3 ? argv[3] : ".";
+
+    Benchmark benchmark{ options };
+    Benchmark::Print(benchmark.RunFeedLoading(directory), std::cout);
+    return 0;
+}
+
+// Batch mode: OrderBook --soak [simulated minutes] [allocations per 1M messages] [--compare]
+// Hours of synthetic flow through the entry API with every heap allocation counted, fails when the steady state
+// allocates more than the budget. --compare then runs the same flow through AddOrder for reference
+int Run_Soak(int argc, char* argv[])
+{
+    bool compare = false;
+    if (argc > 2 && std::string_view{ argv[argc - 1] } == "--compare")
+    {
+        compare = true;
+        argc--;
+    }
+
+    SoakOptions options;
+    if (argc > 2)
+        options.seconds_ = std::stod(argv[2]) * 60.0;
+    if (argc > 3)
+        options.budget_ = std::stod(argv[3]) / 1e6;
+
+    // The reference goes second, the memory it leaves behind would hide what the entry API's orders cost
+    // Neither keeps a transaction log, it's a string that grows with every message for as long as the book lives
+    const SoakRunner runner{ options };
+    const auto result = runner.Run("entry API, recycled memory", OrderbookConfig{ .prepopulate_ = false, .expireGoodForDay_ = false,
+        .recycleMemory_ = true, .transactionLog_ = false }, SoakApi::Commands);
+    SoakRunner::Print({ result }, std::cout);
+
+    if (compare)
+        SoakRunner::Print({ runner.Run("AddOrder, heap (reference)", OrderbookConfig{ .prepopulate_ = false, .expireGoodForDay_ = false,
+            .transactionLog_ = false }, SoakApi::Orders) }, std::cout);
+
+    return result.passed_ ? 0 : 1;
+}
+
+// Batch mode: OrderBook --generate <file> <messages> [seed]
+// Writes synthetic order flow as a recorded session that --replay can run
+int Run_Generate(int argc, char* argv[])
+{
+    if (argc < 4)
+    {
+        std::cout << "Usage: " << argv[0] << " --generate <file> <messages> [seed]\n";
+        return 1;
+    }
+
+    FlowOptions options;
+    if (argc > 4)
+        options.seed_ = std::stoull(argv[4]);
+
+    std::ofstream file{ argv[2] };
+    FlowGenerator flow{ options };
+    flow.WriteScenario(file, std::stoull(argv[3]));
+
+    std::cout << "Wrote " << argv[3] << " messages covering " << std::fixed << std::setprecision(3) << flow.Time() / 1e9 << "s of simulated time\n";
+    return file ? 0 : 1;
+}
+
+// Batch mode: OrderBook --journal <scenario file> <journal> [checkpoint interval]
+// Replays a recorded session into an event journal with checkpoints for --book-at
+int Run_Journal(int argc, char* argv[])
+{
+    if (argc < 4)
+    {
+        std::cout << "Usage: " << argv[0] << " --journal <scenario file> <journal> [checkpoint interval]\n";
+        return 1;
+    }
+
+    const auto report = ScenarioRunner::Record(argv[2], argv[3], argc > 4 ? std::stoull(argv[4]) : 50'000);
+    if (!report.error_.empty())
+    {
+        std::cout << "error: " << report.error_ << '\n';
+        return 1;
+    }
+
+    std::cout << "Journaled " << report.messages_ << " messages, " << report.trades_ << " trades in " << std::fixed << std::setprecision(3) << report.seconds_ << "s\n";
+    return 0;
+}
+
+// Batch mode: OrderBook --convert <scenario file | directory> <output> [--compress]
+// Scenario text to binary feeds, a directory is converted file by file into <output>/<name>.feed
+int Run_Convert(int argc, char* argv[])
+{
+    FeedOptions options;
+    if (argc > 1 && std::string_view{ argv[argc - 1] } == "--compress")
+    {
+        options.compress_ = true;
+        argc--;
+    }
+    if (argc < 4)
+    {
+        std::cout << "Usage: " << argv[0] << " --convert <scenario file | directory> <output> [--compress]\n";
+        return 1;
+    }
+
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> files;
+    if (std::filesystem::is_directory(argv[2]))
+    {
+        std::filesystem::create_directories(argv[3]);
+        for (const auto& entry : std::filesystem::directory_iterator{ argv[2] })
+        {
+            if (entry.is_regular_file() && !FeedFile::Is(entry.path()))
+                files.emplace_back(entry.path(), std::filesystem::path{ argv[3] } / entry.path().filename().replace_extension(FeedFile::Extension));
+        }
+    }
+    else
+        files.emplace_back(argv[2], argv[3]);
+
+    for (const auto& [scenario, feed] : files)
+    {
+        const auto records = FeedWriter::Convert(scenario, feed, options);
+        std::cout << scenario.filename().string() << " -> " << feed.string() << ": " << records << " records, "
+            << std::filesystem::file_size(scenario) << " -> " << std::filesystem::file_size(feed) << " bytes\n";
+    }
+    return 0;
+}
+
+// Batch mode: OrderBook --export <scenario file> <output> [chunk rows] [snapshot interval]
+// Replays a recorded session into a columnar file of its events and depth snapshots
+int Run_Export(int argc, char* argv[])
+{
+    if (argc < 4)
+    {
+        std::cout << "Usage: " << argv[0] << " --export <scenario file> <output> [chunk rows] [snapshot interval]\n";
+        return 1;
+    }
+
+    ColumnarOptions options;
+    if (argc > 4)
+        options.chunkRows_ = static_cast<std::uint32_t>(std::stoul(argv[4]));
+    if (argc > 5)
+        options.snapshotInterval_ = std::stoull(argv[5]);
+
+    ScenarioReport report;
+    {
+        ColumnarExporter exporter{ argv[3], options };
+        report = ScenarioRunner::Record(argv[2], exporter);
+    }
+    if (!report.error_.empty())
+    {
+        std::cout << "error: " << report.error_ << '\n';
+        return 1;
+    }
+
+    const ColumnarReader reader{ argv[3] };
+    std::cout << "Exported " << reader.Rows(ColumnarTable::Events) << " events and " << reader.Rows(ColumnarTable::Depth) << " depth rows in "
+        << reader.Chunks().size() << " chunks, " << std::fixed << std::setprecision(3) << report.seconds_ << "s\n";
+    return 0;
+}
+
+// Batch mode: OrderBook --scan <export> <low price> <high price>
+// Traded volume & VWAP between two prices, chunks whose price range misses it are skipped unread
+int Run_Scan(int argc, char* argv[])
+{
+    if (argc < 5)
+    {
+        std::cout << "Usage: " << argv[0] << " --scan <export> <low price> <high price>\n";
+        return 1;
+    }
+
+    const ColumnarReader reader{ argv[2] };
+    const Price low = std::stoi(argv[3]);
+    const Price high = std::stoi(argv[4]);
+    const auto start = std::chrono::steady_clock::now();
+
+    // A match is published once per side, the buy side's fills count each trade once
+    std::uint64_t trades{ }, volume{ };
+    double notional{ };
+    std::size_t scanned{ };
+    const auto skipped = reader.Scan(EventColumn::TradePrice, low, high, [&](const ColumnarChunk& chunk)
+        {
+            const auto types = reader.Column<std::uint8_t>(chunk, EventColumn::Type);
+            const auto sides = reader.Column<std::uint8_t>(chunk, EventColumn::Side);
+            const auto prices = reader.Column<std::int32_t>(chunk, EventColumn::TradePrice);
+            const auto quantities = reader.Column<std::uint32_t>(chunk, EventColumn::Quantity);
+            for (std::size_t i = 0; i < chunk.rows_; i++)
+            {
+                if (types[i] != static_cast<std::uint8_t>(BookEventType::Fill) || sides[i] != static_cast<std::uint8_t>(Side::Buy)
+                    || prices[i] < low || prices[i] > high)
+                    continue;
+                trades++;
+                volume += quantities[i];
+                notional += static_cast<double>(prices[i]) * quantities[i];
+            }
+            scanned++;
+        });
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << trades << " trades, volume " << volume << ", vwap " << std::fixed << std::setprecision(4) << (volume ? notional / volume : 0.0)
+        << " (" << scanned << " chunks scanned, " << skipped << " skipped, " << std::setprecision(3) << elapsed * 1'000 << "ms)\n";
+    return 0;
+}
+
+// Batch mode: OrderBook --book-at <journal> <sequence | HH:MM:SS[.mmm]>
+// The book right after a sequence number, or as of a local time of day on the journal's trading day
+int Run_BookAt(int argc, char* argv[])
+{
+    if (argc < 4)
+    {
+        std::cout << "Usage: " << argv[0] << " --book-at <journal> <sequence | HH:MM:SS[.mmm]>\n";
+        return 1;
+    }
+
+    const JournalReader reader{ argv[2] };
+    const std::string_view at{ argv[3] };
+    const auto start = std::chrono::steady_clock::now();
+
+    HistoricalBook book;
+    if (at.find(':') == std::string_view::npos)
+        book = reader.BookAt(std::stoull(argv[3]));
+    else
+    {
+        int hours{ }, minutes{ }, seconds{ }, milliseconds{ };
+        if (std::sscanf(argv[3], "%d:%d:%d.%d", &hours, &minutes, &seconds, &milliseconds) < 3)
+        {
+            std::cout << "Cannot parse time " << at << '\n';
+            return 1;
+        }
+
+        // Midnight of the day the journal starts, in local time
+        const auto first = std::chrono::system_clock::time_point{ std::chrono::nanoseconds{ reader.FirstTimestamp() } };
+        const auto first_c = std::chrono::system_clock::to_time_t(std::chrono::time_point_cast<std::chrono::system_clock::duration>(first));
+        std::tm parts;
+        localtime_s(&parts, &first_c);
+        parts.tm_hour = hours;
+        parts.tm_min = minutes;
+        parts.tm_sec = seconds;
+
+        const auto time = std::chrono::system_clock::from_time_t(std::mktime(&parts)) + std::chrono::milliseconds{ milliseconds };
+        book = reader.BookAtTime(std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count());
+    }
+
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const auto levels = book.Levels();
+
+    std::cout << "Sequence " << book.sequence_ << " orders " << book.orders_.size()
+              << " checksum " << std::hex << book.checksum_ << std::dec << (book.Consistent() ? " (consistent)" : " (MISMATCH)")
+              << " reconstructed in " << std::fixed << std::setprecision(2) << elapsed << "ms\n";
+
+    const auto depth = std::max(levels.GetBids().size(), levels.GetAsks().size());
+    for (std::size_t i = 0; i < depth && i < 10; i++)
+    {
+        if (i < levels.GetBids().size())
+            std::cout << std::setw(10) << levels.GetBids()[i].quantity_ << " @ " << std::setw(8) << std::left << levels.GetBids()[i].price_ << std::right;
+        else
+            std::cout << std::setw(21) << ' ';
+        if (i < levels.GetAsks().size())
+            std::cout << " | " << std::setw(8) << levels.GetAsks()[i].price_ << " x " << levels.GetAsks()[i].quantity_;
+        std::cout << '\n';
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) 
+{
+    if (argc > 1 && std::string_view{ argv[1] } == "--replay")
+        return Run_Replay(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--bench")
+        return Run_Benchmark(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--bench-journal")
+        return Run_JournalBenchmark(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--bench-entry")
+        return Run_EntryBenchmark(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--bench-pipeline")
+        return Run_PipelineBenchmark(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--bench-replication")
+        return Run_ReplicationBenchmark(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--bench-quotes")
+        return Run_QuotingBenchmark(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--bench-depth")
+        return Run_DepthBenchmark(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--bench-matching")
+        return Run_MatchingBenchmark(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--bench-async")
+        return Run_AsyncBenchmark(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--bench-feed")
+        return Run_FeedBenchmark(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--soak")
+        return Run_Soak(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--generate")
+        return Run_Generate(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--journal")
+        return Run_Journal(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--convert")
+        return Run_Convert(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--export")
+        return Run_Export(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--scan")
+        return Run_Scan(argc, argv);
+    if (argc > 1 && std::string_view{ argv[1] } == "--book-at")
+        return Run_BookAt(argc, argv);
+
     std::shared_ptr<Orderbook> orderbook = std::make_shared<Orderbook>();
     clearConsole();
 